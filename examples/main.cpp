@@ -1,10 +1,13 @@
 #include "quix_commands.hpp"
 #include "quix_common.hpp"
 #include "quix_descriptor.hpp"
+#include "quix_frame.hpp"
+#include "quix_geometry.hpp"
 #include "quix_instance.hpp"
 #include "quix_pipeline.hpp"
 #include "quix_render_target.hpp"
 #include "quix_resource.hpp"
+#include "quix_stats.hpp"
 #include "quix_window.hpp"
 
 #define GLM_FORCE_RADIANS
@@ -100,31 +103,17 @@ int main()
         0, 1, 2, 2, 3, 0,
         4, 5, 6, 6, 7, 4);
 
-    auto vertex_buffer = instance.create_buffer_handle();
-    vertex_buffer.create_staged_buffer(sizeof(Vertex) * vertices.size(),
-        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-        vertices.data(),
-        &instance);
-
-    auto index_buffer = instance.create_buffer_handle();
-    index_buffer.create_staged_buffer(sizeof(uint16_t) * indices.size(),
-        VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-        indices.data(),
-        &instance);
+    // every mesh shares the pool's vertex and index buffer and is drawn by offset
+    auto geometry = instance.create_geometry_pool(sizeof(Vertex), VK_INDEX_TYPE_UINT16, 64 * 1024, 256 * 1024);
+    auto quads = geometry.allocate(vertices.data(), vertices.size(), indices.data(), indices.size());
+    quix_assert(quads.has_value(), "failed to allocate geometry");
+    geometry.flush();
 
     auto image = instance.create_image_handle();
-    image.create_image_from_file("examples/img.jpg", &instance)
+    image.create_image_from_file("examples/img.jpg", &instance, true)
         .create_view()
         .create_sampler(VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_REPEAT);
 
-    auto uniform_buffers = std::array<quix::buffer_handle, FRAMES_IN_FLIGHT> {
-        instance.create_buffer_handle(), instance.create_buffer_handle()
-    };
-    for (auto& uniform_buffer : uniform_buffers) {
-        uniform_buffer.create_uniform_buffer(sizeof(uniform_buffer_object));
-        *((uniform_buffer_object*)uniform_buffer.get_mapped_data()) = uniform_buffer_object {};
-    }
-
     auto render_target = instance.create_single_pass_depth_render_target();
 
     auto pipeline_manager = instance.get_pipeline_manager();
@@ -137,23 +126,19 @@ int main()
         pipeline_builder.create_shader_stage("examples/simpleshader.vert", VK_SHADER_STAGE_VERTEX_BIT),
         pipeline_builder.create_shader_stage("examples/simpleshader.frag", VK_SHADER_STAGE_FRAGMENT_BIT));
 
+    auto image_info = image.get_descriptor_info();
+    // uniform data lives in the frames' upload memory, the dynamic offset picks the frame and object
+    auto uniform_info = instance.get_upload_descriptor_info(sizeof(uniform_buffer_object));
+
     auto allocator_pool = instance.get_descriptor_allocator_pool();
     auto descriptor_set_builder = instance.get_descriptor_builder(&allocator_pool);
     auto descriptor_set_layout = descriptor_set_builder
-                                     .bind_buffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+                                     .bind_buffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT)
                                      .bind_image(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
+                                     .update_buffer(0, &uniform_info)
+                                     .update_image(1, &image_info)
                                      .buildLayout();
-
-    std::array<VkDescriptorSet, FRAMES_IN_FLIGHT> descriptor_sets {};
-    {
-        auto image_info = image.get_descriptor_info();
-        descriptor_set_builder.update_image(1, &image_info);
-        for (uint32_t index = 0; index < FRAMES_IN_FLIGHT; index++) {
-            auto buffer_info = uniform_buffers[index].get_descriptor_info();
-            descriptor_set_builder.update_buffer(0, &buffer_info);
-            descriptor_sets[index] = descriptor_set_builder.buildSet();
-        }
-    }
+    VkDescriptorSet descriptor_set = descriptor_set_builder.buildSet();
 
     auto pipeline = pipeline_builder.add_shader_stages(shader_stages)
                         .create_vertex_state(vertex_binding_description.data(), vertex_binding_description.size(), vertex_attribute_description.data(), vertex_attribute_description.size())
@@ -163,75 +148,49 @@ int main()
                         .create_depth_stencil_state(VK_TRUE, VK_TRUE, VK_COMPARE_OP_LESS)
                         .create_graphics_pipeline();
 
-    auto window = instance.get_window();
-    auto command_pool = instance.get_command_pool();
-    auto sync_objects = instance.create_sync_objects();
-
-    int current_frame = 0;
-    uint32_t current_image_index = 0;
-
-    std::array<quix::allocated_unique_ptr<quix::command_list>, FRAMES_IN_FLIGHT> command_lists {
-        command_pool.create_command_list(), command_pool.create_command_list()
-    };
-
     std::array<VkClearValue, 2> clear_values = {
         { { 0.0f, 0.0f, 0.0f, 0.0f }, { 1.0f, 0.0f } }
     };
 
-    std::array<VkBuffer, 1> vertex_buffer_array = { vertex_buffer.get_buffer() };
-    std::array<VkDeviceSize, 1> offsets = { 0 };
+    auto window = instance.get_window();
 
     std::chrono::high_resolution_clock clock;
     auto start_time = clock.now();
 
     uniform_buffer_object uniform_buffer_main {};
-    auto update_uniform = [&]() {
-        auto cur_time = clock.now();
-        float time = std::chrono::duration<float, std::chrono::seconds::period>(cur_time - start_time).count();
-        uniform_buffer_main.update(time);
-        memcpy(uniform_buffers[current_frame].get_mapped_data(), &uniform_buffer_main, sizeof(uniform_buffer_main));
-    };
+
+    instance.get_frame_stats().set_dump_interval(5.0);
 
     while (!window->should_close()) {
         window->poll_events();
 
-        VkResult result = sync_objects.acquire_next_image(current_frame, &current_image_index);
-        if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-            render_target.recreate_swapchain();
+        auto* frame = instance.begin_frame(render_target);
+        if (frame == nullptr) {
             continue;
-        } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
-            quix_error("failed to acquire swapchain image");
         }
-        sync_objects.reset_fence(current_frame);
 
-        command_lists[current_frame]->begin_record();
-
-        command_lists[current_frame]->begin_render_pass(render_target, pipeline, current_image_index, clear_values.data(), clear_values.size());
-
-        vkCmdBindVertexBuffers(command_lists[current_frame]->get_cmd_buffer(), 0, vertex_buffer_array.size(), vertex_buffer_array.data(), offsets.data());
+        auto cur_time = clock.now();
+        float time = std::chrono::duration<float, std::chrono::seconds::period>(cur_time - start_time).count();
+        uniform_buffer_main.update(time);
 
-        vkCmdBindIndexBuffer(command_lists[current_frame]->get_cmd_buffer(), index_buffer.get_buffer(), 0, VK_INDEX_TYPE_UINT16);
+        const uint32_t uniform_offset = frame->push_upload(uniform_buffer_main).get_dynamic_offset();
 
-        vkCmdBindDescriptorSets(command_lists[current_frame]->get_cmd_buffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->get_layout(), 0, 1, &descriptor_sets[current_frame], 0, nullptr);
+        auto* command_list = frame->get_command_list();
 
-        vkCmdDrawIndexed(command_lists[current_frame]->get_cmd_buffer(), indices.size(), 1, 0, 0, 0);
+        command_list->begin_render_pass(render_target, pipeline, frame->get_image_index(), clear_values.data(), clear_values.size());
 
-        command_lists[current_frame]->end_render_pass();
+        geometry.bind(command_list);
 
-        command_lists[current_frame]->end_record();
+        vkCmdBindDescriptorSets(command_list->get_cmd_buffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->get_layout(), 0, 1, &descriptor_set, 1, &uniform_offset);
 
-        update_uniform();
+        geometry.draw(command_list, *quads);
 
-        VK_CHECK(sync_objects.submit_frame(current_frame, command_lists[current_frame].get()), "failed to submit frame");
+        command_list->end_render_pass();
 
-        result = sync_objects.present_frame(current_frame, current_image_index);
+        instance.end_frame();
 
-        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || window->get_framebuffer_resized()) {
-            render_target.recreate_swapchain();
-        } else if (result != VK_SUCCESS) {
-            quix_error("failed to present swapchain image");
-        }
-        current_frame = (current_frame + 1) % FRAMES_IN_FLIGHT;
+        // the pool's buffers are bound every frame, so they can be compacted in the background
+        instance.defragment_step();
     }
 
     instance.wait_idle();
@@ -0,0 +1,583 @@
+#ifndef _QUIX_ARCHIVE_CPP
+#define _QUIX_ARCHIVE_CPP
+
+#include "quix_archive.hpp"
+
+#include "quix_texture_container.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace quix {
+
+// layout: header, chunk data, then the entries sorted by name hash, the chunk table and the names.
+// the tables start 8 byte aligned so they can be used in place from the mapping
+static constexpr std::array<char, 4> archive_magic = { 'Q', 'X', 'A', 'R' };
+static constexpr uint32_t archive_version = 1;
+
+struct archive_header {
+    std::array<char, 4> magic {};
+    uint32_t version {};
+    uint32_t entry_count {};
+    uint32_t chunk_count {};
+    uint64_t entries_offset {};
+    uint64_t chunks_offset {};
+    uint64_t names_offset {};
+    uint64_t names_size {};
+    uint32_t chunk_size {};
+    uint32_t padding {};
+};
+
+struct archive_entry {
+    uint64_t hash {};
+    uint64_t size {};
+    uint32_t first_chunk {};
+    uint32_t chunk_count {};
+    uint32_t name_offset {};
+    uint32_t name_length {};
+};
+
+// stored raw when compressed_size equals size
+struct archive_chunk {
+    uint64_t offset {};
+    uint32_t compressed_size {};
+    uint32_t size {};
+};
+
+static_assert(sizeof(archive_header) == 56 && sizeof(archive_entry) == 32 && sizeof(archive_chunk) == 16);
+
+NODISCARD static uint64_t hash_name(std::string_view name) noexcept
+{
+    // fnv-1a
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (char c : name) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// lz4 block format, compatible with LZ4_decompress_safe so archives can be built with the reference tools too.
+// a sequence is a token (literal length << 4 | match length - 4), the literals, a 16 bit offset and length extensions.
+// the last 5 bytes are always literals and the last match starts at least 12 bytes before the end
+static constexpr uint32_t lz4_min_match = 4;
+static constexpr std::size_t lz4_last_literals = 5;
+static constexpr std::size_t lz4_match_limit = 12;
+static constexpr std::size_t lz4_max_offset = 65535;
+static constexpr uint32_t lz4_hash_bits = 16;
+
+NODISCARD static inline uint32_t read_u32(const uint8_t* ptr) noexcept
+{
+    uint32_t value {};
+    std::memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+NODISCARD static inline uint32_t lz4_hash(uint32_t sequence) noexcept
+{
+    return (sequence * 2654435761u) >> (32 - lz4_hash_bits);
+}
+
+NODISCARD static constexpr std::size_t lz4_compress_bound(std::size_t size) noexcept
+{
+    return size + size / 255 + 16;
+}
+
+static uint8_t* lz4_write_length(uint8_t* out, std::size_t length) noexcept
+{
+    for (; length >= 255; length -= 255) {
+        *out++ = 255;
+    }
+    *out++ = static_cast<uint8_t>(length);
+    return out;
+}
+
+static uint8_t* lz4_write_sequence(uint8_t* out, const uint8_t* literals, std::size_t literal_length, std::size_t offset, std::size_t match_length) noexcept
+{
+    uint8_t* token = out++;
+    *token = static_cast<uint8_t>(std::min<std::size_t>(literal_length, 15) << 4);
+    if (literal_length >= 15) {
+        out = lz4_write_length(out, literal_length - 15);
+    }
+    std::memcpy(out, literals, literal_length);
+    out += literal_length;
+
+    if (offset != 0) {
+        *out++ = static_cast<uint8_t>(offset & 0xff);
+        *out++ = static_cast<uint8_t>(offset >> 8);
+        *token |= static_cast<uint8_t>(std::min<std::size_t>(match_length, 15));
+        if (match_length >= 15) {
+            out = lz4_write_length(out, match_length - 15);
+        }
+    }
+    return out;
+}
+
+// greedy single probe matcher, dst has to hold lz4_compress_bound(size) bytes
+NODISCARD static std::size_t lz4_compress(const uint8_t* src, std::size_t size, uint8_t* dst)
+{
+    const uint8_t* const end = src + size;
+    const uint8_t* anchor = src;
+    uint8_t* out = dst;
+
+    if (size > lz4_match_limit) {
+        std::vector<uint32_t> table(std::size_t(1) << lz4_hash_bits, 0);
+        const uint8_t* const match_start_limit = end - lz4_match_limit;
+        const uint8_t* const match_end_limit = end - lz4_last_literals;
+
+        const uint8_t* in = src;
+        while (in <= match_start_limit) {
+            const uint32_t sequence = read_u32(in);
+            const uint32_t hash = lz4_hash(sequence);
+            const uint8_t* candidate = src + table[hash];
+            table[hash] = static_cast<uint32_t>(in - src);
+
+            if (candidate >= in || static_cast<std::size_t>(in - candidate) > lz4_max_offset || read_u32(candidate) != sequence) {
+                // step further the longer nothing matched so incompressible data goes by quickly
+                in += 1 + ((in - anchor) >> 6);
+                continue;
+            }
+
+            const uint8_t* match_end = in + lz4_min_match;
+            const uint8_t* candidate_end = candidate + lz4_min_match;
+            while (match_end < match_end_limit && *match_end == *candidate_end) {
+                ++match_end;
+                ++candidate_end;
+            }
+            while (in > anchor && candidate > src && in[-1] == candidate[-1]) {
+                --in;
+                --candidate;
+            }
+
+            out = lz4_write_sequence(out, anchor, static_cast<std::size_t>(in - anchor), static_cast<std::size_t>(in - candidate),
+                static_cast<std::size_t>(match_end - in) - lz4_min_match);
+
+            in = match_end;
+            anchor = in;
+            if (in - 2 >= src && in <= match_start_limit) {
+                table[lz4_hash(read_u32(in - 2))] = static_cast<uint32_t>(in - 2 - src);
+            }
+        }
+    }
+
+    out = lz4_write_sequence(out, anchor, static_cast<std::size_t>(end - anchor), 0, 0);
+    return static_cast<std::size_t>(out - dst);
+}
+
+NODISCARD static bool lz4_read_length(const uint8_t*& in, const uint8_t* end, std::size_t& length) noexcept
+{
+    uint8_t byte {};
+    do {
+        if (in >= end) {
+            return false;
+        }
+        byte = *in++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+// bounds checked, fails instead of reading or writing out of range on corrupt input
+NODISCARD static bool lz4_decompress(const uint8_t* src, std::size_t src_size, uint8_t* dst, std::size_t dst_size) noexcept
+{
+    const uint8_t* in = src;
+    const uint8_t* const in_end = src + src_size;
+    uint8_t* out = dst;
+    uint8_t* const out_end = dst + dst_size;
+
+    while (in < in_end) {
+        const uint8_t token = *in++;
+
+        std::size_t literal_length = token >> 4;
+        if (literal_length == 15 && !lz4_read_length(in, in_end, literal_length)) {
+            return false;
+        }
+        if (literal_length > static_cast<std::size_t>(in_end - in) || literal_length > static_cast<std::size_t>(out_end - out)) {
+            return false;
+        }
+        std::memcpy(out, in, literal_length);
+        in += literal_length;
+        out += literal_length;
+
+        // the last sequence ends after its literals
+        if (in == in_end) {
+            break;
+        }
+
+        if (in_end - in < 2) {
+            return false;
+        }
+        const std::size_t offset = in[0] | (static_cast<std::size_t>(in[1]) << 8);
+        in += 2;
+        if (offset == 0 || offset > static_cast<std::size_t>(out - dst)) {
+            return false;
+        }
+
+        std::size_t match_length = token & 15;
+        if (match_length == 15 && !lz4_read_length(in, in_end, match_length)) {
+            return false;
+        }
+        match_length += lz4_min_match;
+        if (match_length > static_cast<std::size_t>(out_end - out)) {
+            return false;
+        }
+
+        const uint8_t* match = out - offset;
+        if (offset >= match_length) {
+            std::memcpy(out, match, match_length);
+        } else {
+            // overlapping copies repeat the last offset bytes
+            for (std::size_t i = 0; i < match_length; i++) {
+                out[i] = match[i];
+            }
+        }
+        out += match_length;
+    }
+
+    return out == out_end;
+}
+
+NODISCARD bool write_asset_archive(const char* path, std::span<const archive_source> sources, uint32_t chunk_size)
+{
+    quix_assert(chunk_size > 0, "archive chunk size must be greater than zero");
+
+    std::vector<archive_entry> entries {};
+    std::vector<archive_chunk> chunks {};
+    std::string names {};
+    std::set<std::string_view> added {};
+
+    FILE* handle = fopen(path, "wb");
+    if (handle == nullptr) {
+        spdlog::error("failed to create archive {}", path);
+        return false;
+    }
+
+    auto fail = [&](std::string_view message) {
+        spdlog::error("failed to write archive {}: {}", path, message);
+        (void)fclose(handle);
+        (void)std::remove(path);
+        return false;
+    };
+
+    archive_header header {};
+    if (fwrite(&header, sizeof(header), 1, handle) != 1) {
+        return fail("write error");
+    }
+    uint64_t offset = sizeof(header);
+
+    const auto worker_count = std::max(std::thread::hardware_concurrency(), 1u);
+
+    std::vector<uint8_t> data {};
+    for (const auto& source : sources) {
+        if (!read_binary_file(source.path.c_str(), data)) {
+            return fail(fmt::format("can not read {}", source.path));
+        }
+
+        if (!added.insert(source.name).second) {
+            return fail(fmt::format("{} is added twice", source.name));
+        }
+
+        archive_entry entry {};
+        entry.hash = hash_name(source.name);
+        entry.size = data.size();
+        entry.first_chunk = static_cast<uint32_t>(chunks.size());
+        entry.chunk_count = static_cast<uint32_t>((data.size() + chunk_size - 1) / chunk_size);
+        entry.name_offset = static_cast<uint32_t>(names.size());
+        entry.name_length = static_cast<uint32_t>(source.name.size());
+        names += source.name;
+
+        // chunks are independent, compress them on every core and write them in order
+        std::vector<std::vector<uint8_t>> compressed(entry.chunk_count);
+        std::atomic<uint32_t> next_chunk = 0;
+        auto compress_chunks = [&]() {
+            for (auto index = next_chunk.fetch_add(1, std::memory_order_relaxed); index < entry.chunk_count; index = next_chunk.fetch_add(1, std::memory_order_relaxed)) {
+                const std::size_t begin = static_cast<std::size_t>(index) * chunk_size;
+                const std::size_t size = std::min<std::size_t>(chunk_size, data.size() - begin);
+
+                auto& out = compressed[index];
+                out.resize(lz4_compress_bound(size));
+                out.resize(lz4_compress(data.data() + begin, size, out.data()));
+                if (out.size() >= size) {
+                    out.assign(data.begin() + static_cast<std::ptrdiff_t>(begin), data.begin() + static_cast<std::ptrdiff_t>(begin + size));
+                }
+            }
+        };
+
+        std::vector<std::thread> workers {};
+        for (uint32_t i = 1; i < std::min(worker_count, entry.chunk_count); i++) {
+            workers.emplace_back(compress_chunks);
+        }
+        compress_chunks();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+
+        for (uint32_t index = 0; index < entry.chunk_count; index++) {
+            const auto& out = compressed[index];
+            archive_chunk chunk {};
+            chunk.offset = offset;
+            chunk.compressed_size = static_cast<uint32_t>(out.size());
+            chunk.size = static_cast<uint32_t>(std::min<std::size_t>(chunk_size, data.size() - static_cast<std::size_t>(index) * chunk_size));
+            chunks.push_back(chunk);
+
+            if (fwrite(out.data(), 1, out.size(), handle) != out.size()) {
+                return fail("write error");
+            }
+            offset += out.size();
+        }
+
+        entries.push_back(entry);
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const archive_entry& a, const archive_entry& b) { return a.hash < b.hash; });
+
+    const std::array<uint8_t, 8> zeros {};
+    const auto padding = static_cast<std::size_t>((8 - offset % 8) % 8);
+    if (fwrite(zeros.data(), 1, padding, handle) != padding) {
+        return fail("write error");
+    }
+    offset += padding;
+
+    header.magic = archive_magic;
+    header.version = archive_version;
+    header.entry_count = static_cast<uint32_t>(entries.size());
+    header.chunk_count = static_cast<uint32_t>(chunks.size());
+    header.entries_offset = offset;
+    header.chunks_offset = header.entries_offset + entries.size() * sizeof(archive_entry);
+    header.names_offset = header.chunks_offset + chunks.size() * sizeof(archive_chunk);
+    header.names_size = names.size();
+    header.chunk_size = chunk_size;
+
+    if (fwrite(entries.data(), sizeof(archive_entry), entries.size(), handle) != entries.size()
+        || fwrite(chunks.data(), sizeof(archive_chunk), chunks.size(), handle) != chunks.size()
+        || fwrite(names.data(), 1, names.size(), handle) != names.size()
+        || fseek(handle, 0, SEEK_SET) != 0
+        || fwrite(&header, sizeof(header), 1, handle) != 1) {
+        return fail("write error");
+    }
+
+    if (fclose(handle) != 0) {
+        spdlog::error("failed to write archive {}", path);
+        return false;
+    }
+
+    spdlog::info("Wrote {} assets in {} chunks to {} ({} bytes)", entries.size(), chunks.size(), path, header.names_offset + names.size());
+    return true;
+}
+
+// asset_archive class
+
+asset_archive::asset_archive(const char* path)
+    : m_path(path)
+    , m_jobs(4096)
+{
+#ifdef _WIN32
+    quix_assert(read_binary_file(path, m_buffer), fmt::format("failed to read archive {}", path));
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+#else
+    const int file = open(path, O_RDONLY);
+    quix_assert(file != -1, fmt::format("failed to open archive {}", path));
+
+    struct stat file_stat { };
+    quix_assert(fstat(file, &file_stat) == 0, fmt::format("failed to stat archive {}", path));
+    m_size = static_cast<std::size_t>(file_stat.st_size);
+
+    if (m_size > 0) {
+        void* mapping = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+        quix_assert(mapping != MAP_FAILED, fmt::format("failed to map archive {}", path));
+        // entries are read in whatever order assets are loaded, read ahead is done per entry in read
+        (void)madvise(mapping, m_size, MADV_RANDOM);
+        m_data = static_cast<const uint8_t*>(mapping);
+    }
+    (void)close(file);
+#endif
+
+    archive_header header {};
+    quix_assert(m_size >= sizeof(header), fmt::format("{} is too small to be an archive", path));
+    std::memcpy(&header, m_data, sizeof(header));
+
+    quix_assert(header.magic == archive_magic, fmt::format("{} is not a quix archive", path));
+    quix_assert(header.version == archive_version, fmt::format("{} has archive version {}, expected {}", path, header.version, archive_version));
+    quix_assert(header.entries_offset % 8 == 0
+            && header.chunks_offset == header.entries_offset + uint64_t(header.entry_count) * sizeof(archive_entry)
+            && header.names_offset == header.chunks_offset + uint64_t(header.chunk_count) * sizeof(archive_chunk)
+            && header.names_offset + header.names_size <= m_size,
+        fmt::format("{} has a corrupt index", path));
+
+    m_entries = reinterpret_cast<const archive_entry*>(m_data + header.entries_offset);
+    m_chunks = reinterpret_cast<const archive_chunk*>(m_data + header.chunks_offset);
+    m_names = reinterpret_cast<const char*>(m_data + header.names_offset);
+    m_entry_count = header.entry_count;
+    m_chunk_count = header.chunk_count;
+    m_chunk_size = header.chunk_size;
+
+    // the index is validated once here so lookups and reads only check what they decompress
+    for (uint32_t i = 0; i < m_entry_count; i++) {
+        const auto& entry = m_entries[i];
+        quix_assert(uint64_t(entry.first_chunk) + entry.chunk_count <= m_chunk_count
+                && uint64_t(entry.name_offset) + entry.name_length <= header.names_size,
+            fmt::format("{} has a corrupt entry", path));
+    }
+    for (uint32_t i = 0; i < m_chunk_count; i++) {
+        const auto& chunk = m_chunks[i];
+        quix_assert(chunk.offset + chunk.compressed_size <= header.entries_offset && chunk.size <= m_chunk_size,
+            fmt::format("{} has a corrupt chunk", path));
+    }
+
+    const auto worker_count = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    for (uint32_t i = 0; i < worker_count; i++) {
+        m_workers.emplace_back(&asset_archive::worker_loop, this);
+    }
+
+    spdlog::trace("Opened archive {} with {} assets", path, m_entry_count);
+}
+
+asset_archive::~asset_archive()
+{
+    m_jobs.close();
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+
+#ifndef _WIN32
+    if (m_data != nullptr) {
+        (void)munmap(const_cast<uint8_t*>(m_data), m_size);
+    }
+#endif
+}
+
+NODISCARD bool asset_archive::contains(std::string_view name) const noexcept
+{
+    return find(name) != nullptr;
+}
+
+NODISCARD std::optional<VkDeviceSize> asset_archive::get_size(std::string_view name) const noexcept
+{
+    const auto* entry = find(name);
+    if (entry == nullptr) {
+        return std::nullopt;
+    }
+    return entry->size;
+}
+
+bool asset_archive::read(std::string_view name, void* dst) const
+{
+    const auto* entry = find(name);
+    if (entry == nullptr) {
+        spdlog::error("{} is not in archive {}", name, m_path);
+        return false;
+    }
+    if (entry->chunk_count == 0) {
+        return true;
+    }
+
+    const archive_chunk* chunks = m_chunks + entry->first_chunk;
+
+#ifndef _WIN32
+    // fault the compressed range in with one request instead of page by page
+    const auto page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    const uint64_t begin = chunks[0].offset & ~(page - 1);
+    const uint64_t end = chunks[entry->chunk_count - 1].offset + chunks[entry->chunk_count - 1].compressed_size;
+    (void)madvise(const_cast<uint8_t*>(m_data) + begin, end - begin, MADV_WILLNEED);
+#endif
+
+    read_group group {};
+    group.remaining = entry->chunk_count;
+
+    auto* out = static_cast<uint8_t*>(dst);
+    std::vector<chunk_job> jobs(entry->chunk_count);
+    for (uint32_t i = 0; i < entry->chunk_count; i++) {
+        jobs[i] = chunk_job { &chunks[i], out, &group };
+        out += chunks[i].size;
+    }
+    if (static_cast<uint64_t>(out - static_cast<uint8_t*>(dst)) != entry->size) {
+        spdlog::error("{} in archive {} has a corrupt chunk table", name, m_path);
+        return false;
+    }
+
+    // the first chunk is done here, the rest is shared with the workers and this thread helps until they run out
+    for (uint32_t i = 1; i < entry->chunk_count; i++) {
+        m_jobs.push(jobs[i]);
+    }
+    run(jobs[0]);
+    while (auto job = m_jobs.try_pop()) {
+        run(*job);
+    }
+
+    std::unique_lock<std::mutex> lock(group.mutex);
+    group.done.wait(lock, [&] { return group.remaining == 0; });
+
+    if (group.failed) {
+        spdlog::error("{} in archive {} failed to decompress", name, m_path);
+        return false;
+    }
+    return true;
+}
+
+NODISCARD std::optional<std::vector<uint8_t>> asset_archive::read(std::string_view name) const
+{
+    const auto size = get_size(name);
+    if (!size.has_value()) {
+        spdlog::error("{} is not in archive {}", name, m_path);
+        return std::nullopt;
+    }
+
+    std::vector<uint8_t> data(*size);
+    if (!read(name, data.data())) {
+        return std::nullopt;
+    }
+    return data;
+}
+
+NODISCARD const archive_entry* asset_archive::find(std::string_view name) const noexcept
+{
+    const uint64_t hash = hash_name(name);
+    const archive_entry* end = m_entries + m_entry_count;
+    for (const auto* entry = std::lower_bound(m_entries, end, hash, [](const archive_entry& a, uint64_t b) { return a.hash < b; });
+         entry != end && entry->hash == hash; ++entry) {
+        if (std::string_view(m_names + entry->name_offset, entry->name_length) == name) {
+            return entry;
+        }
+    }
+    return nullptr;
+}
+
+NODISCARD bool asset_archive::decompress(const archive_chunk& source, uint8_t* dst) const noexcept
+{
+    const uint8_t* compressed = m_data + source.offset;
+    if (source.compressed_size == source.size) {
+        std::memcpy(dst, compressed, source.size);
+        return true;
+    }
+    return lz4_decompress(compressed, source.compressed_size, dst, source.size);
+}
+
+void asset_archive::run(const chunk_job& job) const
+{
+    const bool ok = decompress(*job.source, job.dst);
+
+    // notifying under the lock keeps the group alive until this thread is done with it
+    std::lock_guard<std::mutex> lock(job.group->mutex);
+    job.group->failed |= !ok;
+    if (--job.group->remaining == 0) {
+        job.group->done.notify_all();
+    }
+}
+
+void asset_archive::worker_loop()
+{
+    while (auto job = m_jobs.pop()) {
+        run(*job);
+    }
+}
+
+// asset_archive end
+
+} // namespace quix
+
+#endif // _QUIX_ARCHIVE_CPP
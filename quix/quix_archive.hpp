@@ -0,0 +1,86 @@
+#ifndef _QUIX_ARCHIVE_HPP
+#define _QUIX_ARCHIVE_HPP
+
+#include "quix_bounded_queue.hpp"
+
+namespace quix {
+
+// the on disk index records, defined with the format in quix_archive.cpp
+struct archive_entry;
+struct archive_chunk;
+
+// a file to pack and the name it is looked up by
+struct archive_source {
+    std::string name {};
+    std::string path {};
+};
+
+// packs sources into a single archive, every file is split into chunk_size pieces that are lz4 compressed
+// in parallel and stored raw when that does not make them smaller. logs and returns false on failure
+NODISCARD bool write_asset_archive(const char* path, std::span<const archive_source> sources, uint32_t chunk_size = 256 * 1024);
+
+// a read only view of an archive written by write_asset_archive.
+// the file is memory mapped and looked up through an index sorted by name hash, so opening it costs
+// one open and one mmap no matter how many assets it holds. the chunks of an entry are decompressed
+// in parallel by the archive's workers and the calling thread, straight into the memory the caller
+// hands in, which can be upload_manager staging memory. every method can be called from any thread
+class asset_archive {
+public:
+    explicit asset_archive(const char* path);
+    ~asset_archive();
+
+    asset_archive(const asset_archive&) = delete;
+    asset_archive& operator=(const asset_archive&) = delete;
+    asset_archive(asset_archive&&) = delete;
+    asset_archive& operator=(asset_archive&&) = delete;
+
+    NODISCARD bool contains(std::string_view name) const noexcept;
+    // uncompressed size, std::nullopt when the archive has no such entry
+    NODISCARD std::optional<VkDeviceSize> get_size(std::string_view name) const noexcept;
+
+    // dst has to hold get_size bytes, returns false when the entry is missing or corrupt
+    bool read(std::string_view name, void* dst) const;
+    NODISCARD std::optional<std::vector<uint8_t>> read(std::string_view name) const;
+
+    NODISCARD inline uint32_t get_entry_count() const noexcept { return m_entry_count; }
+
+private:
+    // tracks the chunks of one read, everything in it is guarded by mutex
+    struct read_group {
+        std::mutex mutex;
+        std::condition_variable done;
+        uint32_t remaining {};
+        bool failed = false;
+    };
+
+    struct chunk_job {
+        const archive_chunk* source = nullptr;
+        uint8_t* dst = nullptr;
+        read_group* group = nullptr;
+    };
+
+    NODISCARD const archive_entry* find(std::string_view name) const noexcept;
+    NODISCARD bool decompress(const archive_chunk& source, uint8_t* dst) const noexcept;
+    void run(const chunk_job& job) const;
+    void worker_loop();
+
+    std::string m_path;
+    const uint8_t* m_data = nullptr;
+    std::size_t m_size {};
+    // used instead of a mapping where mmap is not available
+    std::vector<uint8_t> m_buffer {};
+
+    const archive_entry* m_entries = nullptr;
+    const archive_chunk* m_chunks = nullptr;
+    const char* m_names = nullptr;
+    uint32_t m_entry_count {};
+    uint32_t m_chunk_count {};
+    uint32_t m_chunk_size {};
+
+    mutable bounded_queue<chunk_job> m_jobs;
+    std::vector<std::thread> m_workers {};
+};
+
+} // namespace quix
+
+#endif // _QUIX_ARCHIVE_HPP
@@ -0,0 +1,118 @@
+#ifndef _QUIX_BOUNDED_QUEUE_HPP
+#define _QUIX_BOUNDED_QUEUE_HPP
+
+namespace quix {
+
+// fixed capacity blocking queue used to hand work between threads,
+// push blocks while full and pop blocks while empty until the queue is closed
+template <typename Type>
+class bounded_queue {
+public:
+    explicit bounded_queue(std::size_t capacity)
+        : m_capacity(capacity)
+    {
+        quix_assert(capacity > 0, "bounded_queue capacity must be greater than zero");
+    }
+
+    ~bounded_queue() = default;
+
+    bounded_queue(const bounded_queue&) = delete;
+    bounded_queue& operator=(const bounded_queue&) = delete;
+    bounded_queue(bounded_queue&&) = delete;
+    bounded_queue& operator=(bounded_queue&&) = delete;
+
+    // returns false if the queue was closed, the value is dropped in that case
+    bool push(Type value)
+    {
+        return push_or_keep(value);
+    }
+
+    // like push, but value is only moved from once it is queued so a closed queue leaves it with the caller
+    bool push_or_keep(Type& value)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_not_full.wait(lock, [this] { return m_closed || m_items.size() < m_capacity; });
+        if (m_closed) {
+            return false;
+        }
+
+        m_items.push_back(std::move(value));
+        lock.unlock();
+        m_not_empty.notify_one();
+        return true;
+    }
+
+    // returns std::nullopt once the queue is closed and drained
+    NODISCARD std::optional<Type> pop()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_not_empty.wait(lock, [this] { return m_closed || !m_items.empty(); });
+        if (m_items.empty()) {
+            return std::nullopt;
+        }
+
+        Type value = std::move(m_items.front());
+        m_items.pop_front();
+        lock.unlock();
+        m_not_full.notify_one();
+        return value;
+    }
+
+    // non blocking, returns std::nullopt when empty
+    NODISCARD std::optional<Type> try_pop()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_items.empty()) {
+            return std::nullopt;
+        }
+
+        Type value = std::move(m_items.front());
+        m_items.pop_front();
+        lock.unlock();
+        m_not_full.notify_one();
+        return value;
+    }
+
+    // wakes every waiter, pushes fail from now on while pops drain what is left
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_closed = true;
+        }
+        m_not_full.notify_all();
+        m_not_empty.notify_all();
+    }
+
+    // drops anything left and accepts pushes again
+    void reopen()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_items.clear();
+        m_closed = false;
+    }
+
+    NODISCARD bool is_closed()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_closed;
+    }
+
+    NODISCARD std::size_t size()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_items.size();
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_not_full;
+    std::condition_variable m_not_empty;
+    std::deque<Type> m_items;
+    std::size_t m_capacity;
+    bool m_closed = false;
+};
+
+} // namespace quix
+
+#endif // _QUIX_BOUNDED_QUEUE_HPP
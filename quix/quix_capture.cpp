@@ -0,0 +1,601 @@
+#ifndef _QUIX_CAPTURE_CPP
+#define _QUIX_CAPTURE_CPP
+
+#include "quix_capture.hpp"
+
+#include "quix_commands.hpp"
+#include "quix_device.hpp"
+#include "quix_instance.hpp"
+#include "quix_resource.hpp"
+
+namespace quix::capture {
+
+// recorder class start
+
+recorder::recorder(const char* path)
+    : m_file(fopen(path, "wb"))
+{
+    quix_assert(m_file != nullptr, fmt::format("failed to open capture file {}", path));
+
+    m_stream.reserve(stream_flush_size);
+
+    const std::array<uint32_t, 2> file_header = { file_magic, file_version };
+    append(file_header.data(), sizeof(file_header));
+
+    spdlog::info("capturing api stream to {}", path);
+}
+
+recorder::~recorder()
+{
+    flush_stream();
+    fclose(m_file);
+}
+
+void recorder::flush()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    flush_stream();
+    (void)fflush(m_file);
+}
+
+void recorder::record_create_buffer(VkBuffer buffer, const VkBufferCreateInfo* create_info, const VmaAllocationCreateInfo* alloc_info)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    buffer_record payload {};
+    payload.size = create_info->size;
+    payload.id = get_id((uint64_t)buffer);
+    payload.usage = create_info->usage;
+    payload.memory_usage = alloc_info->usage;
+    payload.alloc_flags = alloc_info->flags;
+
+    write(opcode::create_buffer, payload);
+}
+
+void recorder::record_destroy_buffer(VkBuffer buffer)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    write(opcode::destroy_buffer, destroy_record { release_id((uint64_t)buffer) });
+}
+
+void recorder::record_create_image(VkImage image, const VkImageCreateInfo* create_info, const VmaAllocationCreateInfo* alloc_info)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    image_record payload {};
+    payload.id = get_id((uint64_t)image);
+    payload.image_type = create_info->imageType;
+    payload.format = create_info->format;
+    payload.width = create_info->extent.width;
+    payload.height = create_info->extent.height;
+    payload.depth = create_info->extent.depth;
+    payload.mip_levels = create_info->mipLevels;
+    payload.array_layers = create_info->arrayLayers;
+    payload.samples = create_info->samples;
+    payload.tiling = create_info->tiling;
+    payload.usage = create_info->usage;
+    payload.memory_usage = alloc_info->usage;
+    payload.required_flags = alloc_info->requiredFlags;
+
+    write(opcode::create_image, payload);
+}
+
+void recorder::record_destroy_image(VkImage image)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    write(opcode::destroy_image, destroy_record { release_id((uint64_t)image) });
+}
+
+void recorder::record_write_buffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size)
+{
+    quix_assert(size <= UINT32_MAX - sizeof(write_record), "capture upload is too large for a single record");
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    write_record payload {};
+    payload.offset = offset;
+    payload.size = size;
+    payload.id = get_id((uint64_t)buffer);
+
+    write(opcode::write_buffer, payload, data, static_cast<uint32_t>(size));
+}
+
+void recorder::record_create_pipeline(const VkGraphicsPipelineCreateInfo* create_info, const VkPipelineLayoutCreateInfo* layout_info)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    pipeline_record payload {};
+    payload.stage_count = create_info->stageCount;
+    if (create_info->pVertexInputState != nullptr) {
+        payload.vertex_binding_count = create_info->pVertexInputState->vertexBindingDescriptionCount;
+        payload.vertex_attribute_count = create_info->pVertexInputState->vertexAttributeDescriptionCount;
+    }
+    if (create_info->pInputAssemblyState != nullptr) {
+        payload.topology = create_info->pInputAssemblyState->topology;
+    }
+    if (create_info->pRasterizationState != nullptr) {
+        payload.polygon_mode = create_info->pRasterizationState->polygonMode;
+        payload.cull_mode = create_info->pRasterizationState->cullMode;
+    }
+    if (create_info->pDepthStencilState != nullptr) {
+        payload.depth_test = create_info->pDepthStencilState->depthTestEnable;
+    }
+    if (layout_info != nullptr) {
+        payload.set_layout_count = layout_info->setLayoutCount;
+        payload.push_constant_count = layout_info->pushConstantRangeCount;
+    }
+
+    write(opcode::create_pipeline, payload);
+}
+
+void recorder::record_begin(VkCommandBuffer cmd, VkCommandBufferUsageFlags flags)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    write(opcode::begin_record, list_record { get_id((uint64_t)cmd), flags });
+}
+
+void recorder::record_end(VkCommandBuffer cmd)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    write(opcode::end_record, list_record { get_id((uint64_t)cmd), 0 });
+}
+
+void recorder::record_submit(VkCommandBuffer cmd)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    write(opcode::submit, list_record { get_id((uint64_t)cmd), 0 });
+}
+
+void recorder::record_begin_render_pass(VkCommandBuffer cmd, VkExtent2D extent, uint32_t clear_value_count)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    write(opcode::begin_render_pass, render_pass_record { get_id((uint64_t)cmd), extent.width, extent.height, clear_value_count });
+}
+
+void recorder::record_end_render_pass(VkCommandBuffer cmd)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    write(opcode::end_render_pass, list_record { get_id((uint64_t)cmd), 0 });
+}
+
+void recorder::record_copy_buffer_to_buffer(VkCommandBuffer cmd, VkBuffer src, VkDeviceSize src_offset, VkBuffer dst, VkDeviceSize dst_offset, VkDeviceSize size)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    copy_buffer_record payload {};
+    payload.src_offset = src_offset;
+    payload.dst_offset = dst_offset;
+    payload.size = size;
+    payload.list = get_id((uint64_t)cmd);
+    payload.src = get_id((uint64_t)src);
+    payload.dst = get_id((uint64_t)dst);
+
+    write(opcode::copy_buffer_to_buffer, payload);
+}
+
+void recorder::record_copy_buffer_to_image(VkCommandBuffer cmd, VkBuffer src, VkImage dst, const VkBufferImageCopy& region)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    copy_buffer_to_image_record payload {};
+    payload.list = get_id((uint64_t)cmd);
+    payload.src = get_id((uint64_t)src);
+    payload.dst = get_id((uint64_t)dst);
+    payload.region = region;
+
+    write(opcode::copy_buffer_to_image, payload);
+}
+
+void recorder::record_copy_image_to_image(VkCommandBuffer cmd, VkImage src, VkOffset3D src_offset, VkImage dst, VkOffset3D dst_offset, VkImageAspectFlags aspect_mask)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    copy_image_record payload {};
+    payload.list = get_id((uint64_t)cmd);
+    payload.src = get_id((uint64_t)src);
+    payload.dst = get_id((uint64_t)dst);
+    payload.aspect_mask = aspect_mask;
+    payload.src_offset = src_offset;
+    payload.dst_offset = dst_offset;
+
+    write(opcode::copy_image_to_image, payload);
+}
+
+void recorder::record_image_barrier(VkCommandBuffer cmd, VkImage image, VkImageLayout old_layout, VkImageLayout new_layout,
+    VkAccessFlags src_access_mask, VkAccessFlags dst_access_mask,
+    VkPipelineStageFlags src_stage, VkPipelineStageFlags dst_stage, const VkImageSubresourceRange& range)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    barrier_record payload {};
+    payload.list = get_id((uint64_t)cmd);
+    payload.image = get_id((uint64_t)image);
+    payload.old_layout = old_layout;
+    payload.new_layout = new_layout;
+    payload.src_access_mask = src_access_mask;
+    payload.dst_access_mask = dst_access_mask;
+    payload.src_stage = src_stage;
+    payload.dst_stage = dst_stage;
+    payload.range = range;
+
+    write(opcode::image_barrier, payload);
+}
+
+void recorder::record_generate_mips(VkCommandBuffer cmd, VkImage image, VkImageLayout final_layout)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    generate_mips_record payload {};
+    payload.list = get_id((uint64_t)cmd);
+    payload.image = get_id((uint64_t)image);
+    payload.final_layout = final_layout;
+
+    write(opcode::generate_mips, payload);
+}
+
+void recorder::record_frame_end()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    write(opcode::frame_end, list_record {});
+}
+
+template <typename Payload>
+void recorder::write(opcode op, const Payload& payload, const void* data, uint32_t data_size)
+{
+    static_assert(std::is_trivially_copyable_v<Payload>, "capture payloads are written as raw bytes");
+
+    record_header header { op, static_cast<uint32_t>(sizeof(Payload)) + data_size };
+    append(&header, sizeof(header));
+    append(&payload, sizeof(Payload));
+    if (data != nullptr) {
+        append(data, data_size);
+    }
+
+    if (m_stream.size() >= stream_flush_size) {
+        flush_stream();
+    }
+}
+
+void recorder::append(const void* data, std::size_t size)
+{
+    const auto* bytes = static_cast<const char*>(data);
+    m_stream.insert(m_stream.end(), bytes, bytes + size);
+}
+
+void recorder::flush_stream()
+{
+    if (m_stream.empty()) {
+        return;
+    }
+
+    auto written = fwrite(m_stream.data(), sizeof(char), m_stream.size(), m_file);
+    quix_assert(written == m_stream.size(), "failed to write capture file");
+    m_stream.clear();
+}
+
+NODISCARD uint32_t recorder::get_id(uint64_t handle)
+{
+    auto [it, inserted] = m_ids.try_emplace(handle, m_next_id);
+    if (inserted) {
+        m_next_id++;
+    }
+    return it->second;
+}
+
+NODISCARD uint32_t recorder::release_id(uint64_t handle)
+{
+    uint32_t id = get_id(handle);
+    m_ids.erase(handle);
+    return id;
+}
+
+// recorder class end
+
+// player class start
+
+template <typename Payload>
+static Payload read_payload(const char* data, uint32_t size)
+{
+    quix_assert(size >= sizeof(Payload), "capture record is smaller than its payload");
+    Payload payload;
+    memcpy(&payload, data, sizeof(Payload));
+    return payload;
+}
+
+player::player(instance* p_instance)
+    : m_instance(p_instance)
+    , m_logical_device(p_instance->get_logical_device())
+    , m_timestamp_period(p_instance->get_device()->get_timestamp_period())
+    , m_command_pool(p_instance->get_command_pool())
+{
+    VkQueryPoolCreateInfo query_info {};
+    query_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    query_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    query_info.queryCount = max_timed_lists * 2;
+
+    VK_CHECK(vkCreateQueryPool(m_logical_device, &query_info, nullptr, &m_query_pool), "failed to create timestamp query pool");
+
+    m_fence = m_instance->create_fence();
+}
+
+player::~player()
+{
+    vkDeviceWaitIdle(m_logical_device);
+
+    m_lists.clear();
+    m_buffers.clear();
+    m_images.clear();
+
+    vkDestroyFence(m_logical_device, m_fence, nullptr);
+    vkDestroyQueryPool(m_logical_device, m_query_pool, nullptr);
+}
+
+void player::load(const char* path)
+{
+    FILE* handle = fopen(path, "rb");
+    quix_assert(handle != nullptr, fmt::format("failed to open capture file {}", path));
+
+    (void)fseek(handle, 0, SEEK_END);
+    size_t file_size = ftell(handle);
+    (void)fseek(handle, 0, SEEK_SET);
+
+    m_stream.resize(file_size);
+    auto read = fread(m_stream.data(), sizeof(char), file_size, handle);
+    fclose(handle);
+
+    quix_assert(read == file_size, fmt::format("failed to read capture file {}", path));
+    quix_assert(file_size >= sizeof(uint32_t) * 2, "capture file is missing its header");
+
+    std::array<uint32_t, 2> file_header {};
+    memcpy(file_header.data(), m_stream.data(), sizeof(file_header));
+    quix_assert(file_header[0] == file_magic, fmt::format("{} is not a quix capture", path));
+    quix_assert(file_header[1] == file_version, fmt::format("{} has capture version {}, expected {}", path, file_header[1], file_version));
+
+    spdlog::info("loaded capture {} ({} bytes)", path, file_size);
+}
+
+replay_stats player::replay()
+{
+    replay_stats stats {};
+
+    std::size_t cursor = sizeof(uint32_t) * 2;
+    while (cursor + sizeof(record_header) <= m_stream.size()) {
+        record_header header {};
+        memcpy(&header, m_stream.data() + cursor, sizeof(header));
+        cursor += sizeof(header);
+
+        quix_assert(cursor + header.size <= m_stream.size(), "capture record is truncated");
+
+        execute(header.op, m_stream.data() + cursor, header.size, stats);
+        cursor += header.size;
+    }
+
+    return stats;
+}
+
+void player::execute(opcode op, const char* payload, uint32_t size, replay_stats& stats)
+{
+    switch (op) {
+    case opcode::frame_end:
+        stats.frames++;
+        break;
+    case opcode::create_buffer: {
+        auto record = read_payload<buffer_record>(payload, size);
+        if (m_buffers.contains(record.id)) {
+            break;
+        }
+
+        VkBufferCreateInfo buffer_info {};
+        buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        buffer_info.size = record.size;
+        buffer_info.usage = record.usage;
+        buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        VmaAllocationCreateInfo alloc_info {};
+        alloc_info.usage = static_cast<VmaMemoryUsage>(record.memory_usage);
+        alloc_info.flags = record.alloc_flags;
+
+        auto buffer = std::make_unique<buffer_handle>(m_instance->get_device());
+        buffer->create_buffer(&buffer_info, &alloc_info);
+        m_buffers.emplace(record.id, std::move(buffer));
+        break;
+    }
+    case opcode::create_image: {
+        auto record = read_payload<image_record>(payload, size);
+        if (m_images.contains(record.id)) {
+            break;
+        }
+
+        VkImageCreateInfo image_info {};
+        image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        image_info.imageType = static_cast<VkImageType>(record.image_type);
+        image_info.format = static_cast<VkFormat>(record.format);
+        image_info.extent = { record.width, record.height, record.depth };
+        image_info.mipLevels = record.mip_levels;
+        image_info.arrayLayers = record.array_layers;
+        image_info.samples = static_cast<VkSampleCountFlagBits>(record.samples);
+        image_info.tiling = static_cast<VkImageTiling>(record.tiling);
+        image_info.usage = record.usage;
+        image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        VmaAllocationCreateInfo alloc_info {};
+        alloc_info.usage = static_cast<VmaMemoryUsage>(record.memory_usage);
+        alloc_info.requiredFlags = record.required_flags;
+
+        auto image = std::make_unique<image_handle>(m_instance->get_device());
+        image->create_image(&image_info, &alloc_info);
+        m_images.emplace(record.id, std::move(image));
+        break;
+    }
+    case opcode::destroy_buffer:
+    case opcode::destroy_image:
+        // resources are kept alive so the capture can be replayed in a loop
+        break;
+    case opcode::write_buffer: {
+        auto record = read_payload<write_record>(payload, size);
+        quix_assert(sizeof(write_record) + record.size <= size, "capture upload is truncated");
+
+        auto* buffer = find_buffer(record.id);
+        if (buffer == nullptr || buffer->get_alloc_info().pMappedData == nullptr) {
+            spdlog::warn("capture writes to buffer {} which is not mapped, skipping", record.id);
+            break;
+        }
+        memcpy(static_cast<char*>(buffer->get_mapped_data()) + record.offset, payload + sizeof(write_record), record.size);
+        break;
+    }
+    case opcode::create_pipeline:
+        stats.skipped_pipelines++;
+        break;
+    case opcode::begin_record: {
+        auto record = read_payload<list_record>(payload, size);
+        auto it = m_lists.find(record.list);
+        if (it == m_lists.end()) {
+            it = m_lists.emplace(record.list, m_command_pool.create_command_list()).first;
+        }
+
+        uint32_t slot = m_next_slot;
+        m_next_slot = (m_next_slot + 1) % max_timed_lists;
+        m_list_slots[record.list] = slot;
+
+        it->second->begin_record(record.flags);
+        vkCmdResetQueryPool(it->second->get_cmd_buffer(), m_query_pool, slot * 2, 2);
+        vkCmdWriteTimestamp(it->second->get_cmd_buffer(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_query_pool, slot * 2);
+        break;
+    }
+    case opcode::end_record: {
+        auto record = read_payload<list_record>(payload, size);
+        auto* list = find_list(record.list);
+        if (list == nullptr) {
+            break;
+        }
+        vkCmdWriteTimestamp(list->get_cmd_buffer(), VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_query_pool, m_list_slots[record.list] * 2 + 1);
+        list->end_record();
+        break;
+    }
+    case opcode::submit:
+        submit(read_payload<list_record>(payload, size).list, stats);
+        break;
+    case opcode::begin_render_pass:
+        stats.skipped_render_passes++;
+        break;
+    case opcode::end_render_pass:
+        break;
+    case opcode::copy_buffer_to_buffer: {
+        auto record = read_payload<copy_buffer_record>(payload, size);
+        auto* list = find_list(record.list);
+        auto* src = find_buffer(record.src);
+        auto* dst = find_buffer(record.dst);
+        if (list != nullptr && src != nullptr && dst != nullptr) {
+            list->copy_buffer_to_buffer(src->get_buffer(), record.src_offset, dst->get_buffer(), record.dst_offset, record.size);
+        }
+        break;
+    }
+    case opcode::copy_buffer_to_image: {
+        auto record = read_payload<copy_buffer_to_image_record>(payload, size);
+        auto* list = find_list(record.list);
+        auto* src = find_buffer(record.src);
+        auto* dst = find_image(record.dst);
+        if (list != nullptr && src != nullptr && dst != nullptr) {
+            list->copy_buffer_to_image(src->get_buffer(), dst, std::span<const VkBufferImageCopy>(&record.region, 1));
+        }
+        break;
+    }
+    case opcode::copy_image_to_image: {
+        auto record = read_payload<copy_image_record>(payload, size);
+        auto* list = find_list(record.list);
+        auto* src = find_image(record.src);
+        auto* dst = find_image(record.dst);
+        if (list != nullptr && src != nullptr && dst != nullptr) {
+            list->copy_image_to_image(src, record.src_offset, dst, record.dst_offset, record.aspect_mask);
+        }
+        break;
+    }
+    case opcode::image_barrier: {
+        auto record = read_payload<barrier_record>(payload, size);
+        auto* list = find_list(record.list);
+        auto* image = find_image(record.image);
+        if (list == nullptr || image == nullptr) {
+            break;
+        }
+
+        image_barrier_info barrier_info {};
+        barrier_info.old_layout = static_cast<VkImageLayout>(record.old_layout);
+        barrier_info.new_layout = static_cast<VkImageLayout>(record.new_layout);
+        barrier_info.src_access_mask = record.src_access_mask;
+        barrier_info.dst_access_mask = record.dst_access_mask;
+        barrier_info.src_stage = record.src_stage;
+        barrier_info.dst_stage = record.dst_stage;
+
+        list->image_barrier(image, &barrier_info, record.range);
+        break;
+    }
+    case opcode::generate_mips: {
+        auto record = read_payload<generate_mips_record>(payload, size);
+        auto* list = find_list(record.list);
+        auto* image = find_image(record.image);
+        if (list != nullptr && image != nullptr) {
+            list->generate_mips(image, static_cast<VkImageLayout>(record.final_layout));
+        }
+        break;
+    }
+    default:
+        spdlog::warn("unknown capture opcode {}, skipping", static_cast<uint32_t>(op));
+        break;
+    }
+}
+
+void player::submit(uint32_t list, replay_stats& stats)
+{
+    auto* cmd_list = find_list(list);
+    if (cmd_list == nullptr) {
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    cmd_list->submit(m_fence);
+    auto end = std::chrono::steady_clock::now();
+
+    stats.cpu_submit_ms += std::chrono::duration<double, std::milli>(end - start).count();
+    stats.submits++;
+
+    // each submit is waited on so its timestamps can be read back before the slot is reused
+    vkWaitForFences(m_logical_device, 1, &m_fence, VK_TRUE, UINT64_MAX);
+    vkResetFences(m_logical_device, 1, &m_fence);
+
+    std::array<uint64_t, 2> timestamps {};
+    VkResult result = vkGetQueryPoolResults(m_logical_device, m_query_pool, m_list_slots[list] * 2, 2,
+        sizeof(timestamps), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+
+    if (result == VK_SUCCESS) {
+        stats.transfer_gpu_ms += static_cast<double>(timestamps[1] - timestamps[0]) * m_timestamp_period / 1000000.0;
+    }
+}
+
+NODISCARD command_list* player::find_list(uint32_t list)
+{
+    auto it = m_lists.find(list);
+    if (it == m_lists.end()) {
+        spdlog::warn("capture references command list {} which was never begun", list);
+        return nullptr;
+    }
+    return it->second.get();
+}
+
+NODISCARD buffer_handle* player::find_buffer(uint32_t id)
+{
+    auto it = m_buffers.find(id);
+    return it == m_buffers.end() ? nullptr : it->second.get();
+}
+
+NODISCARD image_handle* player::find_image(uint32_t id)
+{
+    auto it = m_images.find(id);
+    return it == m_images.end() ? nullptr : it->second.get();
+}
+
+// player class end
+
+} // namespace quix::capture
+
+#endif // _QUIX_CAPTURE_CPP
@@ -0,0 +1,271 @@
+#ifndef _QUIX_CAPTURE_HPP
+#define _QUIX_CAPTURE_HPP
+
+#include "quix_commands.hpp"
+#include "quix_resource.hpp"
+
+namespace quix {
+
+class instance;
+
+// scope: captures are for bisecting upload, copy, barrier and mip generation regressions.
+// they do not reproduce a frame's cost. shaders, descriptor sets, binds and draws are
+// recorded straight into the vulkan command buffer by the caller and never pass through
+// quix, so pipelines and render passes are only summarized and the player skips them.
+// replaying the graphics stream would need spirv, descriptor contents and a draw stream
+// in the capture plus an offscreen target to draw into
+namespace capture {
+
+    // a capture file is the file header followed by records, every record is a
+    // record_header then a fixed payload struct and optionally raw bytes (uploads)
+    static constexpr uint32_t file_magic = 0x50435851; // "QXCP"
+    static constexpr uint32_t file_version = 2;
+
+    enum class opcode : uint32_t {
+        frame_end = 1,
+        create_buffer,
+        destroy_buffer,
+        create_image,
+        destroy_image,
+        write_buffer,
+        create_pipeline,
+        begin_record,
+        end_record,
+        submit,
+        begin_render_pass,
+        end_render_pass,
+        copy_buffer_to_buffer,
+        copy_buffer_to_image,
+        copy_image_to_image,
+        image_barrier,
+        generate_mips,
+    };
+
+    struct record_header {
+        opcode op;
+        uint32_t size;
+    };
+
+    struct buffer_record {
+        uint64_t size;
+        uint32_t id;
+        uint32_t usage;
+        uint32_t memory_usage;
+        uint32_t alloc_flags;
+    };
+
+    struct image_record {
+        uint32_t id;
+        uint32_t image_type;
+        uint32_t format;
+        uint32_t width;
+        uint32_t height;
+        uint32_t depth;
+        uint32_t mip_levels;
+        uint32_t array_layers;
+        uint32_t samples;
+        uint32_t tiling;
+        uint32_t usage;
+        uint32_t memory_usage;
+        uint32_t required_flags;
+    };
+
+    struct destroy_record {
+        uint32_t id;
+    };
+
+    // followed by size bytes of data
+    struct write_record {
+        uint64_t offset;
+        uint64_t size;
+        uint32_t id;
+        uint32_t padding;
+    };
+
+    struct pipeline_record {
+        uint32_t stage_count;
+        uint32_t vertex_binding_count;
+        uint32_t vertex_attribute_count;
+        uint32_t topology;
+        uint32_t polygon_mode;
+        uint32_t cull_mode;
+        uint32_t depth_test;
+        uint32_t set_layout_count;
+        uint32_t push_constant_count;
+    };
+
+    struct list_record {
+        uint32_t list;
+        uint32_t flags;
+    };
+
+    struct render_pass_record {
+        uint32_t list;
+        uint32_t width;
+        uint32_t height;
+        uint32_t clear_value_count;
+    };
+
+    struct copy_buffer_record {
+        uint64_t src_offset;
+        uint64_t dst_offset;
+        uint64_t size;
+        uint32_t list;
+        uint32_t src;
+        uint32_t dst;
+        uint32_t padding;
+    };
+
+    // one record per region, mip, layers and extent included
+    struct copy_buffer_to_image_record {
+        uint32_t list;
+        uint32_t src;
+        uint32_t dst;
+        uint32_t padding;
+        VkBufferImageCopy region;
+    };
+
+    struct copy_image_record {
+        uint32_t list;
+        uint32_t src;
+        uint32_t dst;
+        uint32_t aspect_mask;
+        VkOffset3D src_offset;
+        VkOffset3D dst_offset;
+    };
+
+    struct barrier_record {
+        uint32_t list;
+        uint32_t image;
+        uint32_t old_layout;
+        uint32_t new_layout;
+        uint32_t src_access_mask;
+        uint32_t dst_access_mask;
+        uint32_t src_stage;
+        uint32_t dst_stage;
+        VkImageSubresourceRange range;
+    };
+
+    struct generate_mips_record {
+        uint32_t list;
+        uint32_t image;
+        uint32_t final_layout;
+        uint32_t padding;
+    };
+
+    // records the api stream into a file, vulkan handles are replaced by ids so
+    // the capture can be replayed on another device. see the scope note above
+    // every function is thread safe since command lists can be recorded on any thread
+    class recorder {
+    public:
+        explicit recorder(const char* path);
+        ~recorder();
+
+        recorder(const recorder&) = delete;
+        recorder& operator=(const recorder&) = delete;
+        recorder(recorder&&) = delete;
+        recorder& operator=(recorder&&) = delete;
+
+        void flush();
+
+        void record_create_buffer(VkBuffer buffer, const VkBufferCreateInfo* create_info, const VmaAllocationCreateInfo* alloc_info);
+        void record_destroy_buffer(VkBuffer buffer);
+        void record_create_image(VkImage image, const VkImageCreateInfo* create_info, const VmaAllocationCreateInfo* alloc_info);
+        void record_destroy_image(VkImage image);
+        void record_write_buffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size);
+        void record_create_pipeline(const VkGraphicsPipelineCreateInfo* create_info, const VkPipelineLayoutCreateInfo* layout_info);
+
+        void record_begin(VkCommandBuffer cmd, VkCommandBufferUsageFlags flags);
+        void record_end(VkCommandBuffer cmd);
+        void record_submit(VkCommandBuffer cmd);
+        void record_begin_render_pass(VkCommandBuffer cmd, VkExtent2D extent, uint32_t clear_value_count);
+        void record_end_render_pass(VkCommandBuffer cmd);
+        void record_copy_buffer_to_buffer(VkCommandBuffer cmd, VkBuffer src, VkDeviceSize src_offset, VkBuffer dst, VkDeviceSize dst_offset, VkDeviceSize size);
+        void record_copy_buffer_to_image(VkCommandBuffer cmd, VkBuffer src, VkImage dst, const VkBufferImageCopy& region);
+        void record_copy_image_to_image(VkCommandBuffer cmd, VkImage src, VkOffset3D src_offset, VkImage dst, VkOffset3D dst_offset, VkImageAspectFlags aspect_mask);
+        void record_image_barrier(VkCommandBuffer cmd, VkImage image, VkImageLayout old_layout, VkImageLayout new_layout,
+            VkAccessFlags src_access_mask, VkAccessFlags dst_access_mask,
+            VkPipelineStageFlags src_stage, VkPipelineStageFlags dst_stage, const VkImageSubresourceRange& range);
+        void record_generate_mips(VkCommandBuffer cmd, VkImage image, VkImageLayout final_layout);
+        void record_frame_end();
+
+    private:
+        static constexpr std::size_t stream_flush_size = 1 << 20;
+
+        template <typename Payload>
+        void write(opcode op, const Payload& payload, const void* data = nullptr, uint32_t data_size = 0);
+        void append(const void* data, std::size_t size);
+        void flush_stream();
+
+        NODISCARD uint32_t get_id(uint64_t handle);
+        NODISCARD uint32_t release_id(uint64_t handle);
+
+        std::mutex m_mutex;
+        FILE* m_file = nullptr;
+        std::vector<char> m_stream;
+
+        std::unordered_map<uint64_t, uint32_t> m_ids;
+        uint32_t m_next_id = 1;
+    };
+
+    struct replay_stats {
+        double cpu_submit_ms {};
+        // gpu time of the replayed command lists, which only hold the transfer work and barriers
+        double transfer_gpu_ms {};
+        uint32_t submits {};
+        uint32_t frames {};
+        // seen in the capture but not executed, their gpu cost is missing from transfer_gpu_ms
+        uint32_t skipped_render_passes {};
+        uint32_t skipped_pipelines {};
+    };
+
+    // replays the transfer work of a capture without a swapchain. this is not a frame cost
+    // replay, render passes and pipelines are only counted
+    class player {
+    public:
+        explicit player(instance* p_instance);
+        ~player();
+
+        player(const player&) = delete;
+        player& operator=(const player&) = delete;
+        player(player&&) = delete;
+        player& operator=(player&&) = delete;
+
+        void load(const char* path);
+
+        // resources are created on the first replay and reused after that
+        replay_stats replay();
+
+    private:
+        static constexpr uint32_t max_timed_lists = 64;
+
+        void execute(opcode op, const char* payload, uint32_t size, replay_stats& stats);
+        void submit(uint32_t list, replay_stats& stats);
+
+        NODISCARD command_list* find_list(uint32_t list);
+        NODISCARD buffer_handle* find_buffer(uint32_t id);
+        NODISCARD image_handle* find_image(uint32_t id);
+
+        instance* m_instance;
+        VkDevice m_logical_device;
+        float m_timestamp_period;
+
+        std::vector<char> m_stream;
+
+        command_pool m_command_pool;
+        std::unordered_map<uint32_t, allocated_unique_ptr<command_list>> m_lists;
+        std::unordered_map<uint32_t, uint32_t> m_list_slots;
+        uint32_t m_next_slot = 0;
+
+        std::unordered_map<uint32_t, std::unique_ptr<buffer_handle>> m_buffers;
+        std::unordered_map<uint32_t, std::unique_ptr<image_handle>> m_images;
+
+        VkQueryPool m_query_pool = VK_NULL_HANDLE;
+        VkFence m_fence = VK_NULL_HANDLE;
+    };
+
+} // namespace capture
+
+} // namespace quix
+
+#endif // _QUIX_CAPTURE_HPP
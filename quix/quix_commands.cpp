@@ -3,10 +3,13 @@
 
 #include "quix_commands.hpp"
 
+#include "quix_capture.hpp"
 #include "quix_device.hpp"
 #include "quix_pipeline.hpp"
+#include "quix_readback.hpp"
 #include "quix_render_target.hpp"
 #include "quix_resource.hpp"
+#include "quix_stats.hpp"
 #include "quix_swapchain.hpp"
 
 namespace quix {
@@ -26,7 +29,13 @@ sync::~sync()
 
 void sync::wait_for_fence(const int frame)
 {
+    scoped_frame_timer timer(m_device->get_frame_stats(), frame_metric::fence_wait);
     vkWaitForFences(m_device->get_logical_device(), 1, &m_fences[frame], VK_TRUE, UINT64_MAX);
+
+    // swapchain, framebuffer and depth images retired on resize are freed from here when frame_manager is not used
+    if (m_gpu_frames[frame] != 0) {
+        m_device->collect_garbage(m_gpu_frames[frame]);
+    }
 }
 
 void sync::reset_fence(const int frame)
@@ -36,12 +45,26 @@ void sync::reset_fence(const int frame)
 
 VkResult sync::acquire_next_image(const int frame, uint32_t* image_index)
 {
-    vkWaitForFences(m_device->get_logical_device(), 1, &m_fences[frame], VK_TRUE, UINT64_MAX);
+    wait_for_fence(frame);
+
+    scoped_frame_timer timer(m_device->get_frame_stats(), frame_metric::acquire);
     return vkAcquireNextImageKHR(m_device->get_logical_device(), m_swapchain->get_swapchain(), UINT64_MAX, m_available_semaphores[frame], VK_NULL_HANDLE, image_index);
 }
 
 VkResult sync::submit_frame(const int frame, command_list* command)
 {
+    auto& stats = m_device->get_frame_stats();
+    const auto now = std::chrono::steady_clock::now();
+    if (m_last_submit != std::chrono::steady_clock::time_point {}) {
+        stats.record(frame_metric::cpu_frame, std::chrono::duration<double, std::milli>(now - m_last_submit).count());
+    }
+    m_last_submit = now;
+    stats.tick();
+
+    if (auto* recorder = m_device->get_recorder()) {
+        recorder->record_submit(command->get_cmd_buffer());
+    }
+
     VkSubmitInfo submitInfo {};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
@@ -58,6 +81,9 @@ VkResult sync::submit_frame(const int frame, command_list* command)
     submitInfo.signalSemaphoreCount = 1;
     submitInfo.pSignalSemaphores = signalSemaphores;
 
+    m_gpu_frames[frame] = m_device->begin_gpu_frame();
+
+    auto lock = m_device->lock_queue(m_device->get_graphics_queue());
     return vkQueueSubmit(m_device->get_graphics_queue(), 1, &submitInfo, m_fences[frame]);
 }
 
@@ -76,17 +102,24 @@ VkResult sync::present_frame(const int frame, const uint32_t image_index)
     presentInfo.pImageIndices = &image_index;
     presentInfo.pResults = nullptr; // Optional
 
+    if (auto* recorder = m_device->get_recorder()) {
+        recorder->record_frame_end();
+    }
+
+    scoped_frame_timer timer(m_device->get_frame_stats(), frame_metric::present);
+    auto lock = m_device->lock_queue(m_device->get_present_queue());
     return vkQueuePresentKHR(m_device->get_present_queue(), &presentInfo);
 }
 
 void sync::create_sync_objects()
 {
-    m_sync_buffer = malloc(sizeof(VkSemaphore) * (m_frames_in_flight * 2) + sizeof(VkFence) * m_frames_in_flight);
+    m_sync_buffer = malloc(sizeof(VkSemaphore) * (m_frames_in_flight * 2) + sizeof(VkFence) * m_frames_in_flight + sizeof(uint64_t) * m_frames_in_flight);
     quix_assert(m_sync_buffer != nullptr, "failed to allocate memory for synchronization objects");
 
     m_fences = (VkFence*)m_sync_buffer;
     m_available_semaphores = (VkSemaphore*)((char*)m_sync_buffer + sizeof(VkFence) * m_frames_in_flight);
     m_finished_semaphores = (VkSemaphore*)((char*)m_sync_buffer + sizeof(VkFence) * m_frames_in_flight + sizeof(VkSemaphore) * m_frames_in_flight);
+    m_gpu_frames = (uint64_t*)((char*)m_sync_buffer + sizeof(VkFence) * m_frames_in_flight + sizeof(VkSemaphore) * m_frames_in_flight * 2);
 
     VkSemaphoreCreateInfo semaphoreInfo {};
     semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
@@ -99,6 +132,7 @@ void sync::create_sync_objects()
         VK_CHECK(vkCreateSemaphore(m_device->get_logical_device(), &semaphoreInfo, nullptr, &m_available_semaphores[i]), "failed to create semaphore");
         VK_CHECK(vkCreateSemaphore(m_device->get_logical_device(), &semaphoreInfo, nullptr, &m_finished_semaphores[i]), "failed to create semaphore");
         VK_CHECK(vkCreateFence(m_device->get_logical_device(), &fenceInfo, nullptr, &m_fences[i]), "failed to create fence");
+        m_gpu_frames[i] = 0;
     }
 }
 
@@ -129,10 +163,18 @@ void command_list::begin_record(VkCommandBufferUsageFlags flags)
     begin_info.pInheritanceInfo = nullptr; // for secondary command buffers
 
     VK_CHECK(vkBeginCommandBuffer(buffer, &begin_info), "failed to begin command buffer record");
+
+    if (auto* recorder = m_device->get_recorder()) {
+        recorder->record_begin(buffer, flags);
+    }
 }
 
 void command_list::end_record()
 {
+    if (auto* recorder = m_device->get_recorder()) {
+        recorder->record_end(buffer);
+    }
+
     VK_CHECK(vkEndCommandBuffer(buffer), "failed to record command buffer!");
 }
 
@@ -152,6 +194,10 @@ void command_list::begin_render_pass(const render_target& r_target, const std::s
 
     vkCmdBeginRenderPass(buffer, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
 
+    if (auto* recorder = m_device->get_recorder()) {
+        recorder->record_begin_render_pass(buffer, render_area.extent, clear_value_count);
+    }
+
     vkCmdBindPipeline(buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, p_pipeline->get_pipeline());
 
     VkViewport viewport {};
@@ -174,6 +220,10 @@ void command_list::begin_render_pass(const render_target& r_target, const std::s
 void command_list::end_render_pass()
 {
     vkCmdEndRenderPass(buffer);
+
+    if (auto* recorder = m_device->get_recorder()) {
+        recorder->record_end_render_pass(buffer);
+    }
 }
 
 void command_list::copy_buffer_to_buffer(VkBuffer src_buffer, VkDeviceSize src_offset, VkBuffer dst_buffer, VkDeviceSize dst_offset, VkDeviceSize size)
@@ -184,6 +234,10 @@ void command_list::copy_buffer_to_buffer(VkBuffer src_buffer, VkDeviceSize src_o
     copy_region.size = size;
 
     vkCmdCopyBuffer(buffer, src_buffer, dst_buffer, 1, &copy_region);
+
+    if (auto* recorder = m_device->get_recorder()) {
+        recorder->record_copy_buffer_to_buffer(buffer, src_buffer, src_offset, dst_buffer, dst_offset, size);
+    }
 }
 
 void command_list::copy_buffer_to_image(VkBuffer src_buffer, VkDeviceSize buffer_offset, image_handle* dst_image, VkOffset3D image_offset, VkImageAspectFlags aspect_mask)
@@ -205,6 +259,24 @@ void command_list::copy_buffer_to_image(VkBuffer src_buffer, VkDeviceSize buffer
         buffer, src_buffer,
         dst_image->get_image(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
         1, &copy_region);
+
+    if (auto* recorder = m_device->get_recorder()) {
+        recorder->record_copy_buffer_to_image(buffer, src_buffer, dst_image->get_image(), copy_region);
+    }
+}
+
+void command_list::copy_buffer_to_image(VkBuffer src_buffer, image_handle* dst_image, std::span<const VkBufferImageCopy> regions)
+{
+    vkCmdCopyBufferToImage(
+        buffer, src_buffer,
+        dst_image->get_image(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        static_cast<uint32_t>(regions.size()), regions.data());
+
+    if (auto* recorder = m_device->get_recorder()) {
+        for (const auto& region : regions) {
+            recorder->record_copy_buffer_to_image(buffer, src_buffer, dst_image->get_image(), region);
+        }
+    }
 }
 
 void command_list::copy_image_to_image(image_handle* src, VkOffset3D src_offset, image_handle* dst, VkOffset3D dst_offset, VkImageAspectFlags aspect_mask)
@@ -226,9 +298,25 @@ void command_list::copy_image_to_image(image_handle* src, VkOffset3D src_offset,
     vkCmdCopyImage(buffer, src->get_image(),
         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dst->get_image(),
         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy_region);
+
+    if (auto* recorder = m_device->get_recorder()) {
+        recorder->record_copy_image_to_image(buffer, src->get_image(), src_offset, dst->get_image(), dst_offset, aspect_mask);
+    }
 }
 
 void command_list::image_barrier(image_handle* image, image_barrier_info* barrier_info, VkImageAspectFlags aspect_mask)
+{
+    VkImageSubresourceRange range {};
+    range.aspectMask = aspect_mask;
+    range.baseMipLevel = 0;
+    range.levelCount = image->m_mip_levels;
+    range.baseArrayLayer = 0;
+    range.layerCount = image->m_array_layers;
+
+    image_barrier(image, barrier_info, range);
+}
+
+void command_list::image_barrier(image_handle* image, image_barrier_info* barrier_info, const VkImageSubresourceRange& range)
 {
     VkImageMemoryBarrier memory_barrier_info {};
     memory_barrier_info.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -238,11 +326,7 @@ void command_list::image_barrier(image_handle* image, image_barrier_info* barrie
     memory_barrier_info.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
     memory_barrier_info.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 
-    memory_barrier_info.subresourceRange.aspectMask = aspect_mask;
-    memory_barrier_info.subresourceRange.baseMipLevel = 0;
-    memory_barrier_info.subresourceRange.levelCount = image->m_mip_levels;
-    memory_barrier_info.subresourceRange.baseArrayLayer = 0;
-    memory_barrier_info.subresourceRange.layerCount = image->m_array_layers;
+    memory_barrier_info.subresourceRange = range;
 
     memory_barrier_info.srcAccessMask = barrier_info->src_access_mask;
     memory_barrier_info.dstAccessMask = barrier_info->dst_access_mask;
@@ -254,6 +338,121 @@ void command_list::image_barrier(image_handle* image, image_barrier_info* barrie
         0, nullptr,
         0, nullptr,
         1, &memory_barrier_info);
+
+    if (auto* recorder = m_device->get_recorder()) {
+        recorder->record_image_barrier(buffer, image->get_image(), barrier_info->old_layout, barrier_info->new_layout,
+            barrier_info->src_access_mask, barrier_info->dst_access_mask,
+            barrier_info->src_stage, barrier_info->dst_stage, range);
+    }
+}
+
+static void mip_barrier(VkCommandBuffer buffer, VkImage image, uint32_t base_mip, uint32_t mip_count, uint32_t layer_count,
+    VkImageLayout old_layout, VkImageLayout new_layout, VkAccessFlags src_access_mask, VkAccessFlags dst_access_mask,
+    VkPipelineStageFlags src_stage, VkPipelineStageFlags dst_stage)
+{
+    VkImageMemoryBarrier barrier {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.image = image;
+    barrier.oldLayout = old_layout;
+    barrier.newLayout = new_layout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = base_mip;
+    barrier.subresourceRange.levelCount = mip_count;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = layer_count;
+    barrier.srcAccessMask = src_access_mask;
+    barrier.dstAccessMask = dst_access_mask;
+
+    vkCmdPipelineBarrier(buffer, src_stage, dst_stage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+void command_list::generate_mips(image_handle* image, VkImageLayout final_layout)
+{
+    const uint32_t levels = image->m_mip_levels;
+    const uint32_t layers = image->m_array_layers;
+
+    if (levels > 1) {
+        // every mip below the first in one go
+        mip_barrier(buffer, image->get_image(), 1, levels - 1, layers,
+            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            0, VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    }
+
+    auto width = static_cast<int32_t>(image->m_extent.width);
+    auto height = static_cast<int32_t>(image->m_extent.height);
+
+    for (uint32_t level = 1; level < levels; level++) {
+        const int32_t next_width = std::max(width / 2, 1);
+        const int32_t next_height = std::max(height / 2, 1);
+
+        VkImageBlit blit {};
+        blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.srcSubresource.mipLevel = level - 1;
+        blit.srcSubresource.baseArrayLayer = 0;
+        blit.srcSubresource.layerCount = layers;
+        blit.srcOffsets[1] = { width, height, 1 };
+        blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.dstSubresource.mipLevel = level;
+        blit.dstSubresource.baseArrayLayer = 0;
+        blit.dstSubresource.layerCount = layers;
+        blit.dstOffsets[1] = { next_width, next_height, 1 };
+
+        vkCmdBlitImage(buffer,
+            image->get_image(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            image->get_image(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            1, &blit, VK_FILTER_LINEAR);
+
+        // the level just written is the source of the next blit
+        mip_barrier(buffer, image->get_image(), level, 1, layers,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+        width = next_width;
+        height = next_height;
+    }
+
+    // the whole chain is in transfer src now, move it to its final layout at once
+    mip_barrier(buffer, image->get_image(), 0, levels, layers,
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, final_layout,
+        VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+
+    if (auto* recorder = m_device->get_recorder()) {
+        recorder->record_generate_mips(buffer, image->get_image(), final_layout);
+    }
+}
+
+NODISCARD std::future<readback_result> command_list::readback(VkBuffer src_buffer, VkDeviceSize offset, VkDeviceSize size)
+{
+    return m_device->get_readback_ring().readback_buffer(this, src_buffer, offset, size);
+}
+
+NODISCARD std::future<readback_result> command_list::readback(buffer_handle* src_buffer, VkDeviceSize offset, VkDeviceSize size)
+{
+    return readback(src_buffer->get_buffer(), offset, size);
+}
+
+NODISCARD std::future<readback_result> command_list::readback(image_handle* src_image, VkImageLayout current_layout, uint32_t mip_level, VkImageAspectFlags aspect_mask)
+{
+    quix_assert(mip_level < src_image->get_mip_levels(), "readback of a mip the image does not have");
+
+    const VkImageSubresourceLayers subresource { aspect_mask, mip_level, 0, src_image->get_array_layers() };
+    return readback(src_image->get_image(), src_image->get_format(), src_image->get_extent(), current_layout, subresource);
+}
+
+NODISCARD std::future<readback_result> command_list::readback(VkImage src_image, VkFormat format, VkExtent3D extent, VkImageLayout current_layout,
+    const VkImageSubresourceLayers& subresource)
+{
+    return m_device->get_readback_ring().readback_image(this, src_image, format, extent, current_layout, subresource);
+}
+
+void command_list::push_addresses(const graphics::pipeline& p_pipeline, const address_push_constants& constants, VkShaderStageFlags stages)
+{
+    vkCmdPushConstants(buffer, p_pipeline.get_layout(), stages, 0, sizeof(address_push_constants), &constants);
 }
 
 void command_list::submit(VkFence fence)
@@ -263,6 +462,11 @@ void command_list::submit(VkFence fence)
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &buffer;
 
+    if (auto* recorder = m_device->get_recorder()) {
+        recorder->record_submit(buffer);
+    }
+
+    auto lock = m_device->lock_queue(m_device->get_graphics_queue());
     VK_CHECK(vkQueueSubmit(m_device->get_graphics_queue(), 1, &submitInfo, fence), "failed to submit command buffer");
 }
 
@@ -277,6 +481,11 @@ command_pool::~command_pool()
     m_device->return_command_pool(pool);
 }
 
+void command_pool::reset()
+{
+    VK_CHECK(vkResetCommandPool(m_device->get_logical_device(), pool, 0), "failed to reset command pool");
+}
+
 NODISCARD allocated_unique_ptr<command_list> command_pool::create_command_list(VkCommandBufferLevel level)
 {
     VkCommandBufferAllocateInfo alloc_info {};
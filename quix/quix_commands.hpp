@@ -11,7 +11,9 @@ namespace graphics {
     class pipeline;
 }
 class command_list;
+class buffer_handle;
 class image_handle;
+struct readback_result;
 
 class sync {
 public:
@@ -41,6 +43,10 @@ private:
     VkFence* m_fences = nullptr;
     VkSemaphore* m_available_semaphores = nullptr;
     VkSemaphore* m_finished_semaphores = nullptr;
+    // device gpu frame submitted on each slot, garbage is collected once its fence is waited on
+    uint64_t* m_gpu_frames = nullptr;
+
+    std::chrono::steady_clock::time_point m_last_submit {};
 };
 
 struct image_barrier_info {
@@ -52,6 +58,18 @@ struct image_barrier_info {
     VkPipelineStageFlags dst_stage{};
 };
 
+// push constant convention for pointer based shader data, the pipeline declares
+// add_push_constant(stages, sizeof(address_push_constants)) and the shaders mirror the layout with GL_EXT_buffer_reference:
+//   layout(push_constant) uniform address_push_constants { draw_data draws; object_data objects; uint64_t unused[2]; uint draw_index; };
+// unused addresses stay 0. per draw data is then read through draws[draw_index] without any descriptor set
+struct address_push_constants {
+    static constexpr uint32_t max_addresses = 4;
+
+    std::array<VkDeviceAddress, max_addresses> addresses {};
+    uint32_t draw_index {};
+    uint32_t padding {};
+};
+
 class command_list {
 public:
     command_list(weakref<device> p_device, VkCommandBuffer buffer);
@@ -74,10 +92,33 @@ public:
     void copy_buffer_to_buffer(VkBuffer src_buffer, VkDeviceSize src_offset, VkBuffer dst_buffer, VkDeviceSize dst_offset, VkDeviceSize size);
     // if the image is something like a depth image and or a stencil image, will need VK_IMAGE_ASPECT_DEPTH_BIT and or VK_IMAGE_ASPECT_STENCIL_BIT
     void copy_buffer_to_image(VkBuffer src_buffer, VkDeviceSize buffer_offset, image_handle* dst_image, VkOffset3D image_offset, VkImageAspectFlags aspect_mask = VK_IMAGE_ASPECT_COLOR_BIT);
+    // explicit regions for individual mips and layers, the image has to be in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+    void copy_buffer_to_image(VkBuffer src_buffer, image_handle* dst_image, std::span<const VkBufferImageCopy> regions);
     // if the image is something like a depth image and or a stencil image, will need VK_IMAGE_ASPECT_DEPTH_BIT and or VK_IMAGE_ASPECT_STENCIL_BIT
     void copy_image_to_image(image_handle* src, VkOffset3D src_offset, image_handle* dst, VkOffset3D dst_offset, VkImageAspectFlags aspect_mask = VK_IMAGE_ASPECT_COLOR_BIT);
 
     void image_barrier(image_handle* image, image_barrier_info* barrier_info, VkImageAspectFlags aspect_mask = VK_IMAGE_ASPECT_COLOR_BIT);
+    // only transitions the given mips and layers, the rest of the image keeps its contents
+    void image_barrier(image_handle* image, image_barrier_info* barrier_info, const VkImageSubresourceRange& range);
+
+    // blits every mip from the one above it. mip 0 has to be in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+    // the other mips are discarded. the whole image ends up in final_layout
+    void generate_mips(image_handle* image, VkImageLayout final_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    // copies through the device's readback_ring, only valid on a frame's command list. the future resolves a
+    // couple of frames after this one was submitted, see readback_ring
+    NODISCARD std::future<readback_result> readback(VkBuffer src_buffer, VkDeviceSize offset, VkDeviceSize size);
+    NODISCARD std::future<readback_result> readback(buffer_handle* src_buffer, VkDeviceSize offset, VkDeviceSize size);
+    // every layer of one mip, the image is left in current_layout
+    NODISCARD std::future<readback_result> readback(image_handle* src_image, VkImageLayout current_layout, uint32_t mip_level = 0,
+        VkImageAspectFlags aspect_mask = VK_IMAGE_ASPECT_COLOR_BIT);
+    // for images quix does not own, like the swapchain images
+    NODISCARD std::future<readback_result> readback(VkImage src_image, VkFormat format, VkExtent3D extent, VkImageLayout current_layout,
+        const VkImageSubresourceLayers& subresource);
+
+    // the pipeline's layout has to declare the address_push_constants range for the stages
+    void push_addresses(const graphics::pipeline& p_pipeline, const address_push_constants& constants,
+        VkShaderStageFlags stages = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
 
     void submit(VkFence fence = VK_NULL_HANDLE);
 
@@ -102,6 +143,9 @@ public:
 
     NODISCARD allocated_unique_ptr<command_list> create_command_list(VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
 
+    // every command list from this pool goes back to the initial state, none of them may be pending
+    void reset();
+
 private:
     std::pmr::unsynchronized_pool_resource m_allocator;
     weakref<device> m_device;
@@ -15,7 +15,9 @@ namespace quix::descriptor {
 
     allocator_pool::~allocator_pool()
     {
-        returnPool();
+        if (currentPool != VK_NULL_HANDLE) {
+            returnPool();
+        }
     }
 
     void allocator_pool::returnPool()
@@ -27,6 +29,14 @@ namespace quix::descriptor {
         m_allocator->returnPool(*this);
     }
 
+    void allocator_pool::reset()
+    {
+        if (currentPool == VK_NULL_HANDLE) {
+            return;
+        }
+        m_allocator->returnPool(*this);
+    }
+
     VkDescriptorSet allocator_pool::allocate(VkDescriptorSetLayout layout)
     {
         VkDescriptorSet set;
@@ -146,10 +156,12 @@ namespace quix::descriptor {
     {
         VkDescriptorPool currentPool;
 
+        // frame contexts borrow pools from the render thread, so the check has to happen under the lock too
+        std::unique_lock<std::mutex> lock(poolMutex);
         if (availablePools.size() == 0) {
+            lock.unlock();
             currentPool = createDescriptorPool(1000, VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT); // TODO maybe set to framesinflight? idk
         } else {
-            std::lock_guard<std::mutex> lock(poolMutex);
             currentPool = availablePools.front();
             availablePools.pop_front();
         }
@@ -220,6 +232,13 @@ namespace quix::descriptor {
             });
         }
 
+        // layouts that only differ in their immutable samplers are different layouts
+        for (const VkDescriptorSetLayoutBinding& b : layoutinfo.bindings) {
+            for (uint32_t i = 0; i < b.descriptorCount; i++) {
+                layoutinfo.immutable_samplers.push_back(b.pImmutableSamplers != nullptr ? b.pImmutableSamplers[i] : VK_NULL_HANDLE);
+            }
+        }
+
         // try to grab from cache
         layoutCacheMutex.lock();
         auto it = layoutCache.find(layoutinfo);
@@ -258,7 +277,7 @@ namespace quix::descriptor {
                     return false;
                 }
             }
-            return true;
+            return other.immutable_samplers == immutable_samplers;
         }
     }
 
@@ -277,6 +296,10 @@ namespace quix::descriptor {
             result ^= hash<size_t>()(binding_hash);
         }
 
+        for (VkSampler sampler : immutable_samplers) {
+            result ^= hash<VkSampler>()(sampler);
+        }
+
         return result;
     }
 
@@ -303,6 +326,7 @@ namespace quix::descriptor {
         newBinding.binding = binding;
 
         bindings.push_back(newBinding);
+        immutableSamplers.push_back(VK_NULL_HANDLE);
 
         // create the descriptor write
         VkWriteDescriptorSet newWrite {};
@@ -331,6 +355,7 @@ namespace quix::descriptor {
         newBinding.binding = binding;
 
         bindings.push_back(newBinding);
+        immutableSamplers.push_back(VK_NULL_HANDLE);
 
         // create the descriptor write
         VkWriteDescriptorSet newWrite {};
@@ -347,6 +372,16 @@ namespace quix::descriptor {
         return *this;
     }
 
+    builder& builder::bind_image(uint32_t binding, VkDescriptorType type, VkShaderStageFlags stageFlags, VkSampler immutable_sampler)
+    {
+        quix_assert(type == VK_DESCRIPTOR_TYPE_SAMPLER || type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, "only sampler bindings can have immutable samplers");
+
+        bind_image(binding, type, stageFlags);
+        immutableSamplers.back() = immutable_sampler;
+
+        return *this;
+    }
+
     builder& builder::update_buffer(uint32_t binding, VkDescriptorBufferInfo* bufferInfo)
     {
         writes[binding].pBufferInfo = bufferInfo;
@@ -367,6 +402,11 @@ namespace quix::descriptor {
         layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
         layoutInfo.pNext = nullptr;
 
+        // the vector does not move anymore, point the bindings at their samplers
+        for (std::size_t i = 0; i < bindings.size(); i++) {
+            bindings[i].pImmutableSamplers = immutableSamplers[i] != VK_NULL_HANDLE ? &immutableSamplers[i] : nullptr;
+        }
+
         layoutInfo.pBindings = bindings.data();
         layoutInfo.bindingCount = bindings.size();
 
@@ -381,12 +421,18 @@ namespace quix::descriptor {
         // allocate descriptor
         VkDescriptorSet set = alloc->allocate(layout);
 
-        // write descriptor
-        for (VkWriteDescriptorSet& w : writes) {
-            w.dstSet = set;
+        // write descriptor, immutable samplers are part of the layout and must not be written
+        std::vector<VkWriteDescriptorSet> setWrites;
+        setWrites.reserve(writes.size());
+        for (std::size_t i = 0; i < writes.size(); i++) {
+            if (writes[i].descriptorType == VK_DESCRIPTOR_TYPE_SAMPLER && immutableSamplers[i] != VK_NULL_HANDLE) {
+                continue;
+            }
+            writes[i].dstSet = set;
+            setWrites.push_back(writes[i]);
         }
 
-        vkUpdateDescriptorSets(alloc->m_allocator->getDevice(), writes.size(), writes.data(), 0, nullptr);
+        vkUpdateDescriptorSets(alloc->m_allocator->getDevice(), setWrites.size(), setWrites.data(), 0, nullptr);
 
         return set;
     }
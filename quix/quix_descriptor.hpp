@@ -20,6 +20,8 @@ namespace descriptor {
         allocator_pool& operator=(allocator_pool&& other) = delete;
 
         void returnPool();
+        // returns every borrowed pool, unlike returnPool it is fine to call when nothing was allocated
+        void reset();
     private:
         VkDescriptorSet allocate(VkDescriptorSetLayout layout);
 
@@ -73,6 +75,8 @@ namespace descriptor {
         struct descriptor_layout_info {
             // good idea to turn this into an inlined array
             std::vector<VkDescriptorSetLayoutBinding> bindings;
+            // descriptorCount entries per binding in binding order, VK_NULL_HANDLE for bindings without immutable samplers
+            std::vector<VkSampler> immutable_samplers;
 
             bool operator==(const descriptor_layout_info& other) const;
 
@@ -99,6 +103,9 @@ namespace descriptor {
 
         builder& bind_buffer(uint32_t binding, VkDescriptorType type, VkShaderStageFlags stageFlags);
         builder& bind_image(uint32_t binding, VkDescriptorType type, VkShaderStageFlags stageFlags);
+        // bakes the sampler into the layout, take it from the device's sampler_cache so it outlives the layout.
+        // VK_DESCRIPTOR_TYPE_SAMPLER bindings need no update_image then, combined image samplers still take the view
+        builder& bind_image(uint32_t binding, VkDescriptorType type, VkShaderStageFlags stageFlags, VkSampler immutable_sampler);
 
         builder& update_buffer(uint32_t binding, VkDescriptorBufferInfo* bufferInfo);
         builder& update_image(uint32_t binding, VkDescriptorImageInfo* imageInfo);
@@ -110,6 +117,8 @@ namespace descriptor {
     private:
         std::vector<VkWriteDescriptorSet> writes;
         std::vector<VkDescriptorSetLayoutBinding> bindings;
+        // one per binding, pointed to by the bindings once the layout is built
+        std::vector<VkSampler> immutableSamplers;
 
         VkDescriptorSetLayout layout;
 
@@ -3,6 +3,11 @@
 
 #include "quix_device.hpp"
 
+#include "quix_handle_table.hpp"
+#include "quix_readback.hpp"
+#include "quix_sampler_cache.hpp"
+#include "quix_resource.hpp"
+#include "quix_stats.hpp"
 #include "quix_window.hpp"
 
 namespace quix {
@@ -13,6 +18,7 @@ device::device(weakref<window> p_window,
     const char* engine_name,
     uint32_t engine_version)
     : m_window(p_window)
+    , m_frame_stats(std::make_unique<frame_stats>())
 {
 
     glslang::InitializeProcess();
@@ -33,10 +39,47 @@ device::~device()
     }
 #endif
 
+    vkDeviceWaitIdle(m_logical_device);
+    for (auto& garbage : m_garbage) {
+        garbage.destroy();
+    }
+    m_garbage.clear();
+
+    m_buffer_table.reset();
+    m_image_table.reset();
+    // every readback resolved with the garbage, this only waits for the pending saves
+    m_readback_ring.reset();
+    // images and descriptor layouts that use the samplers are gone by now
+    m_sampler_cache.reset();
+
+    {
+        std::lock_guard<std::mutex> lock(m_memory_tag_mutex);
+        for (const auto& [tag, stats] : m_memory_tags) {
+            spdlog::warn("leaked {} handles tagged {}, {} bytes", stats.count, tag, stats.bytes);
+        }
+    }
+
+    // the garbage above retired the old objects of a running pass, the copies may still be in flight
+    if (m_defrag.context != VK_NULL_HANDLE) {
+        if (m_defrag.pass_running) {
+            VK_CHECK(vkWaitForFences(m_logical_device, 1, &m_defrag.fence, VK_TRUE, UINT64_MAX), "failed to wait for defragmentation fence");
+            end_defragment_pass();
+        }
+        end_defragmentation();
+    }
+
     for (auto& pool : m_command_pools) {
         vkDestroyCommandPool(m_logical_device, pool, nullptr);
     }
 
+    // everything the device owns is gone, whatever is left was never destroyed by its owner
+    VmaTotalStatistics leaked {};
+    vmaCalculateStatistics(m_allocator, &leaked);
+    if (leaked.total.statistics.allocationCount > 0) {
+        spdlog::error("{} allocations, {} bytes, are still alive when the device is destroyed",
+            leaked.total.statistics.allocationCount, leaked.total.statistics.allocationBytes);
+    }
+
     vmaDestroyAllocator(m_allocator);
 
     vkDestroyDevice(m_logical_device, nullptr);
@@ -64,6 +107,9 @@ void device::init(std::vector<const char*>&& requested_extensions, VkPhysicalDev
 
     pick_physical_device();
 
+    query_host_image_copy_support();
+    query_buffer_device_address_support();
+
     create_logical_device();
 
     create_allocator();
@@ -102,6 +148,676 @@ void device::return_command_pool(VkCommandPool command_pool)
     }
 }
 
+NODISCARD bool device::get_format_supported(VkFormat format, VkFormatFeatureFlags features) const
+{
+    if (format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK && !requested_features.textureCompressionBC) {
+        return false;
+    }
+    if (format >= VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK && format <= VK_FORMAT_EAC_R11G11_SNORM_BLOCK && !requested_features.textureCompressionETC2) {
+        return false;
+    }
+    if (format >= VK_FORMAT_ASTC_4x4_UNORM_BLOCK && format <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK && !requested_features.textureCompressionASTC_LDR) {
+        return false;
+    }
+
+    VkFormatProperties properties {};
+    vkGetPhysicalDeviceFormatProperties(m_physical_device, format, &properties);
+    return (properties.optimalTilingFeatures & features) == features;
+}
+
+NODISCARD bool device::get_host_image_copy_supported(const VkImageCreateInfo& image_info) const
+{
+    if (!host_image_copy_supported || m_recorder != nullptr) {
+        return false;
+    }
+
+    VkPhysicalDeviceImageFormatInfo2 format_info {};
+    format_info.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_FORMAT_INFO_2;
+    format_info.format = image_info.format;
+    format_info.type = image_info.imageType;
+    format_info.tiling = image_info.tiling;
+    format_info.usage = image_info.usage | VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT;
+    format_info.flags = image_info.flags;
+
+    VkHostImageCopyDevicePerformanceQueryEXT performance {};
+    performance.sType = VK_STRUCTURE_TYPE_HOST_IMAGE_COPY_DEVICE_PERFORMANCE_QUERY_EXT;
+
+    VkImageFormatProperties2 properties {};
+    properties.sType = VK_STRUCTURE_TYPE_IMAGE_FORMAT_PROPERTIES_2;
+    properties.pNext = &performance;
+
+    // some drivers store host copyable images in a layout the gpu reads slower, staging wins for those
+    if (vkGetPhysicalDeviceImageFormatProperties2(m_physical_device, &format_info, &properties) != VK_SUCCESS) {
+        return false;
+    }
+    return performance.optimalDeviceAccess == VK_TRUE;
+}
+
+void device::host_copy_to_image(VkImage image, const uint8_t* data, std::span<const VkBufferImageCopy> regions, const VkImageSubresourceRange& range)
+{
+    quix_assert(host_image_copy_supported, "VK_EXT_host_image_copy is not enabled");
+
+    VkHostImageLayoutTransitionInfoEXT transition {};
+    transition.sType = VK_STRUCTURE_TYPE_HOST_IMAGE_LAYOUT_TRANSITION_INFO_EXT;
+    transition.image = image;
+    transition.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    transition.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    transition.subresourceRange = range;
+    VK_CHECK(m_transition_image_layout(m_logical_device, 1, &transition), "failed to transition image layout on the host");
+
+    std::vector<VkMemoryToImageCopyEXT> copies(regions.size());
+    for (std::size_t i = 0; i < regions.size(); i++) {
+        copies[i].sType = VK_STRUCTURE_TYPE_MEMORY_TO_IMAGE_COPY_EXT;
+        copies[i].pHostPointer = data + regions[i].bufferOffset;
+        copies[i].memoryRowLength = regions[i].bufferRowLength;
+        copies[i].memoryImageHeight = regions[i].bufferImageHeight;
+        copies[i].imageSubresource = regions[i].imageSubresource;
+        copies[i].imageOffset = regions[i].imageOffset;
+        copies[i].imageExtent = regions[i].imageExtent;
+    }
+
+    VkCopyMemoryToImageInfoEXT copy_info {};
+    copy_info.sType = VK_STRUCTURE_TYPE_COPY_MEMORY_TO_IMAGE_INFO_EXT;
+    copy_info.dstImage = image;
+    copy_info.dstImageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    copy_info.regionCount = static_cast<uint32_t>(copies.size());
+    copy_info.pRegions = copies.data();
+    VK_CHECK(m_copy_memory_to_image(m_logical_device, &copy_info), "failed to copy memory to image on the host");
+}
+
+NODISCARD VkDeviceAddress device::get_buffer_address(VkBuffer buffer) const
+{
+    quix_assert(buffer_device_address_supported, "bufferDeviceAddress is not supported by the device");
+
+    VkBufferDeviceAddressInfo address_info {};
+    address_info.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+    address_info.buffer = buffer;
+    return vkGetBufferDeviceAddress(m_logical_device, &address_info);
+}
+
+void device::defer_destroy(std::function<void()> destroy)
+{
+    std::lock_guard<std::mutex> lock(m_garbage_mutex);
+    m_garbage.push_back({ m_gpu_frame.load(std::memory_order_relaxed), std::move(destroy) });
+}
+
+NODISCARD uint64_t device::begin_gpu_frame()
+{
+    return m_gpu_frame.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+void device::collect_garbage(uint64_t completed_frame)
+{
+    std::lock_guard<std::mutex> lock(m_garbage_mutex);
+    // retired in order, so the first entry that is still in use ends the scan
+    while (!m_garbage.empty() && m_garbage.front().frame + garbage_frame_margin <= completed_frame) {
+        m_garbage.front().destroy();
+        m_garbage.pop_front();
+    }
+}
+
+bool device::defragment_step(VkDeviceSize max_bytes_per_pass)
+{
+    // a capture only knows the objects it saw created, moved resources would not replay
+    if (m_recorder != nullptr) {
+        return m_defrag.context != VK_NULL_HANDLE;
+    }
+
+    std::unique_lock<std::mutex> lock(m_defrag_mutex);
+
+    if (m_defrag.pass_running) {
+        if (!m_defrag.pass_retired.load(std::memory_order_acquire) || vkGetFenceStatus(m_logical_device, m_defrag.fence) != VK_SUCCESS) {
+            return true;
+        }
+        if (end_defragment_pass()) {
+            end_defragmentation();
+            return false;
+        }
+    }
+
+    if (m_defrag.context == VK_NULL_HANDLE) {
+        // holes only appear when something is freed, there is nothing to gain until then
+        if (!m_defrag.resources_freed) {
+            return false;
+        }
+        begin_defragmentation(max_bytes_per_pass);
+    }
+
+    // VK_SUCCESS means there is nothing left to move and the pass does not have to be ended
+    if (vmaBeginDefragmentationPass(m_allocator, m_defrag.context, &m_defrag.pass) == VK_SUCCESS) {
+        end_defragmentation();
+        return false;
+    }
+
+    auto retire = record_defragment_pass();
+
+    // collect_garbage holds the garbage lock while destroying handles, which takes the defragmentation lock
+    lock.unlock();
+    defer_destroy(std::move(retire));
+
+    return true;
+}
+
+NODISCARD defragment_stats device::get_defragment_stats() const
+{
+    std::lock_guard<std::mutex> lock(m_defrag_mutex);
+    return m_defrag_stats;
+}
+
+NODISCARD float device::get_fragmentation() const
+{
+    // the budgets are kept up to date by vma, unlike vmaCalculateStatistics they do not walk every allocation
+    const VkPhysicalDeviceMemoryProperties* properties = nullptr;
+    vmaGetMemoryProperties(m_allocator, &properties);
+
+    std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets {};
+    vmaGetHeapBudgets(m_allocator, budgets.data());
+
+    VkDeviceSize block_bytes {};
+    VkDeviceSize allocation_bytes {};
+    for (uint32_t i = 0; i < properties->memoryHeapCount; i++) {
+        block_bytes += budgets[i].statistics.blockBytes;
+        allocation_bytes += budgets[i].statistics.allocationBytes;
+    }
+
+    if (block_bytes == 0) {
+        return 0.0f;
+    }
+    return 1.0f - static_cast<float>(allocation_bytes) / static_cast<float>(block_bytes);
+}
+
+NODISCARD bool device::get_resource_movable(const resource_slot& slot) const
+{
+    constexpr VkFlags transfer_usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    static_assert(transfer_usage == (VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT));
+
+    if (slot.alloc == VK_NULL_HANDLE || slot.alloc_info.pMappedData != nullptr) {
+        return false;
+    }
+
+    const bool is_buffer = slot.buffer != VK_NULL_HANDLE;
+    const VkFlags usage = is_buffer ? slot.buffer_info.usage : slot.image_info.usage;
+    const VkSharingMode sharing = is_buffer ? slot.buffer_info.sharingMode : slot.image_info.sharingMode;
+    if ((usage & transfer_usage) != transfer_usage || sharing != VK_SHARING_MODE_EXCLUSIVE) {
+        return false;
+    }
+
+    // host visible memory may be mapped behind the handle's back
+    VkMemoryPropertyFlags properties {};
+    vmaGetAllocationMemoryProperties(m_allocator, slot.alloc, &properties);
+    return (properties & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0 && (properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == 0;
+}
+
+void device::destroy_resource(resource_slot& slot)
+{
+    untrack_resource(slot);
+
+    std::lock_guard<std::mutex> lock(m_defrag_mutex);
+
+    if (slot.move != nullptr) {
+        // the slot holds the objects bound to the pass's destination, vma frees both allocations when the pass ends
+        slot.move->operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_DESTROY;
+        slot.move = nullptr;
+        std::erase(m_defrag.moved, &slot);
+        m_defrag.pass_garbage.emplace_back([logical_device = m_logical_device, buffer = slot.buffer, image = slot.image, view = slot.view,
+                                               subresource_views = std::move(slot.subresource_views)]() {
+            for (const auto& cached : subresource_views) {
+                vkDestroyImageView(logical_device, cached.view, nullptr);
+            }
+            vkDestroyImageView(logical_device, view, nullptr);
+            vkDestroyImage(logical_device, image, nullptr);
+            vkDestroyBuffer(logical_device, buffer, nullptr);
+        });
+    } else {
+        for (const auto& cached : slot.subresource_views) {
+            vkDestroyImageView(m_logical_device, cached.view, nullptr);
+        }
+        if (slot.view != VK_NULL_HANDLE) {
+            vkDestroyImageView(m_logical_device, slot.view, nullptr);
+        }
+        if (slot.buffer != VK_NULL_HANDLE) {
+            vmaDestroyBuffer(m_allocator, slot.buffer, slot.alloc);
+        }
+        if (slot.image != VK_NULL_HANDLE) {
+            vmaDestroyImage(m_allocator, slot.image, slot.alloc);
+        }
+    }
+
+    m_defrag.resources_freed = true;
+
+    slot.alloc = VK_NULL_HANDLE;
+    slot.alloc_info = {};
+    slot.buffer = VK_NULL_HANDLE;
+    slot.image = VK_NULL_HANDLE;
+    slot.view = VK_NULL_HANDLE;
+    slot.subresource_views.clear();
+    slot.movable = false;
+}
+
+void device::release_resource(resource_slot& slot)
+{
+    // the tag totals only count handles, the tables keep their objects out of them from creation to destruction
+    untrack_resource(slot);
+
+    std::lock_guard<std::mutex> lock(m_defrag_mutex);
+    quix_assert(slot.move == nullptr, "resource is being moved by defragmentation, release it once defragment_step returns false");
+
+    vmaSetAllocationUserData(m_allocator, slot.alloc, nullptr);
+    slot.movable = false;
+}
+
+NODISCARD VkImageView device::get_subresource_view(resource_slot& slot, const VkImageViewCreateInfo& create_info)
+{
+    std::lock_guard<std::mutex> lock(m_defrag_mutex);
+
+    // a handful of views per image at most, a scan beats hashing the range
+    for (const auto& cached : slot.subresource_views) {
+        const auto& range = cached.info.subresourceRange;
+        const auto& wanted = create_info.subresourceRange;
+        if (cached.info.viewType == create_info.viewType && cached.info.format == create_info.format
+            && range.aspectMask == wanted.aspectMask && range.baseMipLevel == wanted.baseMipLevel && range.levelCount == wanted.levelCount
+            && range.baseArrayLayer == wanted.baseArrayLayer && range.layerCount == wanted.layerCount) {
+            return cached.view;
+        }
+    }
+
+    // a pass in flight already swapped in the new image, which is the one the view has to see
+    resource_slot::subresource_view cached { create_info };
+    cached.info.image = slot.image;
+    VK_CHECK(vkCreateImageView(m_logical_device, &cached.info, nullptr, &cached.view), "failed to create image view");
+    if (!slot.tag.empty()) {
+        set_object_name(VK_OBJECT_TYPE_IMAGE_VIEW, reinterpret_cast<uint64_t>(cached.view), slot.tag.c_str());
+    }
+
+    slot.subresource_views.push_back(cached);
+    return cached.view;
+}
+
+void device::track_resource(resource_slot& slot)
+{
+    const std::string& tag = slot.tag.empty() ? untagged : slot.tag;
+    vmaSetAllocationName(m_allocator, slot.alloc, slot.tag.empty() ? nullptr : tag.c_str());
+    name_resource(slot);
+
+    std::lock_guard<std::mutex> lock(m_memory_tag_mutex);
+    auto& stats = m_memory_tags[tag];
+    stats.bytes += slot.alloc_info.size;
+    stats.count++;
+}
+
+void device::set_resource_tag(resource_slot& slot, std::string tag)
+{
+    if (slot.alloc == VK_NULL_HANDLE) {
+        slot.tag = std::move(tag);
+        return;
+    }
+
+    untrack_resource(slot);
+    slot.tag = std::move(tag);
+    track_resource(slot);
+}
+
+void device::set_object_name(VkObjectType type, uint64_t handle, const char* name) const
+{
+    if (m_set_object_name == nullptr || handle == 0) {
+        return;
+    }
+
+    VkDebugUtilsObjectNameInfoEXT name_info {};
+    name_info.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_OBJECT_NAME_INFO_EXT;
+    name_info.objectType = type;
+    name_info.objectHandle = handle;
+    name_info.pObjectName = name;
+    m_set_object_name(m_logical_device, &name_info);
+}
+
+NODISCARD std::unordered_map<std::string, memory_tag_stats> device::get_memory_tag_stats() const
+{
+    std::lock_guard<std::mutex> lock(m_memory_tag_mutex);
+    return m_memory_tags;
+}
+
+NODISCARD std::string device::dump_memory_stats(bool detailed) const
+{
+    const auto escape = [](std::string_view text) {
+        std::string escaped {};
+        for (const char c : text) {
+            if (c == '"' || c == '\\') {
+                escaped += '\\';
+            }
+            if (static_cast<unsigned char>(c) >= 0x20) {
+                escaped += c;
+            }
+        }
+        return escaped;
+    };
+
+    char* vma_stats = nullptr;
+    vmaBuildStatsString(m_allocator, &vma_stats, detailed ? VK_TRUE : VK_FALSE);
+    std::string json = fmt::format("{{\"vma\": {}, \"tags\": {{", vma_stats);
+    vmaFreeStatsString(m_allocator, vma_stats);
+
+    const auto tags = get_memory_tag_stats();
+    bool first = true;
+    for (const auto& [tag, stats] : tags) {
+        json += fmt::format("{}\"{}\": {{\"bytes\": {}, \"count\": {}}}", first ? "" : ", ", escape(tag), stats.bytes, stats.count);
+        first = false;
+    }
+    json += "}}";
+
+    return json;
+}
+
+NODISCARD memory_delta device::get_memory_delta()
+{
+    const VkPhysicalDeviceMemoryProperties* properties = nullptr;
+    vmaGetMemoryProperties(m_allocator, &properties);
+
+    std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets {};
+    vmaGetHeapBudgets(m_allocator, budgets.data());
+
+    memory_totals totals {};
+    for (uint32_t i = 0; i < properties->memoryHeapCount; i++) {
+        totals.allocation_bytes += budgets[i].statistics.allocationBytes;
+        totals.allocation_count += budgets[i].statistics.allocationCount;
+        totals.block_bytes += budgets[i].statistics.blockBytes;
+    }
+
+    memory_delta delta {};
+    delta.allocation_bytes = static_cast<int64_t>(totals.allocation_bytes) - static_cast<int64_t>(m_last_memory_totals.allocation_bytes);
+    delta.allocation_count = static_cast<int64_t>(totals.allocation_count) - static_cast<int64_t>(m_last_memory_totals.allocation_count);
+    delta.block_bytes = static_cast<int64_t>(totals.block_bytes) - static_cast<int64_t>(m_last_memory_totals.block_bytes);
+    m_last_memory_totals = totals;
+
+    return delta;
+}
+
+void device::untrack_resource(const resource_slot& slot)
+{
+    if (slot.alloc == VK_NULL_HANDLE) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_memory_tag_mutex);
+    auto stats = m_memory_tags.find(slot.tag.empty() ? untagged : slot.tag);
+    if (stats == m_memory_tags.end()) {
+        return;
+    }
+
+    stats->second.bytes -= slot.alloc_info.size;
+    if (--stats->second.count == 0) {
+        m_memory_tags.erase(stats);
+    }
+}
+
+void device::name_resource(const resource_slot& slot) const
+{
+    if (slot.tag.empty()) {
+        return;
+    }
+
+    set_object_name(VK_OBJECT_TYPE_BUFFER, reinterpret_cast<uint64_t>(slot.buffer), slot.tag.c_str());
+    set_object_name(VK_OBJECT_TYPE_IMAGE, reinterpret_cast<uint64_t>(slot.image), slot.tag.c_str());
+    set_object_name(VK_OBJECT_TYPE_IMAGE_VIEW, reinterpret_cast<uint64_t>(slot.view), slot.tag.c_str());
+    for (const auto& cached : slot.subresource_views) {
+        set_object_name(VK_OBJECT_TYPE_IMAGE_VIEW, reinterpret_cast<uint64_t>(cached.view), slot.tag.c_str());
+    }
+}
+
+NODISCARD buffer_table& device::get_buffer_table()
+{
+    std::call_once(m_buffer_table_once, [this]() { m_buffer_table = std::make_unique<buffer_table>(this, handle_table_capacity); });
+    return *m_buffer_table;
+}
+
+NODISCARD image_table& device::get_image_table()
+{
+    std::call_once(m_image_table_once, [this]() { m_image_table = std::make_unique<image_table>(this, handle_table_capacity); });
+    return *m_image_table;
+}
+
+NODISCARD readback_ring& device::get_readback_ring()
+{
+    std::call_once(m_readback_ring_once, [this]() { m_readback_ring = std::make_unique<readback_ring>(this); });
+    return *m_readback_ring;
+}
+
+NODISCARD sampler_cache& device::get_sampler_cache()
+{
+    std::call_once(m_sampler_cache_once, [this]() { m_sampler_cache = std::make_unique<sampler_cache>(m_logical_device); });
+    return *m_sampler_cache;
+}
+
+void device::begin_defragmentation(VkDeviceSize max_bytes_per_pass)
+{
+    m_defrag.resources_freed = false;
+    m_defrag.stats = {};
+    m_defrag.stats.fragmentation_before = get_fragmentation();
+
+    VmaDefragmentationInfo info {};
+    info.flags = VMA_DEFRAGMENTATION_FLAG_ALGORITHM_BALANCED_BIT;
+    info.maxBytesPerPass = max_bytes_per_pass;
+    VK_CHECK(vmaBeginDefragmentation(m_allocator, &info, &m_defrag.context), "failed to begin defragmentation");
+
+    m_defrag.command_pool = get_command_pool();
+
+    VkCommandBufferAllocateInfo alloc_info {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    alloc_info.commandPool = m_defrag.command_pool;
+    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    alloc_info.commandBufferCount = 1;
+    VK_CHECK(vkAllocateCommandBuffers(m_logical_device, &alloc_info, &m_defrag.command_buffer), "failed to allocate command buffer");
+
+    VkFenceCreateInfo fence_info {};
+    fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    VK_CHECK(vkCreateFence(m_logical_device, &fence_info, nullptr, &m_defrag.fence), "failed to create fence");
+}
+
+NODISCARD std::function<void()> device::record_defragment_pass()
+{
+    struct retired_objects {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        std::vector<VkImageView> subresource_views {};
+    };
+
+    std::vector<retired_objects> retired {};
+    std::vector<VkImageMemoryBarrier> to_transfer {};
+    std::vector<VkImageMemoryBarrier> to_resting {};
+
+    auto image_barrier = [](VkImage image, const VkImageCreateInfo& info, VkImageLayout old_layout, VkImageLayout new_layout,
+                             VkAccessFlags src_access, VkAccessFlags dst_access) {
+        VkImageMemoryBarrier barrier {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = src_access;
+        barrier.dstAccessMask = dst_access;
+        barrier.oldLayout = old_layout;
+        barrier.newLayout = new_layout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange = { get_format_aspect(info.format), 0, info.mipLevels, 0, info.arrayLayers };
+        return barrier;
+    };
+
+    // recreate every movable resource at its destination first, the copies go into one barrier batch
+    for (uint32_t i = 0; i < m_defrag.pass.moveCount; i++) {
+        auto& move = m_defrag.pass.pMoves[i];
+
+        VmaAllocationInfo info {};
+        vmaGetAllocationInfo(m_allocator, move.srcAllocation, &info);
+        auto* slot = static_cast<resource_slot*>(info.pUserData);
+        if (slot == nullptr || !slot->movable) {
+            move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+            continue;
+        }
+
+        retired_objects old { slot->buffer, slot->image, slot->view };
+        if (slot->buffer != VK_NULL_HANDLE) {
+            VK_CHECK(vkCreateBuffer(m_logical_device, &slot->buffer_info, nullptr, &slot->buffer), "failed to create buffer");
+            VK_CHECK(vmaBindBufferMemory(m_allocator, move.dstTmpAllocation, slot->buffer), "failed to bind buffer memory");
+            if (slot->address != 0) {
+                slot->address = get_buffer_address(slot->buffer);
+            }
+        } else {
+            VK_CHECK(vkCreateImage(m_logical_device, &slot->image_info, nullptr, &slot->image), "failed to create image");
+            VK_CHECK(vmaBindImageMemory(m_allocator, move.dstTmpAllocation, slot->image), "failed to bind image memory");
+
+            to_transfer.push_back(image_barrier(old.image, slot->image_info, slot->movable_layout,
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_MEMORY_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT));
+            to_transfer.push_back(image_barrier(slot->image, slot->image_info, VK_IMAGE_LAYOUT_UNDEFINED,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT));
+            // frames recorded before this pass may still be submitted after it and use the old image
+            to_resting.push_back(image_barrier(old.image, slot->image_info, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                slot->movable_layout, VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_MEMORY_READ_BIT));
+            to_resting.push_back(image_barrier(slot->image, slot->image_info, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                slot->movable_layout, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_MEMORY_READ_BIT));
+
+            if (slot->view != VK_NULL_HANDLE) {
+                slot->view_info.image = slot->image;
+                VK_CHECK(vkCreateImageView(m_logical_device, &slot->view_info, nullptr, &slot->view), "failed to create image view");
+            }
+            for (auto& cached : slot->subresource_views) {
+                old.subresource_views.push_back(cached.view);
+                cached.info.image = slot->image;
+                VK_CHECK(vkCreateImageView(m_logical_device, &cached.info, nullptr, &cached.view), "failed to create image view");
+            }
+        }
+
+        name_resource(*slot);
+        slot->generation++;
+        slot->move = &move;
+        m_defrag.moved.push_back(slot);
+        retired.push_back(std::move(old));
+    }
+
+    VkCommandBuffer cmd = m_defrag.command_buffer;
+    VK_CHECK(vkResetCommandBuffer(cmd, 0), "failed to reset command buffer");
+
+    VkCommandBufferBeginInfo begin_info {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK(vkBeginCommandBuffer(cmd, &begin_info), "failed to begin command buffer");
+
+    // anything submitted earlier, uploads included, has to land in the sources before they are copied
+    VkMemoryBarrier before {};
+    before.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    before.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+    before.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+        1, &before, 0, nullptr, static_cast<uint32_t>(to_transfer.size()), to_transfer.data());
+
+    for (std::size_t i = 0; i < retired.size(); i++) {
+        const auto* slot = m_defrag.moved[i];
+        if (slot->buffer != VK_NULL_HANDLE) {
+            VkBufferCopy region {};
+            region.size = slot->buffer_info.size;
+            vkCmdCopyBuffer(cmd, retired[i].buffer, slot->buffer, 1, &region);
+            continue;
+        }
+
+        const auto& image_info = slot->image_info;
+        std::vector<VkImageCopy> regions(image_info.mipLevels);
+        for (uint32_t level = 0; level < image_info.mipLevels; level++) {
+            auto& region = regions[level];
+            region.srcSubresource = { get_format_aspect(image_info.format), level, 0, image_info.arrayLayers };
+            region.dstSubresource = region.srcSubresource;
+            region.extent.width = std::max(image_info.extent.width >> level, 1u);
+            region.extent.height = std::max(image_info.extent.height >> level, 1u);
+            region.extent.depth = std::max(image_info.extent.depth >> level, 1u);
+        }
+        vkCmdCopyImage(cmd, retired[i].image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            static_cast<uint32_t>(regions.size()), regions.data());
+    }
+
+    VkMemoryBarrier after {};
+    after.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    after.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    after.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+        1, &after, 0, nullptr, static_cast<uint32_t>(to_resting.size()), to_resting.data());
+
+    VK_CHECK(vkEndCommandBuffer(cmd), "failed to end command buffer");
+
+    VkSubmitInfo submit_info {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &cmd;
+
+    VK_CHECK(vkResetFences(m_logical_device, 1, &m_defrag.fence), "failed to reset fence");
+    {
+        auto lock = lock_queue(m_graphics_queue);
+        VK_CHECK(vkQueueSubmit(m_graphics_queue, 1, &submit_info, m_defrag.fence), "failed to submit defragmentation copies");
+    }
+
+    m_defrag.pass_running = true;
+    m_defrag.pass_retired.store(false, std::memory_order_relaxed);
+
+    // frames recorded before the swap still use the old objects, vma only reuses their memory once they are gone
+    return [this, retired = std::move(retired)]() {
+        for (const auto& objects : retired) {
+            for (VkImageView view : objects.subresource_views) {
+                vkDestroyImageView(m_logical_device, view, nullptr);
+            }
+            vkDestroyImageView(m_logical_device, objects.view, nullptr);
+            vkDestroyImage(m_logical_device, objects.image, nullptr);
+            vkDestroyBuffer(m_logical_device, objects.buffer, nullptr);
+        }
+        m_defrag.pass_retired.store(true, std::memory_order_release);
+    };
+}
+
+bool device::end_defragment_pass()
+{
+    for (auto& destroy : m_defrag.pass_garbage) {
+        destroy();
+    }
+    m_defrag.pass_garbage.clear();
+
+    const VkResult result = vmaEndDefragmentationPass(m_allocator, m_defrag.context, &m_defrag.pass);
+
+    // the source allocations now point at the new place
+    for (auto* slot : m_defrag.moved) {
+        vmaGetAllocationInfo(m_allocator, slot->alloc, &slot->alloc_info);
+        slot->move = nullptr;
+    }
+    m_defrag.moved.clear();
+    m_defrag.pass_running = false;
+    m_defrag.stats.passes++;
+
+    return result == VK_SUCCESS;
+}
+
+void device::end_defragmentation()
+{
+    VmaDefragmentationStats vma_stats {};
+    vmaEndDefragmentation(m_allocator, m_defrag.context, &vma_stats);
+    m_defrag.context = VK_NULL_HANDLE;
+
+    vkDestroyFence(m_logical_device, m_defrag.fence, nullptr);
+    vkFreeCommandBuffers(m_logical_device, m_defrag.command_pool, 1, &m_defrag.command_buffer);
+    return_command_pool(m_defrag.command_pool);
+    m_defrag.fence = VK_NULL_HANDLE;
+    m_defrag.command_buffer = VK_NULL_HANDLE;
+    m_defrag.command_pool = VK_NULL_HANDLE;
+
+    auto& stats = m_defrag.stats;
+    stats.bytes_moved = vma_stats.bytesMoved;
+    stats.bytes_freed = vma_stats.bytesFreed;
+    stats.allocations_moved = vma_stats.allocationsMoved;
+    stats.blocks_freed = vma_stats.deviceMemoryBlocksFreed;
+    stats.fragmentation_after = get_fragmentation();
+    m_defrag_stats = stats;
+
+    if (stats.allocations_moved == 0) {
+        return;
+    }
+    spdlog::info("defragmentation moved {} allocations ({} bytes) in {} passes, freed {} blocks, fragmentation {:.1f}% -> {:.1f}%",
+        stats.allocations_moved, stats.bytes_moved, stats.passes, stats.blocks_freed,
+        stats.fragmentation_before * 100.0f, stats.fragmentation_after * 100.0f);
+}
+
 void device::create_instance(const char* app_name,
     uint32_t app_version,
     const char* engine_name,
@@ -119,6 +835,19 @@ void device::create_instance(const char* app_name,
 
     uint32_t glfwExtensionCount = 0;
     const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+
+    // object names show up in validation messages and in capture tools, enabled whenever the loader has it
+    uint32_t available_count = 0;
+    vkEnumerateInstanceExtensionProperties(nullptr, &available_count, nullptr);
+    std::vector<VkExtensionProperties> available_extensions(available_count);
+    vkEnumerateInstanceExtensionProperties(nullptr, &available_count, available_extensions.data());
+    const bool debug_utils_available = std::ranges::any_of(available_extensions, [](const VkExtensionProperties& extension) {
+        return std::string_view(extension.extensionName) == VK_EXT_DEBUG_UTILS_EXTENSION_NAME;
+    });
+    if (debug_utils_available) {
+        extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+    }
 
     VkInstanceCreateInfo create_info = {
         .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
@@ -127,11 +856,15 @@ void device::create_instance(const char* app_name,
         .pApplicationInfo = &app_info,
         .enabledLayerCount = 0,
         .ppEnabledLayerNames = nullptr,
-        .enabledExtensionCount = glfwExtensionCount,
-        .ppEnabledExtensionNames = glfwExtensions
+        .enabledExtensionCount = static_cast<uint32_t>(extensions.size()),
+        .ppEnabledExtensionNames = extensions.data()
     };
 
     VK_CHECK(vkCreateInstance(&create_info, nullptr, &m_instance), "failed to create vulkan instance");
+
+    if (debug_utils_available) {
+        m_set_object_name = reinterpret_cast<PFN_vkSetDebugUtilsObjectNameEXT>(vkGetInstanceProcAddr(m_instance, "vkSetDebugUtilsObjectNameEXT"));
+    }
 }
 
 void device::create_surface()
@@ -425,6 +1158,12 @@ void device::pick_physical_device()
             VkPhysicalDeviceProperties properties;
             vkGetPhysicalDeviceProperties(m_physical_device, &properties);
             max_sampler_anisotropy = properties.limits.maxSamplerAnisotropy;
+            timestamp_period = properties.limits.timestampPeriod;
+            timestamps_supported = properties.limits.timestampComputeAndGraphics == VK_TRUE && properties.limits.timestampPeriod > 0.0f;
+            min_uniform_buffer_offset_alignment = properties.limits.minUniformBufferOffsetAlignment;
+            max_uniform_buffer_range = properties.limits.maxUniformBufferRange;
+            max_image_dimension_2d = properties.limits.maxImageDimension2D;
+            max_image_array_layers = properties.limits.maxImageArrayLayers;
             spdlog::info("Using device: {} with a score of {}", properties.deviceName, deviceRating.first);
 
             // maxMsaa = getMaxUsableSampleCount(); // TODO
@@ -435,6 +1174,65 @@ void device::pick_physical_device()
     quix_assert(m_physical_device != VK_NULL_HANDLE, "failed to find a suitable GPU");
 }
 
+void device::query_host_image_copy_support()
+{
+    uint32_t extension_count {};
+    vkEnumerateDeviceExtensionProperties(m_physical_device, nullptr, &extension_count, nullptr);
+    std::vector<VkExtensionProperties> extensions(extension_count);
+    vkEnumerateDeviceExtensionProperties(m_physical_device, nullptr, &extension_count, extensions.data());
+
+    const bool extension_available = std::ranges::any_of(extensions, [](const VkExtensionProperties& extension) {
+        return std::string_view(extension.extensionName) == VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME;
+    });
+    if (!extension_available) {
+        return;
+    }
+
+    VkPhysicalDeviceHostImageCopyFeaturesEXT host_image_copy_features {};
+    host_image_copy_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_FEATURES_EXT;
+    VkPhysicalDeviceFeatures2 features {};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &host_image_copy_features;
+    vkGetPhysicalDeviceFeatures2(m_physical_device, &features);
+    if (host_image_copy_features.hostImageCopy != VK_TRUE) {
+        return;
+    }
+
+    // the first call only fills in the layout counts
+    VkPhysicalDeviceHostImageCopyPropertiesEXT host_image_copy_properties {};
+    host_image_copy_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_PROPERTIES_EXT;
+    VkPhysicalDeviceProperties2 properties {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &host_image_copy_properties;
+    vkGetPhysicalDeviceProperties2(m_physical_device, &properties);
+
+    std::vector<VkImageLayout> dst_layouts(host_image_copy_properties.copyDstLayoutCount);
+    host_image_copy_properties.pCopyDstLayouts = dst_layouts.data();
+    host_image_copy_properties.copySrcLayoutCount = 0;
+    vkGetPhysicalDeviceProperties2(m_physical_device, &properties);
+
+    // textures are copied into the layout they are sampled in, and the usage must not move them to other memory types
+    host_image_copy_supported = host_image_copy_properties.identicalMemoryTypeRequirements == VK_TRUE
+        && std::ranges::find(dst_layouts, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) != dst_layouts.end();
+
+    if (host_image_copy_supported) {
+        spdlog::info("VK_EXT_host_image_copy available, textures are uploaded without staging");
+    }
+}
+
+void device::query_buffer_device_address_support()
+{
+    // core since vulkan 1.2, only the feature has to be there
+    VkPhysicalDeviceBufferDeviceAddressFeatures buffer_device_address_features {};
+    buffer_device_address_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
+    VkPhysicalDeviceFeatures2 features {};
+    features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features.pNext = &buffer_device_address_features;
+    vkGetPhysicalDeviceFeatures2(m_physical_device, &features);
+
+    buffer_device_address_supported = buffer_device_address_features.bufferDeviceAddress == VK_TRUE;
+}
+
 void device::create_logical_device()
 {
     queue_family_indices indices = find_queue_families(m_physical_device);
@@ -462,6 +1260,25 @@ void device::create_logical_device()
 
     createInfo.pEnabledFeatures = &requested_features;
 
+    VkPhysicalDeviceHostImageCopyFeaturesEXT host_image_copy_features {};
+    host_image_copy_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_FEATURES_EXT;
+    host_image_copy_features.hostImageCopy = VK_TRUE;
+    if (host_image_copy_supported) {
+        if (std::ranges::none_of(requested_extensions, [](const char* name) { return std::string_view(name) == VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME; })) {
+            requested_extensions.push_back(VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME);
+        }
+        host_image_copy_features.pNext = const_cast<void*>(createInfo.pNext);
+        createInfo.pNext = &host_image_copy_features;
+    }
+
+    VkPhysicalDeviceBufferDeviceAddressFeatures buffer_device_address_features {};
+    buffer_device_address_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
+    buffer_device_address_features.bufferDeviceAddress = VK_TRUE;
+    if (buffer_device_address_supported) {
+        buffer_device_address_features.pNext = const_cast<void*>(createInfo.pNext);
+        createInfo.pNext = &buffer_device_address_features;
+    }
+
     createInfo.enabledExtensionCount = static_cast<uint32_t>(requested_extensions.size());
     createInfo.ppEnabledExtensionNames = requested_extensions.data();
 
@@ -469,6 +1286,12 @@ void device::create_logical_device()
 
     vkGetDeviceQueue(m_logical_device, indices.graphics_family.value(), 0, &m_graphics_queue);
     vkGetDeviceQueue(m_logical_device, indices.present_family.value(), 0, &m_present_queue);
+
+    if (host_image_copy_supported) {
+        m_transition_image_layout = reinterpret_cast<PFN_vkTransitionImageLayoutEXT>(vkGetDeviceProcAddr(m_logical_device, "vkTransitionImageLayoutEXT"));
+        m_copy_memory_to_image = reinterpret_cast<PFN_vkCopyMemoryToImageEXT>(vkGetDeviceProcAddr(m_logical_device, "vkCopyMemoryToImageEXT"));
+        host_image_copy_supported = m_transition_image_layout != nullptr && m_copy_memory_to_image != nullptr;
+    }
 }
 
 void device::create_allocator()
@@ -478,8 +1301,17 @@ void device::create_allocator()
     allocatorInfo.device = m_logical_device,
     allocatorInfo.physicalDevice = m_physical_device,
     allocatorInfo.vulkanApiVersion = VK_API_VERSION_1_3,
+    allocatorInfo.flags = buffer_device_address_supported ? VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT : 0,
 
     VK_CHECK(vmaCreateAllocator(&allocatorInfo, &m_allocator), "failed to create VMA allocator");
+
+    const VkPhysicalDeviceMemoryProperties* memory_properties = nullptr;
+    vmaGetMemoryProperties(m_allocator, &memory_properties);
+    for (uint32_t i = 0; i < memory_properties->memoryTypeCount; i++) {
+        if (memory_properties->memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) {
+            lazily_allocated_supported = true;
+        }
+    }
 }
 
 } // namespace quix
@@ -5,6 +5,16 @@ namespace quix {
 
 class window;
 class swapchain;
+class frame_stats;
+class buffer_table;
+class image_table;
+class readback_ring;
+class sampler_cache;
+struct resource_slot;
+
+namespace capture {
+    class recorder;
+}
 
 struct queue_family_indices {
     std::optional<uint32_t> graphics_family;
@@ -22,6 +32,31 @@ struct swapchain_support_details {
     std::vector<VkPresentModeKHR> present_modes;
 };
 
+// one defragmentation, from the first defragment_step to the one that found nothing left to move.
+// fragmentation is the share of the allocated device memory blocks that no allocation uses
+struct defragment_stats {
+    VkDeviceSize bytes_moved {};
+    VkDeviceSize bytes_freed {};
+    uint32_t allocations_moved {};
+    uint32_t blocks_freed {};
+    uint32_t passes {};
+    float fragmentation_before {};
+    float fragmentation_after {};
+};
+
+// live buffer_handle/image_handle allocations carrying one tag
+struct memory_tag_stats {
+    VkDeviceSize bytes {};
+    uint32_t count {};
+};
+
+// what every allocation of the device, not only the tagged ones, gained between two get_memory_delta calls
+struct memory_delta {
+    int64_t allocation_bytes {};
+    int64_t allocation_count {};
+    int64_t block_bytes {};
+};
+
 class device {
     friend class swapchain;
 
@@ -49,12 +84,99 @@ public:
     NODISCARD VkQueue get_graphics_queue() const noexcept { return m_graphics_queue; }
     NODISCARD VkQueue get_present_queue() const noexcept { return m_present_queue; }
     NODISCARD float get_max_sampler_anisotropy() const noexcept { return max_sampler_anisotropy; }
+    NODISCARD float get_timestamp_period() const noexcept { return timestamp_period; }
+    NODISCARD bool get_timestamps_supported() const noexcept { return timestamps_supported; }
+    NODISCARD VkDeviceSize get_min_uniform_buffer_offset_alignment() const noexcept { return min_uniform_buffer_offset_alignment; }
+    NODISCARD uint32_t get_max_uniform_buffer_range() const noexcept { return max_uniform_buffer_range; }
+    NODISCARD uint32_t get_max_image_dimension_2d() const noexcept { return max_image_dimension_2d; }
+    NODISCARD uint32_t get_max_image_array_layers() const noexcept { return max_image_array_layers; }
+    // a memory type with VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT exists, mostly on tile based gpus
+    NODISCARD bool get_lazily_allocated_supported() const noexcept { return lazily_allocated_supported; }
+    // VK_EXT_host_image_copy is enabled and can copy straight into VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+    NODISCARD bool get_host_image_copy_supported() const noexcept { return host_image_copy_supported; }
+    // the image can be created with VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT without losing memory types or gpu access speed,
+    // false while a capture is running, the recorder only sees uploads that go through the queue
+    NODISCARD bool get_host_image_copy_supported(const VkImageCreateInfo& image_info) const;
+    // the bufferDeviceAddress feature is enabled and every allocation can back VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT buffers
+    NODISCARD bool get_buffer_device_address_supported() const noexcept { return buffer_device_address_supported; }
+    // the buffer needs VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
+    NODISCARD VkDeviceAddress get_buffer_address(VkBuffer buffer) const;
+    NODISCARD const VkPhysicalDeviceFeatures& get_enabled_features() const noexcept { return requested_features; }
+    // optimal tiling support, block compressed formats also need their compression feature enabled at init
+    NODISCARD bool get_format_supported(VkFormat format, VkFormatFeatureFlags features) const;
+
+    // non-owning, the instance owns the recorder while a capture is running
+    NODISCARD capture::recorder* get_recorder() const noexcept { return m_recorder; }
+    void set_recorder(capture::recorder* recorder) noexcept { m_recorder = recorder; }
+
+    // frame timings recorded by frame_manager and sync, shared so both paths land in the same rings
+    NODISCARD frame_stats& get_frame_stats() const noexcept { return *m_frame_stats; }
+
+    // vkQueueSubmit/vkQueuePresentKHR need the queue externally synchronized once
+    // more than one thread submits, graphics and present share a lock when they are the same queue
+    NODISCARD std::unique_lock<std::mutex> lock_queue(VkQueue queue)
+    {
+        if (queue == m_present_queue && queue != m_graphics_queue) {
+            return std::unique_lock<std::mutex>(m_present_queue_mutex);
+        }
+        return std::unique_lock<std::mutex>(m_graphics_queue_mutex);
+    }
 
     NODISCARD VkCommandPool get_command_pool();
     void return_command_pool(VkCommandPool command_pool);
 
     inline void wait_idle() { vkDeviceWaitIdle(m_logical_device); }
 
+    // runs destroy once every frame that could still reference the object has finished,
+    // used to retire swapchain resources without a wait_idle. frame_manager and sync drive it through
+    // begin_gpu_frame/collect_garbage, anything left over runs when the device is destroyed
+    void defer_destroy(std::function<void()> destroy);
+    NODISCARD uint64_t begin_gpu_frame();
+    void collect_garbage(uint64_t completed_frame);
+
+    // moves movable buffer_handle/image_handle memory to compact the allocator, at most one vma pass per call.
+    // a pass copies up to max_bytes_per_pass on the graphics queue and swaps the objects in the handles right away,
+    // the old objects and memory are released once the frames that could use them are done, which takes a few calls.
+    // a defragmentation only starts after a handle was destroyed, max_bytes_per_pass is read by the call that starts it.
+    // main thread only, does nothing while a capture is running. returns true while a defragmentation is in progress
+    bool defragment_step(VkDeviceSize max_bytes_per_pass = 8ull * 1024 * 1024);
+    // the last finished defragmentation
+    NODISCARD defragment_stats get_defragment_stats() const;
+    NODISCARD float get_fragmentation() const;
+
+    // writes the regions from host memory without a queue submission, the buffer offsets of the regions are
+    // offsets into data. the image needs VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT, range is taken out of
+    // VK_IMAGE_LAYOUT_UNDEFINED and ends up in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+    void host_copy_to_image(VkImage image, const uint8_t* data, std::span<const VkBufferImageCopy> regions, const VkImageSubresourceRange& range);
+
+    // vmaBuildStatsString json under "vma" and the tagged totals under "tags", detailed lists every allocation by tag
+    NODISCARD std::string dump_memory_stats(bool detailed = false) const;
+    NODISCARD std::unordered_map<std::string, memory_tag_stats> get_memory_tag_stats() const;
+    // change since the previous call, call once per frame from one thread to catch memory that keeps growing in soak tests
+    NODISCARD memory_delta get_memory_delta();
+    // shows up in validation messages and capture tools, does nothing without VK_EXT_debug_utils
+    void set_object_name(VkObjectType type, uint64_t handle, const char* name) const;
+
+    // used by buffer_handle and image_handle
+    NODISCARD bool get_resource_movable(const resource_slot& slot) const;
+    void destroy_resource(resource_slot& slot);
+    // detaches the objects from defragmentation and the tag totals, the caller owns them afterwards
+    void release_resource(resource_slot& slot);
+    // names the allocation and objects after the slot's tag and counts it in the tag totals, right after creation
+    void track_resource(resource_slot& slot);
+    void set_resource_tag(resource_slot& slot, std::string tag);
+    // finds or creates the view in the slot's subresource views, under the defragmentation lock so a pass can not
+    // miss a view made while it recreates the image
+    NODISCARD VkImageView get_subresource_view(resource_slot& slot, const VkImageViewCreateInfo& create_info);
+
+    // buffers and images addressed by 32 bit generational ids, created on first use
+    NODISCARD buffer_table& get_buffer_table();
+    NODISCARD image_table& get_image_table();
+    // gpu to cpu copies that resolve when their frame is retired, created on first use
+    NODISCARD readback_ring& get_readback_ring();
+    // shared samplers that live as long as the device, created on first use
+    NODISCARD sampler_cache& get_sampler_cache();
+
 private:
     void create_instance(const char* app_name,
         uint32_t app_version,
@@ -72,9 +194,20 @@ private:
     int get_supported_feature_score(VkPhysicalDevice physical_device);
     int rate_physical_device(VkPhysicalDevice physical_device);
     void pick_physical_device();
+    void query_host_image_copy_support();
+    void query_buffer_device_address_support();
     void create_logical_device();
     void create_allocator();
 
+    void untrack_resource(const resource_slot& slot);
+    void name_resource(const resource_slot& slot) const;
+
+    void begin_defragmentation(VkDeviceSize max_bytes_per_pass);
+    NODISCARD std::function<void()> record_defragment_pass();
+    // true when vma has nothing left to move
+    bool end_defragment_pass();
+    void end_defragmentation();
+
     // instance variables
 
     weakref<window> m_window;
@@ -100,9 +233,88 @@ private:
 
     std::optional<queue_family_indices> m_queue_family_indices {};
     float max_sampler_anisotropy{};
+    float timestamp_period{};
+    bool timestamps_supported = false;
+    VkDeviceSize min_uniform_buffer_offset_alignment{};
+    uint32_t max_uniform_buffer_range{};
+    uint32_t max_image_dimension_2d{};
+    uint32_t max_image_array_layers{};
+    bool lazily_allocated_supported = false;
+    bool host_image_copy_supported = false;
+    bool buffer_device_address_supported = false;
+
+    PFN_vkSetDebugUtilsObjectNameEXT m_set_object_name = nullptr;
+    PFN_vkTransitionImageLayoutEXT m_transition_image_layout = nullptr;
+    PFN_vkCopyMemoryToImageEXT m_copy_memory_to_image = nullptr;
+
+    capture::recorder* m_recorder = nullptr;
+    std::unique_ptr<frame_stats> m_frame_stats;
 
     std::deque<VkCommandPool> m_command_pools {};
     std::mutex m_command_pool_mutex {};
+
+    struct deferred_destroy {
+        uint64_t frame;
+        std::function<void()> destroy;
+    };
+
+    // presentation is not covered by the frame fences, give the presentation engine some slack
+    static constexpr uint64_t garbage_frame_margin = 2;
+
+    std::deque<deferred_destroy> m_garbage {};
+    std::mutex m_garbage_mutex {};
+    std::atomic<uint64_t> m_gpu_frame = 0;
+
+    std::mutex m_graphics_queue_mutex {};
+    std::mutex m_present_queue_mutex {};
+
+    struct defragment_state {
+        VmaDefragmentationContext context = VK_NULL_HANDLE;
+        VmaDefragmentationPassMoveInfo pass {};
+        bool pass_running = false;
+        // a buffer_handle/image_handle was destroyed since the last defragmentation started
+        bool resources_freed = false;
+        // set by the deferred destroy of the pass's old objects
+        std::atomic<bool> pass_retired = false;
+        VkCommandPool command_pool = VK_NULL_HANDLE;
+        VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        // slots the running pass moved, their alloc_info is refreshed when it ends
+        std::vector<resource_slot*> moved {};
+        // new objects of resources destroyed while the pass was copying them
+        std::vector<std::function<void()>> pass_garbage {};
+        defragment_stats stats {};
+    };
+
+    static constexpr uint32_t handle_table_capacity = 64 * 1024;
+
+    std::unique_ptr<buffer_table> m_buffer_table {};
+    std::unique_ptr<image_table> m_image_table {};
+    std::once_flag m_buffer_table_once {};
+    std::once_flag m_image_table_once {};
+
+    struct memory_totals {
+        VkDeviceSize allocation_bytes {};
+        uint64_t allocation_count {};
+        VkDeviceSize block_bytes {};
+    };
+
+    inline static const std::string untagged = "untagged";
+
+    std::unordered_map<std::string, memory_tag_stats> m_memory_tags {};
+    mutable std::mutex m_memory_tag_mutex {};
+    memory_totals m_last_memory_totals {};
+
+    std::unique_ptr<readback_ring> m_readback_ring {};
+    std::once_flag m_readback_ring_once {};
+
+    std::unique_ptr<sampler_cache> m_sampler_cache {};
+    std::once_flag m_sampler_cache_once {};
+
+    // guards the defragmentation state and the move of every resource_slot
+    mutable std::mutex m_defrag_mutex {};
+    defragment_state m_defrag {};
+    defragment_stats m_defrag_stats {};
 };
 
 } // namespace quix
@@ -0,0 +1,412 @@
+#ifndef _QUIX_FRAME_CPP
+#define _QUIX_FRAME_CPP
+
+#include "quix_frame.hpp"
+
+#include "quix_capture.hpp"
+#include "quix_device.hpp"
+#include "quix_render_target.hpp"
+#include "quix_stats.hpp"
+#include "quix_swapchain.hpp"
+#include "quix_window.hpp"
+
+namespace quix {
+
+// frame_context class start
+
+frame_context::frame_context(weakref<device> p_device, descriptor::allocator* p_descriptor_allocator, buffer_handle* p_upload_buffer, VkDeviceSize upload_begin, VkDeviceSize upload_size, uint32_t frame_index)
+    : m_device(std::move(p_device))
+    , m_command_pool(m_device, m_device->get_command_pool())
+    , m_command_list(m_command_pool.create_command_list())
+    , m_descriptor_pool(p_descriptor_allocator->getPool())
+    , m_upload_buffer(p_upload_buffer->get_buffer())
+    , m_upload_data(static_cast<char*>(p_upload_buffer->get_mapped_data()))
+    , m_upload_begin(upload_begin)
+    , m_upload_end(upload_begin + upload_size)
+    , m_upload_offset(upload_begin)
+    , m_min_alignment(m_device->get_min_uniform_buffer_offset_alignment())
+    , m_frame_index(frame_index)
+{
+    VkSemaphoreCreateInfo semaphore_info {};
+    semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    VkFenceCreateInfo fence_info {};
+    fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+    VK_CHECK(vkCreateSemaphore(m_device->get_logical_device(), &semaphore_info, nullptr, &m_image_available), "failed to create semaphore");
+    VK_CHECK(vkCreateSemaphore(m_device->get_logical_device(), &semaphore_info, nullptr, &m_render_finished), "failed to create semaphore");
+    VK_CHECK(vkCreateFence(m_device->get_logical_device(), &fence_info, nullptr, &m_fence), "failed to create fence");
+
+    if (m_device->get_timestamps_supported()) {
+        VkQueryPoolCreateInfo query_info {};
+        query_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        query_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        query_info.queryCount = 2;
+        VK_CHECK(vkCreateQueryPool(m_device->get_logical_device(), &query_info, nullptr, &m_timestamp_pool), "failed to create timestamp query pool");
+    }
+}
+
+frame_context::~frame_context()
+{
+    if (m_timestamp_pool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(m_device->get_logical_device(), m_timestamp_pool, nullptr);
+    }
+    vkDestroySemaphore(m_device->get_logical_device(), m_image_available, nullptr);
+    vkDestroySemaphore(m_device->get_logical_device(), m_render_finished, nullptr);
+    vkDestroyFence(m_device->get_logical_device(), m_fence, nullptr);
+}
+
+NODISCARD upload_allocation frame_context::allocate_upload(VkDeviceSize size, VkDeviceSize alignment)
+{
+    alignment = std::max(alignment, m_min_alignment);
+    VkDeviceSize offset = (m_upload_offset + alignment - 1) & ~(alignment - 1);
+
+    quix_assert(offset + size <= m_upload_end, "frame upload memory exhausted, increase the upload size");
+
+    m_upload_offset = offset + size;
+
+    return upload_allocation {
+        m_upload_buffer,
+        offset,
+        m_upload_data + offset
+    };
+}
+
+void frame_context::reset()
+{
+    m_command_pool.reset();
+    m_descriptor_pool.reset();
+    m_upload_offset = m_upload_begin;
+}
+
+// frame_context class end
+
+// frame_manager class start
+
+frame_manager::frame_manager(weakref<window> p_window, weakref<device> p_device, weakref<swapchain> p_swapchain, descriptor::allocator* p_descriptor_allocator, VkDeviceSize upload_size)
+    : m_window(std::move(p_window))
+    , m_device(std::move(p_device))
+    , m_swapchain(std::move(p_swapchain))
+    , m_upload_buffer(m_device)
+{
+    const auto frames_in_flight = static_cast<uint32_t>(m_swapchain->get_frames_in_flight());
+
+    // parts start aligned so allocations inside them only have to align relative to the part
+    const VkDeviceSize alignment = m_device->get_min_uniform_buffer_offset_alignment();
+    upload_size = (upload_size + alignment - 1) & ~(alignment - 1);
+    quix_assert(upload_size * frames_in_flight <= std::numeric_limits<uint32_t>::max(), "upload buffer does not fit 32 bit dynamic offsets");
+
+    m_upload_buffer.create_cpu_buffer(upload_size * frames_in_flight,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+        VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+
+    m_frames.reserve(frames_in_flight);
+    for (uint32_t i = 0; i < frames_in_flight; i++) {
+        m_frames.push_back(std::make_unique<frame_context>(m_device, p_descriptor_allocator, &m_upload_buffer, upload_size * i, upload_size, i));
+    }
+    m_active_frames.store(frames_in_flight, std::memory_order_relaxed);
+}
+
+frame_manager::~frame_manager()
+{
+    m_device->wait_idle();
+}
+
+NODISCARD frame_context* frame_manager::begin_frame(render_target& target)
+{
+    quix_assert(m_active == nullptr, "begin_frame called twice without end_frame");
+
+    m_limiter.wait();
+
+    auto* frame = acquire_frame();
+    if (frame == nullptr) {
+        target.recreate_swapchain();
+        return nullptr;
+    }
+
+    begin_recording(*frame, target);
+
+    m_active = frame;
+    return m_active;
+}
+
+void frame_manager::end_frame()
+{
+    quix_assert(m_active != nullptr, "end_frame called without begin_frame");
+
+    auto& frame = *m_active;
+    m_active = nullptr;
+
+    submit_frame(frame);
+
+    VkResult result = present_frame(frame);
+
+    if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR && result != VK_ERROR_OUT_OF_DATE_KHR) {
+        quix_error("failed to present swapchain image");
+    }
+
+    auto& target = *frame.m_target;
+    if (m_window->get_framebuffer_resized()) {
+        target.notify_resized();
+    }
+    if (result == VK_SUBOPTIMAL_KHR) {
+        // a suboptimal swapchain can still be presented to, wait for a running resize to settle
+        target.notify_suboptimal();
+    }
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || m_swapchain->get_settings_changed() || target.get_resize_settled()) {
+        target.recreate_swapchain();
+    }
+}
+
+NODISCARD frame_context* frame_manager::acquire_frame(uint64_t timeout, bool* timed_out)
+{
+    using clock = std::chrono::steady_clock;
+
+    auto& frame = *m_frames[m_current_frame];
+
+    auto& stats = m_device->get_frame_stats();
+
+    if (!frame.m_fence_waited) {
+        // only blocks on the work submitted frames_in_flight frames ago
+        const bool gpu_idle = vkGetFenceStatus(m_device->get_logical_device(), frame.m_fence) == VK_SUCCESS;
+        const auto wait_start = clock::now();
+        vkWaitForFences(m_device->get_logical_device(), 1, &frame.m_fence, VK_TRUE, UINT64_MAX);
+        const auto wait_end = clock::now();
+        stats.record(frame_metric::fence_wait, std::chrono::duration<double, std::milli>(wait_end - wait_start).count());
+
+        if (frame.m_timestamps_pending) {
+            std::array<uint64_t, 2> timestamps {};
+            if (vkGetQueryPoolResults(m_device->get_logical_device(), frame.m_timestamp_pool, 0, 2, sizeof(timestamps), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+                stats.record(frame_metric::gpu, static_cast<double>(timestamps[1] - timestamps[0]) * m_device->get_timestamp_period() / 1000000.0);
+            }
+            frame.m_timestamps_pending = false;
+        }
+
+        if (frame.m_gpu_frame != 0) {
+            m_device->collect_garbage(frame.m_gpu_frame);
+        }
+
+        if (frame.m_begin_time != clock::time_point {}) {
+            m_latency_ms.store(std::chrono::duration<double, std::milli>(wait_end - frame.m_begin_time).count(), std::memory_order_relaxed);
+            frame.m_begin_time = {};
+        }
+        if (m_adaptive.load(std::memory_order_relaxed)) {
+            adapt_frames_in_flight(gpu_idle, std::chrono::duration<double, std::milli>(wait_end - wait_start).count());
+        }
+        frame.m_fence_waited = true;
+    }
+
+    VkResult result;
+    {
+        scoped_frame_timer timer(stats, frame_metric::acquire);
+        result = vkAcquireNextImageKHR(m_device->get_logical_device(), m_swapchain->get_swapchain(), timeout, frame.m_image_available, VK_NULL_HANDLE, &frame.m_image_index);
+    }
+    const bool not_ready = result == VK_TIMEOUT || result == VK_NOT_READY;
+    if (timed_out != nullptr) {
+        *timed_out = not_ready;
+    }
+    if (not_ready) {
+        return nullptr;
+    }
+
+    frame.m_fence_waited = false;
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+        return nullptr;
+    }
+    quix_assert(result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR, "failed to acquire swapchain image");
+
+    frame.m_state = frame_context::frame_state::acquired;
+    m_current_frame = (m_current_frame + 1) % m_active_frames.load(std::memory_order_relaxed);
+
+    return &frame;
+}
+
+void frame_manager::begin_recording(frame_context& frame, render_target& target)
+{
+    quix_assert(frame.m_state == frame_context::frame_state::acquired, "begin_recording called on a frame that was not acquired");
+
+    // the fence is only reset once we know this frame will be submitted
+    vkResetFences(m_device->get_logical_device(), 1, &frame.m_fence);
+
+    frame.reset();
+    frame.m_begin_time = std::chrono::steady_clock::now();
+    frame.m_gpu_frame = m_device->begin_gpu_frame();
+    frame.m_target = &target;
+    frame.m_command_list->begin_record(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    if (frame.m_timestamp_pool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(frame.m_command_list->get_cmd_buffer(), frame.m_timestamp_pool, 0, 2);
+        vkCmdWriteTimestamp(frame.m_command_list->get_cmd_buffer(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.m_timestamp_pool, 0);
+    }
+    frame.m_state = frame_context::frame_state::recording;
+}
+
+void frame_manager::submit_frame(frame_context& frame)
+{
+    quix_assert(frame.m_state == frame_context::frame_state::recording, "submit_frame called on a frame that is not recording");
+
+    auto& stats = m_device->get_frame_stats();
+    const auto now = std::chrono::steady_clock::now();
+    if (m_last_submit != std::chrono::steady_clock::time_point {}) {
+        stats.record(frame_metric::cpu_frame, std::chrono::duration<double, std::milli>(now - m_last_submit).count());
+    }
+    m_last_submit = now;
+    stats.tick();
+
+    if (frame.m_timestamp_pool != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(frame.m_command_list->get_cmd_buffer(), VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.m_timestamp_pool, 1);
+        frame.m_timestamps_pending = true;
+    }
+
+    frame.m_command_list->end_record();
+
+    if (auto* recorder = m_device->get_recorder()) {
+        recorder->record_submit(frame.m_command_list->get_cmd_buffer());
+    }
+
+    VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+
+    VkSubmitInfo submit_info {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.waitSemaphoreCount = 1;
+    submit_info.pWaitSemaphores = &frame.m_image_available;
+    submit_info.pWaitDstStageMask = &wait_stage;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = frame.m_command_list->get_cmd_buffer_ref();
+    submit_info.signalSemaphoreCount = 1;
+    submit_info.pSignalSemaphores = &frame.m_render_finished;
+
+    auto lock = m_device->lock_queue(m_device->get_graphics_queue());
+    VK_CHECK(vkQueueSubmit(m_device->get_graphics_queue(), 1, &submit_info, frame.m_fence), "failed to submit frame");
+
+    frame.m_state = frame_context::frame_state::submitted;
+}
+
+NODISCARD VkResult frame_manager::present_frame(frame_context& frame)
+{
+    quix_assert(frame.m_state == frame_context::frame_state::submitted, "present_frame called on a frame that was not submitted");
+
+    VkSwapchainKHR swapchain_handle = m_swapchain->get_swapchain();
+
+    VkPresentInfoKHR present_info {};
+    present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+    present_info.waitSemaphoreCount = 1;
+    present_info.pWaitSemaphores = &frame.m_render_finished;
+    present_info.swapchainCount = 1;
+    present_info.pSwapchains = &swapchain_handle;
+    present_info.pImageIndices = &frame.m_image_index;
+
+    if (auto* recorder = m_device->get_recorder()) {
+        recorder->record_frame_end();
+    }
+
+    // an out of date present still waits on the semaphore, so the frame is done either way
+    frame.m_state = frame_context::frame_state::idle;
+
+    scoped_frame_timer timer(m_device->get_frame_stats(), frame_metric::present);
+    auto lock = m_device->lock_queue(m_device->get_present_queue());
+    return vkQueuePresentKHR(m_device->get_present_queue(), &present_info);
+}
+
+void frame_manager::cancel_frame(frame_context& frame)
+{
+    VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+    VkSubmitInfo submit_info {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.waitSemaphoreCount = 1;
+    submit_info.pWaitDstStageMask = &wait_stage;
+
+    VkFence fence = VK_NULL_HANDLE;
+
+    switch (frame.m_state) {
+    case frame_context::frame_state::idle:
+        return;
+    case frame_context::frame_state::acquired:
+        submit_info.pWaitSemaphores = &frame.m_image_available;
+        break;
+    case frame_context::frame_state::recording:
+        // the fence was already reset, signal it so the next acquire of this frame does not hang
+        frame.m_command_list->end_record();
+        submit_info.pWaitSemaphores = &frame.m_image_available;
+        fence = frame.m_fence;
+        break;
+    case frame_context::frame_state::submitted:
+        submit_info.pWaitSemaphores = &frame.m_render_finished;
+        break;
+    }
+
+    auto lock = m_device->lock_queue(m_device->get_graphics_queue());
+    VK_CHECK(vkQueueSubmit(m_device->get_graphics_queue(), 1, &submit_info, fence), "failed to cancel frame");
+
+    frame.m_state = frame_context::frame_state::idle;
+}
+
+void frame_manager::set_adaptive_frames_in_flight(bool enabled) noexcept
+{
+    m_adaptive.store(enabled, std::memory_order_relaxed);
+    if (!enabled) {
+        m_active_frames.store(get_frames_in_flight(), std::memory_order_relaxed);
+    }
+}
+
+void frame_manager::set_min_frames_in_flight(uint32_t min_frames) noexcept
+{
+    min_frames = std::clamp(min_frames, 1u, get_frames_in_flight());
+    m_min_frames.store(min_frames, std::memory_order_relaxed);
+    if (m_active_frames.load(std::memory_order_relaxed) < min_frames) {
+        m_active_frames.store(min_frames, std::memory_order_relaxed);
+    }
+}
+
+NODISCARD bool frame_manager::get_swapchain_settings_changed() const noexcept
+{
+    return m_swapchain->get_settings_changed();
+}
+
+NODISCARD VkDescriptorBufferInfo frame_manager::get_upload_descriptor_info(VkDeviceSize range) const noexcept
+{
+    quix_assert(range <= m_device->get_max_uniform_buffer_range(), "dynamic uniform range is larger than maxUniformBufferRange");
+
+    VkDescriptorBufferInfo info {};
+    info.buffer = m_upload_buffer.get_buffer();
+    info.offset = 0;
+    info.range = range;
+    return info;
+}
+
+void frame_manager::adapt_frames_in_flight(bool gpu_idle, double fence_wait_ms)
+{
+    const auto now = std::chrono::steady_clock::now();
+    const double frame_ms = m_last_acquire == std::chrono::steady_clock::time_point {} ? 0.0 : std::chrono::duration<double, std::milli>(now - m_last_acquire).count();
+    m_last_acquire = now;
+
+    uint32_t active = m_active_frames.load(std::memory_order_relaxed);
+
+    if (gpu_idle) {
+        // the gpu finished before the cpu needed the frame back, the extra frame of queueing only adds latency
+        m_busy_streak = 0;
+        if (++m_idle_streak >= adapt_window && active > m_min_frames.load(std::memory_order_relaxed)) {
+            active--;
+            m_idle_streak = 0;
+        }
+    } else if (fence_wait_ms > frame_ms * 0.25) {
+        // the cpu spends a good part of the frame blocked on the gpu, buy the parallelism back
+        m_idle_streak = 0;
+        if (++m_busy_streak >= adapt_window / 4 && active < get_frames_in_flight()) {
+            active++;
+            m_busy_streak = 0;
+        }
+    } else {
+        m_idle_streak = 0;
+        m_busy_streak = 0;
+    }
+
+    m_active_frames.store(active, std::memory_order_relaxed);
+}
+
+// frame_manager class end
+
+} // namespace quix
+
+#endif // _QUIX_FRAME_CPP
@@ -0,0 +1,182 @@
+#ifndef _QUIX_FRAME_HPP
+#define _QUIX_FRAME_HPP
+
+#include "quix_commands.hpp"
+#include "quix_descriptor.hpp"
+#include "quix_pacing.hpp"
+#include "quix_resource.hpp"
+
+namespace quix {
+
+class window;
+class device;
+class swapchain;
+class render_target;
+
+struct upload_allocation {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceSize offset {};
+    void* data = nullptr;
+
+    // every frame allocates out of the same buffer, so this is all a UNIFORM_BUFFER_DYNAMIC
+    // descriptor written with frame_manager::get_upload_descriptor_info needs to find the data
+    NODISCARD inline uint32_t get_dynamic_offset() const noexcept { return static_cast<uint32_t>(offset); }
+};
+
+// everything a single frame in flight owns, it is only reused once the gpu
+// has signalled its fence so nothing in here needs extra synchronization
+class frame_context {
+    friend class frame_manager;
+
+    // where the frame is between acquire and present, used to undo a frame that never makes it to present
+    enum class frame_state {
+        idle,
+        acquired,
+        recording,
+        submitted
+    };
+
+public:
+    // the frame allocates from [upload_begin, upload_begin + upload_size) of the manager's upload buffer
+    frame_context(weakref<device> p_device, descriptor::allocator* p_descriptor_allocator, buffer_handle* p_upload_buffer, VkDeviceSize upload_begin, VkDeviceSize upload_size, uint32_t frame_index);
+    ~frame_context();
+
+    frame_context(const frame_context&) = delete;
+    frame_context& operator=(const frame_context&) = delete;
+    frame_context(frame_context&&) = delete;
+    frame_context& operator=(frame_context&&) = delete;
+
+    NODISCARD inline command_list* get_command_list() const noexcept { return m_command_list.get(); }
+    NODISCARD inline descriptor::allocator_pool* get_descriptor_pool() noexcept { return &m_descriptor_pool; }
+    NODISCARD inline uint32_t get_image_index() const noexcept { return m_image_index; }
+    NODISCARD inline uint32_t get_frame_index() const noexcept { return m_frame_index; }
+
+    // linear allocation out of this frame's part of the mapped upload buffer, aligned to at least
+    // minUniformBufferOffsetAlignment so the result can back a uniform buffer descriptor or a dynamic offset.
+    // everything is released at once when the frame is reused
+    NODISCARD upload_allocation allocate_upload(VkDeviceSize size, VkDeviceSize alignment = 1);
+
+    // copies value into upload memory, for per object constants bound with a dynamic offset
+    template <typename Type>
+    NODISCARD upload_allocation push_upload(const Type& value)
+    {
+        static_assert(std::is_trivially_copyable_v<Type>, "upload data has to be trivially copyable");
+        auto allocation = allocate_upload(sizeof(Type));
+        std::memcpy(allocation.data, &value, sizeof(Type));
+        return allocation;
+    }
+
+private:
+    void reset();
+
+    weakref<device> m_device;
+
+    command_pool m_command_pool;
+    allocated_unique_ptr<command_list> m_command_list;
+    descriptor::allocator_pool m_descriptor_pool;
+
+    VkBuffer m_upload_buffer = VK_NULL_HANDLE;
+    char* m_upload_data = nullptr;
+    VkDeviceSize m_upload_begin {};
+    VkDeviceSize m_upload_end {};
+    VkDeviceSize m_upload_offset {};
+    VkDeviceSize m_min_alignment {};
+
+    VkFence m_fence = VK_NULL_HANDLE;
+    VkSemaphore m_image_available = VK_NULL_HANDLE;
+    VkSemaphore m_render_finished = VK_NULL_HANDLE;
+
+    // top and bottom of pipe timestamps, read back once the fence says the frame is done
+    VkQueryPool m_timestamp_pool = VK_NULL_HANDLE;
+    bool m_timestamps_pending = false;
+
+    frame_state m_state = frame_state::idle;
+    // the fence was waited on by an acquire that timed out, the retry goes straight to vkAcquireNextImageKHR
+    bool m_fence_waited = false;
+    std::chrono::steady_clock::time_point m_begin_time {};
+    uint64_t m_gpu_frame {};
+    render_target* m_target = nullptr;
+    uint32_t m_image_index {};
+    uint32_t m_frame_index {};
+};
+
+// owns acquire/submit/present for every frame in flight, the cpu only ever waits
+// on the fence of the frame it is about to reuse
+class frame_manager {
+public:
+    static constexpr VkDeviceSize default_upload_size = 4 * 1024 * 1024;
+
+    frame_manager(weakref<window> p_window, weakref<device> p_device, weakref<swapchain> p_swapchain, descriptor::allocator* p_descriptor_allocator, VkDeviceSize upload_size = default_upload_size);
+    ~frame_manager();
+
+    frame_manager(const frame_manager&) = delete;
+    frame_manager& operator=(const frame_manager&) = delete;
+    frame_manager(frame_manager&&) = delete;
+    frame_manager& operator=(frame_manager&&) = delete;
+
+    // returns nullptr when the swapchain had to be recreated, skip the frame in that case
+    NODISCARD frame_context* begin_frame(render_target& target);
+    void end_frame();
+
+    // the individual steps begin_frame/end_frame are built from, frame_pipeline runs them on separate threads.
+    // acquire_frame returns nullptr when the swapchain is out of date without recreating it.
+    // with a finite timeout it also returns nullptr and sets timed_out when no image was ready, call it again to retry
+    NODISCARD frame_context* acquire_frame(uint64_t timeout = UINT64_MAX, bool* timed_out = nullptr);
+    void begin_recording(frame_context& frame, render_target& target);
+    void submit_frame(frame_context& frame);
+    NODISCARD VkResult present_frame(frame_context& frame);
+    // consumes the pending semaphore of a frame that will never be presented so it can be reused
+    void cancel_frame(frame_context& frame);
+
+    NODISCARD inline uint32_t get_frames_in_flight() const noexcept { return static_cast<uint32_t>(m_frames.size()); }
+    // how many of the frames are currently cycled through, lower than get_frames_in_flight while adaptive pacing has trimmed it
+    NODISCARD inline uint32_t get_active_frames_in_flight() const noexcept { return m_active_frames.load(std::memory_order_relaxed); }
+
+    // drops frames in flight while the gpu keeps going idle waiting on the cpu and adds them back
+    // once the cpu starts blocking on fences, trading throughput for input latency only when it is free
+    void set_adaptive_frames_in_flight(bool enabled) noexcept;
+    // lower bound for the adaptive mode, frame_pipeline needs two
+    void set_min_frames_in_flight(uint32_t min_frames) noexcept;
+
+    // time from begin_recording to the cpu seeing the frame's fence signalled, an upper bound on input latency
+    NODISCARD inline double get_latency_ms() const noexcept { return m_latency_ms.load(std::memory_order_relaxed); }
+
+    NODISCARD inline frame_limiter& get_limiter() noexcept { return m_limiter; }
+
+    // the buffer behind every frame's allocate_upload, bind it once as UNIFORM_BUFFER_DYNAMIC with range set
+    // to the largest struct read through it and pass upload_allocation::get_dynamic_offset when binding the set.
+    // one descriptor set then serves every object in every frame
+    NODISCARD VkDescriptorBufferInfo get_upload_descriptor_info(VkDeviceSize range) const noexcept;
+
+    // present mode or image count were changed and the swapchain has to be recreated
+    NODISCARD bool get_swapchain_settings_changed() const noexcept;
+
+private:
+    void adapt_frames_in_flight(bool gpu_idle, double fence_wait_ms);
+
+    weakref<window> m_window;
+    weakref<device> m_device;
+    weakref<swapchain> m_swapchain;
+
+    // split into one equally sized part per frame in flight, outlives the frames
+    buffer_handle m_upload_buffer;
+    std::vector<std::unique_ptr<frame_context>> m_frames;
+    uint32_t m_current_frame = 0;
+    frame_context* m_active = nullptr;
+
+    frame_limiter m_limiter;
+
+    static constexpr uint32_t adapt_window = 30;
+    std::atomic<bool> m_adaptive = false;
+    std::atomic<uint32_t> m_min_frames = 1;
+    std::atomic<uint32_t> m_active_frames = 0;
+    uint32_t m_idle_streak = 0;
+    uint32_t m_busy_streak = 0;
+    std::chrono::steady_clock::time_point m_last_acquire {};
+    std::chrono::steady_clock::time_point m_last_submit {};
+    std::atomic<double> m_latency_ms = 0.0;
+};
+
+} // namespace quix
+
+#endif // _QUIX_FRAME_HPP
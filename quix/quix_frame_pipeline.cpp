@@ -0,0 +1,253 @@
+#ifndef _QUIX_FRAME_PIPELINE_CPP
+#define _QUIX_FRAME_PIPELINE_CPP
+
+#include "quix_frame_pipeline.hpp"
+
+#include "quix_frame.hpp"
+#include "quix_render_target.hpp"
+#include "quix_upload.hpp"
+#include "quix_window.hpp"
+
+namespace quix {
+
+frame_pipeline::frame_pipeline(weakref<window> p_window, weakref<frame_manager> p_frames, weakref<upload_manager> p_uploader, render_target& target, uint32_t queue_depth)
+    : m_window(std::move(p_window))
+    , m_frames(std::move(p_frames))
+    , m_uploader(std::move(p_uploader))
+    , m_target(&target)
+    , m_packets(queue_depth)
+    , m_acquired(1)
+    , m_presents(m_frames->get_frames_in_flight())
+{
+    // acquire runs a frame ahead, with a single frame it would wait on the fence of the frame being recorded
+    quix_assert(m_frames->get_frames_in_flight() >= 2, "frame_pipeline needs at least two frames in flight");
+    m_frames->set_min_frames_in_flight(2);
+
+    start();
+}
+
+frame_pipeline::~frame_pipeline()
+{
+    stop(false);
+    m_frames->set_min_frames_in_flight(1);
+}
+
+void frame_pipeline::submit(render_packet packet)
+{
+    m_frames->get_limiter().wait();
+
+    if (m_window->get_framebuffer_resized()) {
+        m_target->notify_resized();
+    }
+    if (m_suboptimal.exchange(false, std::memory_order_acq_rel)) {
+        m_target->notify_suboptimal();
+    }
+    if (m_recreate_requested.load(std::memory_order_acquire) || m_frames->get_swapchain_settings_changed() || m_target->get_resize_settled()) {
+        recreate_swapchain();
+    }
+
+    // uploads recorded inside an open upload batch have to reach the queue before the frame using them
+    m_uploader->flush();
+
+    if (!m_packets.push_or_keep(packet)) {
+        // the render thread stopped between the check above and the push, the packet runs after the next recreate
+        m_rejected.push_back(std::move(packet));
+        m_recreate_requested.store(true, std::memory_order_release);
+    }
+}
+
+void frame_pipeline::flush()
+{
+    stop(true);
+    while (!m_unrendered.empty()) {
+        recreate_swapchain();
+        stop(true);
+    }
+    start();
+}
+
+void frame_pipeline::start()
+{
+    m_packets.reopen();
+    m_acquired.reopen();
+    m_presents.reopen();
+    m_recreate_requested.store(false, std::memory_order_release);
+
+    const bool acquire_ahead = m_carried.empty();
+    m_render_thread = std::thread(&frame_pipeline::render_loop, this);
+    m_present_thread = std::thread(&frame_pipeline::present_loop, this, acquire_ahead);
+
+    // there may be more than queue_depth of them, so they go in once the render thread is taking packets
+    auto unrendered = std::move(m_unrendered);
+    m_unrendered.clear();
+    for (auto& packet : unrendered) {
+        if (!m_packets.push_or_keep(packet)) {
+            m_rejected.push_back(std::move(packet));
+            m_recreate_requested.store(true, std::memory_order_release);
+        }
+    }
+}
+
+void frame_pipeline::stop(bool keep_acquired)
+{
+    // the render thread drains what is already queued and then shuts the other stages down
+    m_packets.close();
+
+    if (m_render_thread.joinable()) {
+        m_render_thread.join();
+    }
+    if (m_present_thread.joinable()) {
+        m_present_thread.join();
+    }
+
+    // the present thread drains its queue before exiting, this only catches what never made it in
+    while (auto frame = m_presents.try_pop()) {
+        present(**frame);
+    }
+    if (m_unpresented != nullptr) {
+        present(*m_unpresented);
+        m_unpresented = nullptr;
+    }
+
+    // oldest first, so the next start records them in the order their images were acquired
+    while (auto frame = m_acquired.try_pop()) {
+        m_carried.push_back(*frame);
+    }
+    if (m_stranded != nullptr) {
+        m_carried.push_back(m_stranded);
+        m_stranded = nullptr;
+    }
+    if (!keep_acquired) {
+        for (auto* frame : m_carried) {
+            m_frames->cancel_frame(*frame);
+        }
+        m_carried.clear();
+    }
+
+    // in submission order, the packet the render thread was holding is the oldest
+    if (m_interrupted) {
+        m_unrendered.push_back(std::move(*m_interrupted));
+        m_interrupted.reset();
+    }
+    while (auto packet = m_packets.try_pop()) {
+        m_unrendered.push_back(std::move(*packet));
+    }
+    for (auto& packet : m_rejected) {
+        m_unrendered.push_back(std::move(packet));
+    }
+    m_rejected.clear();
+}
+
+void frame_pipeline::recreate_swapchain()
+{
+    // the old swapchain is retired with the frames still acquired from it, which releases their images
+    stop(false);
+    // render_target queries the framebuffer size through glfw, which is why this stays on the main thread
+    m_target->recreate_swapchain();
+    start();
+}
+
+void frame_pipeline::render_loop()
+{
+    while (auto packet = m_packets.pop()) {
+        frame_context* frame = nullptr;
+        if (!m_carried.empty()) {
+            frame = m_carried.front();
+            m_carried.pop_front();
+        } else if (auto acquired = m_acquired.pop()) {
+            frame = *acquired;
+        } else {
+            // the present thread stopped acquiring, the swapchain needs recreating and the packet runs after that
+            m_interrupted = std::move(*packet);
+            break;
+        }
+
+        m_frames->begin_recording(*frame, *m_target);
+        (*packet)(*frame);
+        m_frames->submit_frame(*frame);
+
+        if (!m_presents.push(frame)) {
+            m_unpresented = frame;
+            break;
+        }
+    }
+
+    // unblocks a main thread stuck in submit, anything still waiting to be presented
+    // gets drained by the present thread before it exits
+    m_packets.close();
+    m_acquired.close();
+    m_presents.close();
+}
+
+void frame_pipeline::present_loop(bool acquire_ahead)
+{
+    bool acquiring = true;
+
+    while (true) {
+        if (acquiring && acquire_ahead) {
+            auto* next = acquire_ahead_of_presents();
+            if (next == nullptr) {
+                m_recreate_requested.store(true, std::memory_order_release);
+                m_acquired.close();
+                acquiring = false;
+            } else if (!m_acquired.push(next)) {
+                // stopping, the frame is handed to the next start instead of holding on to its image
+                m_stranded = next;
+                acquiring = false;
+            }
+        }
+        acquire_ahead = true;
+
+        auto frame = m_presents.pop();
+        if (!frame) {
+            break;
+        }
+
+        if (present(**frame) == VK_ERROR_OUT_OF_DATE_KHR) {
+            // stop feeding the render thread, the main thread recreates on its next submit
+            m_acquired.close();
+            acquiring = false;
+        }
+    }
+}
+
+frame_context* frame_pipeline::acquire_ahead_of_presents()
+{
+    // frames waiting to be presented still hold their images, with the default minImageCount + 1 images an
+    // infinite acquire is not guaranteed to return then. the wait is split up and the waiting frames are
+    // presented in between, which gives their images back
+    while (true) {
+        bool timed_out = false;
+        auto* next = m_frames->acquire_frame(acquire_timeout_ns, &timed_out);
+        if (!timed_out) {
+            return next;
+        }
+
+        if (auto frame = m_presents.try_pop()) {
+            present(**frame);
+        } else if (m_presents.is_closed()) {
+            // the render thread is gone, nothing will give an image back anymore
+            return nullptr;
+        }
+    }
+}
+
+VkResult frame_pipeline::present(frame_context& frame)
+{
+    VkResult result = m_frames->present_frame(frame);
+    m_presented_frames.fetch_add(1, std::memory_order_relaxed);
+
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+        m_recreate_requested.store(true, std::memory_order_release);
+    } else if (result == VK_SUBOPTIMAL_KHR) {
+        // still presentable, the main thread debounces it like a resize
+        m_suboptimal.store(true, std::memory_order_release);
+    } else if (result != VK_SUCCESS) {
+        quix_error("failed to present swapchain image");
+    }
+    return result;
+}
+
+} // namespace quix
+
+#endif // _QUIX_FRAME_PIPELINE_CPP
@@ -0,0 +1,91 @@
+#ifndef _QUIX_FRAME_PIPELINE_HPP
+#define _QUIX_FRAME_PIPELINE_HPP
+
+#include "quix_bounded_queue.hpp"
+
+namespace quix {
+
+class window;
+class render_target;
+class frame_context;
+class frame_manager;
+class upload_manager;
+
+// records a frame on the render thread, everything it needs from the simulation
+// has to be captured by value since the main thread is already working on the next frame
+using render_packet = std::function<void(frame_context&)>;
+
+// pipelined alternative to instance::begin_frame/end_frame.
+// the main thread keeps input and simulation and hands a render_packet per frame to submit,
+// a render thread records and submits it and a present thread presents and acquires the next image,
+// so vkAcquireNextImageKHR and present blocking never stall the simulation.
+// glfw is still only touched from the main thread, swapchain recreation happens inside submit
+class frame_pipeline {
+public:
+    // queue_depth is how many packets the simulation may run ahead of the render thread
+    // uploads recorded before a submit are flushed ahead of its packet
+    frame_pipeline(weakref<window> p_window, weakref<frame_manager> p_frames, weakref<upload_manager> p_uploader, render_target& target, uint32_t queue_depth = 1);
+    ~frame_pipeline();
+
+    frame_pipeline(const frame_pipeline&) = delete;
+    frame_pipeline& operator=(const frame_pipeline&) = delete;
+    frame_pipeline(frame_pipeline&&) = delete;
+    frame_pipeline& operator=(frame_pipeline&&) = delete;
+
+    // main thread only, blocks while the render thread is queue_depth packets behind
+    void submit(render_packet packet);
+
+    // main thread only, blocks until every submitted packet has been presented. packets the render thread
+    // could not get to because the swapchain went out of date are recorded again on the recreated one,
+    // so while the window is minimized this keeps waiting for it to come back
+    void flush();
+
+    NODISCARD inline uint64_t get_presented_frames() const noexcept { return m_presented_frames.load(std::memory_order_relaxed); }
+
+private:
+    void start();
+    // every submitted frame is presented. frames that were acquired but not recorded yet are kept for the next
+    // start with keep_acquired, since the swapchain only gives its images back through a present. otherwise
+    // they are cancelled, which is only fine right before the swapchain is recreated and the old one retired
+    void stop(bool keep_acquired);
+    void recreate_swapchain();
+
+    void render_loop();
+    // acquire_ahead is false while frames from the last stop are still waiting to be recorded,
+    // those already take the frame contexts an early acquire would reuse
+    void present_loop(bool acquire_ahead);
+    // nullptr when the swapchain is out of date or the render thread stopped
+    NODISCARD frame_context* acquire_ahead_of_presents();
+    VkResult present(frame_context& frame);
+
+    weakref<window> m_window;
+    weakref<frame_manager> m_frames;
+    weakref<upload_manager> m_uploader;
+    render_target* m_target;
+
+    static constexpr uint64_t acquire_timeout_ns = 1'000'000;
+
+    bounded_queue<render_packet> m_packets;
+    // acquire runs one image ahead of the render thread
+    bounded_queue<frame_context*> m_acquired;
+    bounded_queue<frame_context*> m_presents;
+
+    // only touched by the main thread, or by the render and present threads between start and stop
+    std::deque<frame_context*> m_carried {};
+    std::vector<render_packet> m_unrendered {};
+    std::vector<render_packet> m_rejected {};
+    std::optional<render_packet> m_interrupted {};
+    frame_context* m_unpresented = nullptr;
+    frame_context* m_stranded = nullptr;
+
+    std::thread m_render_thread;
+    std::thread m_present_thread;
+
+    std::atomic<bool> m_recreate_requested = false;
+    std::atomic<bool> m_suboptimal = false;
+    std::atomic<uint64_t> m_presented_frames = 0;
+};
+
+} // namespace quix
+
+#endif // _QUIX_FRAME_PIPELINE_HPP
@@ -0,0 +1,134 @@
+#ifndef _QUIX_GEOMETRY_CPP
+#define _QUIX_GEOMETRY_CPP
+
+#include "quix_geometry.hpp"
+
+#include "quix_commands.hpp"
+#include "quix_device.hpp"
+
+namespace quix {
+
+geometry_pool::virtual_blocks::~virtual_blocks()
+{
+    // anything still allocated belongs to meshes that were never freed, the blocks go away with the pool either way
+    if (vertices != VK_NULL_HANDLE) {
+        vmaClearVirtualBlock(vertices);
+        vmaDestroyVirtualBlock(vertices);
+    }
+    if (indices != VK_NULL_HANDLE) {
+        vmaClearVirtualBlock(indices);
+        vmaDestroyVirtualBlock(indices);
+    }
+}
+
+geometry_pool::geometry_pool(weakref<device> p_device, weakref<upload_manager> p_uploader, uint32_t vertex_stride, VkIndexType index_type, uint32_t max_vertices, uint32_t max_indices)
+    : m_device(std::move(p_device))
+    , m_uploader(std::move(p_uploader))
+    , m_vertex_buffer(m_device)
+    , m_index_buffer(m_device)
+    , m_blocks(std::make_shared<virtual_blocks>())
+    , m_vertex_stride(vertex_stride)
+    , m_index_size(index_type == VK_INDEX_TYPE_UINT16 ? 2 : 4)
+    , m_index_type(index_type)
+{
+    quix_assert(vertex_stride > 0 && max_vertices > 0 && max_indices > 0, "geometry pool needs a vertex stride and room for vertices and indices");
+    quix_assert(index_type == VK_INDEX_TYPE_UINT16 || index_type == VK_INDEX_TYPE_UINT32, "geometry pool indices have to be uint16 or uint32");
+
+    m_vertex_buffer.create_gpu_buffer(static_cast<VkDeviceSize>(max_vertices) * vertex_stride, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    m_index_buffer.create_gpu_buffer(static_cast<VkDeviceSize>(max_indices) * m_index_size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+    // the blocks count elements, not bytes
+    VmaVirtualBlockCreateInfo block_info {};
+    block_info.size = max_vertices;
+    VK_CHECK(vmaCreateVirtualBlock(&block_info, &m_blocks->vertices), "failed to create virtual block");
+    block_info.size = max_indices;
+    VK_CHECK(vmaCreateVirtualBlock(&block_info, &m_blocks->indices), "failed to create virtual block");
+}
+
+geometry_pool::~geometry_pool() = default;
+
+NODISCARD std::optional<geometry_allocation> geometry_pool::allocate(const void* vertices, uint32_t vertex_count, const void* indices, uint32_t index_count)
+{
+    quix_assert(vertex_count > 0 && index_count > 0, "geometry allocations need vertices and indices");
+
+    geometry_allocation allocation {};
+    allocation.vertex_count = vertex_count;
+    allocation.index_count = index_count;
+
+    {
+        std::lock_guard<std::mutex> lock(m_blocks->mutex);
+
+        VmaVirtualAllocationCreateInfo alloc_info {};
+        VkDeviceSize offset {};
+
+        alloc_info.size = vertex_count;
+        if (vmaVirtualAllocate(m_blocks->vertices, &alloc_info, &allocation.vertex_allocation, &offset) != VK_SUCCESS) {
+            spdlog::warn("geometry pool is out of vertex space for {} vertices", vertex_count);
+            return std::nullopt;
+        }
+        allocation.vertex_offset = static_cast<int32_t>(offset);
+
+        alloc_info.size = index_count;
+        if (vmaVirtualAllocate(m_blocks->indices, &alloc_info, &allocation.index_allocation, &offset) != VK_SUCCESS) {
+            vmaVirtualFree(m_blocks->vertices, allocation.vertex_allocation);
+            spdlog::warn("geometry pool is out of index space for {} indices", index_count);
+            return std::nullopt;
+        }
+        allocation.first_index = static_cast<uint32_t>(offset);
+    }
+
+    m_uploader->upload_buffer(m_vertex_buffer.get_buffer(), static_cast<VkDeviceSize>(allocation.vertex_offset) * m_vertex_stride,
+        vertices, static_cast<VkDeviceSize>(vertex_count) * m_vertex_stride);
+    m_uploader->upload_buffer(m_index_buffer.get_buffer(), static_cast<VkDeviceSize>(allocation.first_index) * m_index_size,
+        indices, static_cast<VkDeviceSize>(index_count) * m_index_size);
+
+    return allocation;
+}
+
+void geometry_pool::free(const geometry_allocation& allocation)
+{
+    // frames in flight may still draw the mesh, the ranges are only handed out again once they are done
+    m_device->defer_destroy([blocks = m_blocks, vertex_allocation = allocation.vertex_allocation, index_allocation = allocation.index_allocation]() {
+        std::lock_guard<std::mutex> lock(blocks->mutex);
+        vmaVirtualFree(blocks->vertices, vertex_allocation);
+        vmaVirtualFree(blocks->indices, index_allocation);
+    });
+}
+
+upload_ticket geometry_pool::flush()
+{
+    return m_uploader->flush();
+}
+
+void geometry_pool::bind(command_list* commands, uint32_t binding) const
+{
+    const VkBuffer vertex_buffer = m_vertex_buffer.get_buffer();
+    const VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(commands->get_cmd_buffer(), binding, 1, &vertex_buffer, &offset);
+    vkCmdBindIndexBuffer(commands->get_cmd_buffer(), m_index_buffer.get_buffer(), 0, m_index_type);
+}
+
+void geometry_pool::draw(command_list* commands, const geometry_allocation& allocation, uint32_t instance_count, uint32_t first_instance) const
+{
+    vkCmdDrawIndexed(commands->get_cmd_buffer(), allocation.index_count, instance_count, allocation.first_index, allocation.vertex_offset, first_instance);
+}
+
+NODISCARD uint32_t geometry_pool::get_used_vertices() const
+{
+    std::lock_guard<std::mutex> lock(m_blocks->mutex);
+    VmaStatistics stats {};
+    vmaGetVirtualBlockStatistics(m_blocks->vertices, &stats);
+    return static_cast<uint32_t>(stats.allocationBytes);
+}
+
+NODISCARD uint32_t geometry_pool::get_used_indices() const
+{
+    std::lock_guard<std::mutex> lock(m_blocks->mutex);
+    VmaStatistics stats {};
+    vmaGetVirtualBlockStatistics(m_blocks->indices, &stats);
+    return static_cast<uint32_t>(stats.allocationBytes);
+}
+
+} // namespace quix
+
+#endif // _QUIX_GEOMETRY_CPP
@@ -0,0 +1,82 @@
+#ifndef _QUIX_GEOMETRY_HPP
+#define _QUIX_GEOMETRY_HPP
+
+#include "quix_resource.hpp"
+#include "quix_upload.hpp"
+
+namespace quix {
+
+class device;
+class command_list;
+
+// where a mesh lives in a geometry_pool, counted in vertices and indices so it maps
+// straight onto the vertexOffset and firstIndex of vkCmdDrawIndexed
+struct geometry_allocation {
+    VmaVirtualAllocation vertex_allocation = VK_NULL_HANDLE;
+    VmaVirtualAllocation index_allocation = VK_NULL_HANDLE;
+    int32_t vertex_offset {};
+    uint32_t vertex_count {};
+    uint32_t first_index {};
+    uint32_t index_count {};
+};
+
+// packs the vertices and indices of many meshes into one vertex and one index buffer so a whole
+// scene draws with a single bind. ranges are handed out by vma virtual blocks measured in whole
+// vertices and indices, which keeps every mesh aligned to the vertex stride without padding.
+// allocate, free and flush are main thread only, freed ranges are reused once the frames that
+// could draw them have finished
+class geometry_pool {
+public:
+    geometry_pool(weakref<device> p_device, weakref<upload_manager> p_uploader, uint32_t vertex_stride, VkIndexType index_type, uint32_t max_vertices, uint32_t max_indices);
+    ~geometry_pool();
+
+    geometry_pool(const geometry_pool&) = delete;
+    geometry_pool& operator=(const geometry_pool&) = delete;
+    geometry_pool(geometry_pool&&) = delete;
+    geometry_pool& operator=(geometry_pool&&) = delete;
+
+    // std::nullopt when either buffer has no contiguous range left. the data goes through the upload manager
+    // without flushing, call flush once after adding a batch of meshes and before drawing them
+    NODISCARD std::optional<geometry_allocation> allocate(const void* vertices, uint32_t vertex_count, const void* indices, uint32_t index_count);
+    void free(const geometry_allocation& allocation);
+
+    upload_ticket flush();
+
+    // binds the vertex buffer to binding and the index buffer, once for every mesh drawn from the pool
+    void bind(command_list* commands, uint32_t binding = 0) const;
+    void draw(command_list* commands, const geometry_allocation& allocation, uint32_t instance_count = 1, uint32_t first_instance = 0) const;
+
+    NODISCARD inline VkBuffer get_vertex_buffer() const noexcept { return m_vertex_buffer.get_buffer(); }
+    NODISCARD inline VkBuffer get_index_buffer() const noexcept { return m_index_buffer.get_buffer(); }
+    NODISCARD inline VkIndexType get_index_type() const noexcept { return m_index_type; }
+    NODISCARD inline uint32_t get_vertex_stride() const noexcept { return m_vertex_stride; }
+
+    // in vertices and indices, freed ranges count until they are actually released
+    NODISCARD uint32_t get_used_vertices() const;
+    NODISCARD uint32_t get_used_indices() const;
+
+private:
+    // outlives the pool while deferred frees still point at it
+    struct virtual_blocks {
+        std::mutex mutex;
+        VmaVirtualBlock vertices = VK_NULL_HANDLE;
+        VmaVirtualBlock indices = VK_NULL_HANDLE;
+
+        ~virtual_blocks();
+    };
+
+    weakref<device> m_device;
+    weakref<upload_manager> m_uploader;
+
+    buffer_handle m_vertex_buffer;
+    buffer_handle m_index_buffer;
+    std::shared_ptr<virtual_blocks> m_blocks;
+
+    uint32_t m_vertex_stride {};
+    uint32_t m_index_size {};
+    VkIndexType m_index_type {};
+};
+
+} // namespace quix
+
+#endif // _QUIX_GEOMETRY_HPP
@@ -0,0 +1,270 @@
+#ifndef _QUIX_HANDLE_TABLE_CPP
+#define _QUIX_HANDLE_TABLE_CPP
+
+#include "quix_handle_table.hpp"
+
+#include "quix_device.hpp"
+#include "quix_resource.hpp"
+
+namespace quix {
+
+// id_allocator class
+
+id_allocator::id_allocator(uint32_t capacity)
+    : m_generations(std::make_unique<uint32_t[]>(capacity))
+    , m_capacity(capacity)
+{
+    quix_assert(capacity > 0 && capacity <= buffer_id::index_mask + 1, "handle table capacity does not fit the id index bits");
+
+    // generation 0 is never handed out, which keeps zero ids null
+    std::fill_n(m_generations.get(), capacity, 1u);
+}
+
+NODISCARD std::optional<uint32_t> id_allocator::allocate()
+{
+    if (!m_free.empty()) {
+        const uint32_t index = m_free.back();
+        m_free.pop_back();
+        m_count++;
+        return index;
+    }
+
+    if (m_high_water == m_capacity) {
+        return std::nullopt;
+    }
+
+    m_count++;
+    return m_high_water++;
+}
+
+void id_allocator::free(uint32_t index)
+{
+    auto& generation = m_generations[index];
+    generation = generation == buffer_id::max_generation ? 1 : generation + 1;
+    m_free.push_back(index);
+    m_count--;
+}
+
+// id_allocator end
+
+// buffer_table class
+
+buffer_table::buffer_table(device* p_device, uint32_t capacity)
+    : m_device(p_device)
+    , m_ids(capacity)
+    , m_buffers(std::make_unique<VkBuffer[]>(capacity))
+    , m_cold(std::make_unique<cold_data[]>(capacity))
+{
+}
+
+buffer_table::~buffer_table()
+{
+    uint32_t leaked = 0;
+    for (uint32_t i = 0; i < m_ids.get_high_water(); i++) {
+        if (m_buffers[i] != VK_NULL_HANDLE) {
+            vmaDestroyBuffer(m_device->get_allocator(), m_buffers[i], m_cold[i].alloc);
+            leaked++;
+        }
+    }
+    if (leaked > 0) {
+        spdlog::warn("{} buffers were still in the buffer table when it was destroyed", leaked);
+    }
+}
+
+NODISCARD buffer_id buffer_table::create(const VkBufferCreateInfo& create_info, const VmaAllocationCreateInfo& alloc_info)
+{
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VmaAllocation alloc {};
+    VmaAllocationInfo info {};
+    VK_CHECK(vmaCreateBuffer(m_device->get_allocator(), &create_info, &alloc_info, &buffer, &alloc, &info), "failed to create buffer");
+
+    const auto id = insert(buffer, { alloc, create_info.size, info.pMappedData, create_info.usage });
+    if (id.is_null()) {
+        vmaDestroyBuffer(m_device->get_allocator(), buffer, alloc);
+    }
+    return id;
+}
+
+NODISCARD buffer_id buffer_table::adopt(buffer_handle&& handle)
+{
+    quix_assert(handle.m_slot != nullptr && handle.m_slot->buffer != VK_NULL_HANDLE, "only created buffers can be adopted");
+
+    auto& slot = *handle.m_slot;
+    m_device->release_resource(slot);
+
+    const auto id = insert(slot.buffer, { slot.alloc, slot.buffer_info.size, slot.alloc_info.pMappedData, slot.buffer_info.usage });
+    quix_assert(!id.is_null(), "buffer table is full");
+
+    handle.m_slot.reset();
+    return id;
+}
+
+void buffer_table::destroy(buffer_id id)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    quix_assert(m_ids.is_valid(id), "destroying a stale or null buffer id");
+
+    const uint32_t index = id.get_index();
+    m_device->defer_destroy([allocator = m_device->get_allocator(), buffer = m_buffers[index], alloc = m_cold[index].alloc]() {
+        vmaDestroyBuffer(allocator, buffer, alloc);
+    });
+
+    m_buffers[index] = VK_NULL_HANDLE;
+    m_cold[index] = {};
+    m_ids.free(index);
+}
+
+NODISCARD buffer_id buffer_table::insert(VkBuffer buffer, const cold_data& cold)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const auto index = m_ids.allocate();
+    if (!index.has_value()) {
+        spdlog::error("buffer table is full, {} buffers", m_ids.get_capacity());
+        return {};
+    }
+
+    m_buffers[*index] = buffer;
+    m_cold[*index] = cold;
+    return buffer_id::make(*index, m_ids.get_generation(*index));
+}
+
+// buffer_table end
+
+// image_table class
+
+image_table::image_table(device* p_device, uint32_t capacity)
+    : m_device(p_device)
+    , m_ids(capacity)
+    , m_images(std::make_unique<VkImage[]>(capacity))
+    , m_views(std::make_unique<VkImageView[]>(capacity))
+    , m_samplers(std::make_unique<VkSampler[]>(capacity))
+    , m_cold(std::make_unique<cold_data[]>(capacity))
+{
+}
+
+image_table::~image_table()
+{
+    uint32_t leaked = 0;
+    for (uint32_t i = 0; i < m_ids.get_high_water(); i++) {
+        if (m_images[i] != VK_NULL_HANDLE) {
+            vkDestroyImageView(m_device->get_logical_device(), m_views[i], nullptr);
+            vmaDestroyImage(m_device->get_allocator(), m_images[i], m_cold[i].alloc);
+            leaked++;
+        }
+    }
+    if (leaked > 0) {
+        spdlog::warn("{} images were still in the image table when it was destroyed", leaked);
+    }
+}
+
+NODISCARD image_id image_table::create(const VkImageCreateInfo& create_info, const VmaAllocationCreateInfo& alloc_info, VkImageAspectFlags view_aspect)
+{
+    VkImage image = VK_NULL_HANDLE;
+    VmaAllocation alloc {};
+    VK_CHECK(vmaCreateImage(m_device->get_allocator(), &create_info, &alloc_info, &image, &alloc, nullptr), "failed to create image");
+
+    VkImageView view = VK_NULL_HANDLE;
+    if (view_aspect != 0) {
+        VkImageViewCreateInfo view_info {};
+        view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        view_info.image = image;
+        view_info.format = create_info.format;
+        view_info.subresourceRange = { view_aspect, 0, create_info.mipLevels, 0, create_info.arrayLayers };
+
+        switch (create_info.imageType) {
+            case VK_IMAGE_TYPE_1D:
+                view_info.viewType = create_info.arrayLayers > 1 ? VK_IMAGE_VIEW_TYPE_1D_ARRAY : VK_IMAGE_VIEW_TYPE_1D;
+                break;
+            case VK_IMAGE_TYPE_3D:
+                view_info.viewType = VK_IMAGE_VIEW_TYPE_3D;
+                break;
+            default:
+                if ((create_info.flags & VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT) && create_info.arrayLayers % 6 == 0) {
+                    view_info.viewType = create_info.arrayLayers == 6 ? VK_IMAGE_VIEW_TYPE_CUBE : VK_IMAGE_VIEW_TYPE_CUBE_ARRAY;
+                } else {
+                    view_info.viewType = create_info.arrayLayers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+                }
+                break;
+        }
+
+        VK_CHECK(vkCreateImageView(m_device->get_logical_device(), &view_info, nullptr, &view), "failed to create image view");
+    }
+
+    const auto id = insert(image, view, VK_NULL_HANDLE,
+        { alloc, create_info.format, create_info.extent, create_info.mipLevels, create_info.arrayLayers, create_info.usage });
+    if (id.is_null()) {
+        vkDestroyImageView(m_device->get_logical_device(), view, nullptr);
+        vmaDestroyImage(m_device->get_allocator(), image, alloc);
+    }
+    return id;
+}
+
+NODISCARD image_id image_table::adopt(image_handle&& handle)
+{
+    quix_assert(handle.m_slot != nullptr && handle.m_slot->image != VK_NULL_HANDLE, "only created images can be adopted");
+
+    auto& slot = *handle.m_slot;
+    m_device->release_resource(slot);
+
+    // the table only keeps the full view, the cached ones go the way a destroyed image's would
+    if (!slot.subresource_views.empty()) {
+        m_device->defer_destroy([logical_device = m_device->get_logical_device(), views = std::move(slot.subresource_views)]() {
+            for (const auto& cached : views) {
+                vkDestroyImageView(logical_device, cached.view, nullptr);
+            }
+        });
+    }
+
+    const auto& info = slot.image_info;
+    const auto id = insert(slot.image, slot.view, handle.m_sampler,
+        { slot.alloc, info.format, info.extent, info.mipLevels, info.arrayLayers, info.usage });
+    quix_assert(!id.is_null(), "image table is full");
+
+    handle.m_sampler = VK_NULL_HANDLE;
+    handle.m_slot.reset();
+    return id;
+}
+
+void image_table::destroy(image_id id)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    quix_assert(m_ids.is_valid(id), "destroying a stale or null image id");
+
+    const uint32_t index = id.get_index();
+    // the sampler belongs to the device's sampler cache
+    m_device->defer_destroy([logical_device = m_device->get_logical_device(), allocator = m_device->get_allocator(),
+                                image = m_images[index], view = m_views[index], alloc = m_cold[index].alloc]() {
+        vkDestroyImageView(logical_device, view, nullptr);
+        vmaDestroyImage(allocator, image, alloc);
+    });
+
+    m_images[index] = VK_NULL_HANDLE;
+    m_views[index] = VK_NULL_HANDLE;
+    m_samplers[index] = VK_NULL_HANDLE;
+    m_cold[index] = {};
+    m_ids.free(index);
+}
+
+NODISCARD image_id image_table::insert(VkImage image, VkImageView view, VkSampler sampler, const cold_data& cold)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const auto index = m_ids.allocate();
+    if (!index.has_value()) {
+        spdlog::error("image table is full, {} images", m_ids.get_capacity());
+        return {};
+    }
+
+    m_images[*index] = image;
+    m_views[*index] = view;
+    m_samplers[*index] = sampler;
+    m_cold[*index] = cold;
+    return image_id::make(*index, m_ids.get_generation(*index));
+}
+
+// image_table end
+
+} // namespace quix
+
+#endif // _QUIX_HANDLE_TABLE_CPP
@@ -0,0 +1,212 @@
+#ifndef _QUIX_HANDLE_TABLE_HPP
+#define _QUIX_HANDLE_TABLE_HPP
+
+namespace quix {
+
+class device;
+class buffer_handle;
+class image_handle;
+
+// 32 bit id into a buffer_table or image_table, the low bits index the table and the high bits hold the
+// generation of the entry. destroying an entry moves its generation on, so ids that outlive it stop resolving.
+// a zero id is never handed out
+template <typename tag>
+struct resource_id {
+    static constexpr uint32_t index_bits = 20;
+    static constexpr uint32_t index_mask = (1u << index_bits) - 1;
+    static constexpr uint32_t max_generation = (1u << (32 - index_bits)) - 1;
+
+    uint32_t value {};
+
+    NODISCARD static constexpr resource_id make(uint32_t index, uint32_t generation) noexcept
+    {
+        return resource_id { (generation << index_bits) | index };
+    }
+
+    NODISCARD constexpr uint32_t get_index() const noexcept { return value & index_mask; }
+    NODISCARD constexpr uint32_t get_generation() const noexcept { return value >> index_bits; }
+    NODISCARD constexpr bool is_null() const noexcept { return value == 0; }
+
+    constexpr bool operator==(const resource_id&) const noexcept = default;
+};
+
+using buffer_id = resource_id<struct buffer_id_tag>;
+using image_id = resource_id<struct image_id_tag>;
+
+// hands out table indices, freed indices are reused first
+class id_allocator {
+public:
+    explicit id_allocator(uint32_t capacity);
+
+    // std::nullopt when the table is full
+    NODISCARD std::optional<uint32_t> allocate();
+    void free(uint32_t index);
+
+    NODISCARD inline uint32_t get_generation(uint32_t index) const noexcept { return m_generations[index]; }
+    NODISCARD inline uint32_t get_capacity() const noexcept { return m_capacity; }
+    NODISCARD inline uint32_t get_count() const noexcept { return m_count; }
+    // every index below this has been handed out at least once
+    NODISCARD inline uint32_t get_high_water() const noexcept { return m_high_water; }
+
+    template <typename tag>
+    NODISCARD inline bool is_valid(resource_id<tag> id) const noexcept
+    {
+        return !id.is_null() && id.get_index() < m_high_water && m_generations[id.get_index()] == id.get_generation();
+    }
+
+private:
+    // moved on when an index is freed
+    std::unique_ptr<uint32_t[]> m_generations;
+    std::vector<uint32_t> m_free {};
+    uint32_t m_capacity {};
+    uint32_t m_count {};
+    uint32_t m_high_water {};
+};
+
+// buffers addressed by buffer_id instead of a buffer_handle. the fields are split into arrays so recording
+// draws only pulls the VkBuffer array into cache, the allocation and its bookkeeping live in separate arrays.
+// the arrays are sized once at construction and never move, reads can run on any thread as long as the id is
+// not destroyed concurrently, create/adopt/destroy take a lock
+class buffer_table {
+public:
+    buffer_table(device* p_device, uint32_t capacity);
+    ~buffer_table();
+
+    buffer_table(const buffer_table&) = delete;
+    buffer_table& operator=(const buffer_table&) = delete;
+    buffer_table(buffer_table&&) = delete;
+    buffer_table& operator=(buffer_table&&) = delete;
+
+    // a null id when the table is full
+    NODISCARD buffer_id create(const VkBufferCreateInfo& create_info, const VmaAllocationCreateInfo& alloc_info);
+    // takes over the buffer of a created handle, which is left as if moved from. adopted buffers are not defragmented
+    NODISCARD buffer_id adopt(buffer_handle&& handle);
+    // the buffer is released once the frames that could use it are done, the id is invalid right away
+    void destroy(buffer_id id);
+
+    NODISCARD inline bool is_valid(buffer_id id) const noexcept { return m_ids.is_valid(id); }
+
+    // hot
+    NODISCARD inline VkBuffer get_buffer(buffer_id id) const noexcept
+    {
+        quix_assert(is_valid(id), "stale or null buffer id");
+        return m_buffers[id.get_index()];
+    }
+
+    // cold
+    NODISCARD inline VkDeviceSize get_size(buffer_id id) const noexcept { return m_cold[id.get_index()].size; }
+    NODISCARD inline VmaAllocation get_allocation(buffer_id id) const noexcept { return m_cold[id.get_index()].alloc; }
+    NODISCARD inline void* get_mapped_data(buffer_id id) const noexcept
+    {
+        quix_assert(m_cold[id.get_index()].mapped_data != nullptr, "buffer is not mapped");
+        return m_cold[id.get_index()].mapped_data;
+    }
+    NODISCARD inline VkDescriptorBufferInfo get_descriptor_info(buffer_id id, uint32_t offset = 0) const noexcept
+    {
+        VkDescriptorBufferInfo info {};
+        info.buffer = get_buffer(id);
+        info.offset = offset;
+        info.range = m_cold[id.get_index()].size;
+        return info;
+    }
+
+    NODISCARD inline uint32_t get_count() const noexcept { return m_ids.get_count(); }
+
+private:
+    struct cold_data {
+        VmaAllocation alloc {};
+        VkDeviceSize size {};
+        void* mapped_data = nullptr;
+        VkBufferUsageFlags usage {};
+    };
+
+    NODISCARD buffer_id insert(VkBuffer buffer, const cold_data& cold);
+
+    device* m_device;
+    std::mutex m_mutex {};
+    id_allocator m_ids;
+    std::unique_ptr<VkBuffer[]> m_buffers;
+    std::unique_ptr<cold_data[]> m_cold;
+};
+
+// images addressed by image_id, split like buffer_table. the image, view and sampler that descriptor writes and
+// barriers need are the hot arrays, the allocation and the image metadata are cold
+class image_table {
+public:
+    image_table(device* p_device, uint32_t capacity);
+    ~image_table();
+
+    image_table(const image_table&) = delete;
+    image_table& operator=(const image_table&) = delete;
+    image_table(image_table&&) = delete;
+    image_table& operator=(image_table&&) = delete;
+
+    // creates a view covering every mip and layer unless view_aspect is 0, a null id when the table is full
+    NODISCARD image_id create(const VkImageCreateInfo& create_info, const VmaAllocationCreateInfo& alloc_info,
+        VkImageAspectFlags view_aspect = VK_IMAGE_ASPECT_COLOR_BIT);
+    // takes over the image and view of a created handle and shares its cached sampler, the handle is left as if moved from. this is how
+    // textures loaded through image_handle end up in the table. adopted images are not defragmented
+    NODISCARD image_id adopt(image_handle&& handle);
+    // the image is released once the frames that could use it are done, the id is invalid right away
+    void destroy(image_id id);
+
+    NODISCARD inline bool is_valid(image_id id) const noexcept { return m_ids.is_valid(id); }
+
+    // hot
+    NODISCARD inline VkImage get_image(image_id id) const noexcept
+    {
+        quix_assert(is_valid(id), "stale or null image id");
+        return m_images[id.get_index()];
+    }
+    NODISCARD inline VkImageView get_view(image_id id) const noexcept
+    {
+        quix_assert(is_valid(id), "stale or null image id");
+        return m_views[id.get_index()];
+    }
+    NODISCARD inline VkSampler get_sampler(image_id id) const noexcept
+    {
+        quix_assert(is_valid(id), "stale or null image id");
+        return m_samplers[id.get_index()];
+    }
+    NODISCARD inline VkDescriptorImageInfo get_descriptor_info(image_id id) const noexcept
+    {
+        VkDescriptorImageInfo info {};
+        info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        info.imageView = get_view(id);
+        info.sampler = m_samplers[id.get_index()];
+        return info;
+    }
+
+    // cold
+    NODISCARD inline VmaAllocation get_allocation(image_id id) const noexcept { return m_cold[id.get_index()].alloc; }
+    NODISCARD inline VkFormat get_format(image_id id) const noexcept { return m_cold[id.get_index()].format; }
+    NODISCARD inline VkExtent3D get_extent(image_id id) const noexcept { return m_cold[id.get_index()].extent; }
+    NODISCARD inline uint32_t get_mip_levels(image_id id) const noexcept { return m_cold[id.get_index()].mip_levels; }
+    NODISCARD inline uint32_t get_array_layers(image_id id) const noexcept { return m_cold[id.get_index()].array_layers; }
+
+    NODISCARD inline uint32_t get_count() const noexcept { return m_ids.get_count(); }
+
+private:
+    struct cold_data {
+        VmaAllocation alloc {};
+        VkFormat format {};
+        VkExtent3D extent {};
+        uint32_t mip_levels {};
+        uint32_t array_layers {};
+        VkImageUsageFlags usage {};
+    };
+
+    NODISCARD image_id insert(VkImage image, VkImageView view, VkSampler sampler, const cold_data& cold);
+
+    device* m_device;
+    std::mutex m_mutex {};
+    id_allocator m_ids;
+    std::unique_ptr<VkImage[]> m_images;
+    std::unique_ptr<VkImageView[]> m_views;
+    std::unique_ptr<VkSampler[]> m_samplers;
+    std::unique_ptr<cold_data[]> m_cold;
+};
+
+} // namespace quix
+
+#endif // _QUIX_HANDLE_TABLE_HPP
@@ -3,14 +3,22 @@
 
 #include "quix_instance.hpp"
 
+#include "quix_capture.hpp"
 #include "quix_commands.hpp"
 #include "quix_common.hpp"
 #include "quix_descriptor.hpp"
 #include "quix_device.hpp"
+#include "quix_frame.hpp"
+#include "quix_frame_pipeline.hpp"
+#include "quix_geometry.hpp"
 #include "quix_pipeline.hpp"
 #include "quix_render_target.hpp"
 #include "quix_resource.hpp"
+#include "quix_sampler_cache.hpp"
+#include "quix_streaming.hpp"
 #include "quix_swapchain.hpp"
+#include "quix_transient.hpp"
+#include "quix_upload.hpp"
 #include "quix_window.hpp"
 
 namespace quix {
@@ -41,7 +49,10 @@ instance::instance(const char* app_name,
         "instance buffer size is too small");
 }
 
-instance::~instance() = default;
+instance::~instance()
+{
+    end_capture();
+}
 
 void instance::create_device(std::vector<const char*>&& requested_extensions, VkPhysicalDeviceFeatures requested_features)
 {
@@ -70,6 +81,24 @@ NODISCARD command_pool instance::get_command_pool()
     };
 }
 
+NODISCARD weakref<upload_manager> instance::get_upload_manager()
+{
+    if (m_upload_manager == nullptr) {
+        m_upload_manager = std::make_unique<upload_manager>(make_weakref<device>(m_device));
+    }
+
+    return make_weakref<upload_manager>(m_upload_manager);
+}
+
+NODISCARD weakref<texture_streamer> instance::get_texture_streamer()
+{
+    if (m_texture_streamer == nullptr) {
+        m_texture_streamer = std::make_unique<texture_streamer>(make_weakref<device>(m_device), get_upload_manager());
+    }
+
+    return make_weakref<texture_streamer>(m_texture_streamer);
+}
+
 NODISCARD render_target instance::create_single_pass_render_target() noexcept
 {
     quix::renderpass_info<1, 1, 1> renderpass_info {};
@@ -116,10 +145,11 @@ NODISCARD render_target instance::create_single_pass_depth_render_target() noexc
     renderpass_info.attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     renderpass_info.attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
+    // depth is cleared every frame and never read afterwards, so it does not have to be written back
     renderpass_info.attachments[1].format = m_swapchain->find_depth_format();
     renderpass_info.attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
     renderpass_info.attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    renderpass_info.attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    renderpass_info.attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     renderpass_info.attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     renderpass_info.attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     renderpass_info.attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -165,6 +195,79 @@ NODISCARD sync instance::create_sync_objects() noexcept
     };
 }
 
+NODISCARD frame_context* instance::begin_frame(render_target& target)
+{
+    return get_frame_manager()->begin_frame(target);
+}
+
+void instance::end_frame()
+{
+    // uploads recorded inside an open upload batch have to reach the queue before the frame using them
+    if (m_upload_manager != nullptr) {
+        m_upload_manager->flush();
+    }
+    m_frame_manager->end_frame();
+}
+
+NODISCARD frame_pipeline instance::create_frame_pipeline(render_target& target, uint32_t queue_depth)
+{
+    return frame_pipeline {
+        make_weakref<window>(m_window),
+        get_frame_manager(),
+        get_upload_manager(),
+        target,
+        queue_depth
+    };
+}
+
+void instance::set_present_mode(VkPresentModeKHR present_mode)
+{
+    m_swapchain->set_present_mode(present_mode);
+}
+
+void instance::set_swapchain_image_count(uint32_t image_count)
+{
+    m_swapchain->set_image_count(image_count);
+}
+
+void instance::set_frame_limit(double fps)
+{
+    get_frame_manager()->get_limiter().set_target_fps(fps);
+}
+
+void instance::set_adaptive_frames_in_flight(bool enabled)
+{
+    get_frame_manager()->set_adaptive_frames_in_flight(enabled);
+}
+
+NODISCARD double instance::get_frame_latency_ms()
+{
+    return get_frame_manager()->get_latency_ms();
+}
+
+NODISCARD frame_stats& instance::get_frame_stats() const noexcept
+{
+    return m_device->get_frame_stats();
+}
+
+NODISCARD VkDescriptorBufferInfo instance::get_upload_descriptor_info(VkDeviceSize range)
+{
+    return get_frame_manager()->get_upload_descriptor_info(range);
+}
+
+NODISCARD weakref<frame_manager> instance::get_frame_manager()
+{
+    if (m_frame_manager == nullptr) {
+        m_frame_manager = std::make_unique<frame_manager>(
+            make_weakref<window>(m_window),
+            make_weakref<device>(m_device),
+            make_weakref<swapchain>(m_swapchain),
+            m_descriptor_allocator.get());
+    }
+
+    return make_weakref<frame_manager>(m_frame_manager);
+}
+
 NODISCARD buffer_handle instance::create_buffer_handle() const noexcept
 {
     return buffer_handle {
@@ -179,6 +282,66 @@ NODISCARD image_handle instance::create_image_handle() const noexcept
     };
 }
 
+NODISCARD geometry_pool instance::create_geometry_pool(uint32_t vertex_stride, VkIndexType index_type, uint32_t max_vertices, uint32_t max_indices)
+{
+    return geometry_pool {
+        make_weakref<device>(m_device),
+        get_upload_manager(),
+        vertex_stride,
+        index_type,
+        max_vertices,
+        max_indices
+    };
+}
+
+NODISCARD transient_attachment_pool instance::create_transient_attachment_pool()
+{
+    return transient_attachment_pool {
+        make_weakref<device>(m_device),
+    };
+}
+
+NODISCARD std::future<bool> instance::screenshot(frame_context* frame, std::string path, readback_file_format format)
+{
+    if (!m_swapchain->get_readback_supported()) {
+        spdlog::error("surface does not support copying out of the swapchain images, no screenshot");
+        std::promise<bool> written {};
+        written.set_value(false);
+        return written.get_future();
+    }
+
+    const VkExtent2D extent = m_swapchain->get_extent();
+    const VkImageSubresourceLayers subresource { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+
+    // the render pass leaves the image ready to present
+    auto result = frame->get_command_list()->readback(m_swapchain->get_images()[frame->get_image_index()], m_swapchain->get_surface_format().format,
+        { extent.width, extent.height, 1 }, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, subresource);
+    return m_device->get_readback_ring().save(std::move(result), std::move(path), format);
+}
+
+bool instance::defragment_step(VkDeviceSize max_bytes_per_pass)
+{
+    if (m_upload_manager != nullptr) {
+        m_upload_manager->flush();
+    }
+    return m_device->defragment_step(max_bytes_per_pass);
+}
+
+NODISCARD defragment_stats instance::get_defragment_stats() const
+{
+    return m_device->get_defragment_stats();
+}
+
+NODISCARD std::string instance::dump_memory_stats(bool detailed) const
+{
+    return m_device->dump_memory_stats(detailed);
+}
+
+NODISCARD memory_delta instance::get_memory_delta()
+{
+    return m_device->get_memory_delta();
+}
+
 void instance::wait_idle()
 {
     m_device->wait_idle();
@@ -219,6 +382,11 @@ NODISCARD descriptor::builder instance::get_descriptor_builder(descriptor::alloc
     return descriptor::builder { m_descriptor_layout_cache.get(), allocator_pool };
 }
 
+NODISCARD VkSampler instance::get_sampler(const VkSamplerCreateInfo& create_info)
+{
+    return m_device->get_sampler_cache().get(create_info);
+}
+
 NODISCARD VkFence instance::create_fence(VkFenceCreateFlags flags)
 {
     VkFence fence = VK_NULL_HANDLE;
@@ -232,6 +400,24 @@ NODISCARD VkFence instance::create_fence(VkFenceCreateFlags flags)
     return fence;
 }
 
+void instance::begin_capture(const char* path)
+{
+    quix_assert(m_recorder == nullptr, "a capture is already running");
+
+    m_recorder = std::make_unique<capture::recorder>(path);
+    m_device->set_recorder(m_recorder.get());
+}
+
+void instance::end_capture()
+{
+    if (m_recorder == nullptr) {
+        return;
+    }
+
+    m_device->set_recorder(nullptr);
+    m_recorder.reset();
+}
+
 NODISCARD weakref<device> instance::get_device() const noexcept
 {
     return weakref<device> { m_device };
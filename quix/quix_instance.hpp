@@ -1,6 +1,7 @@
 #ifndef _QUIX_INSTANCE_HPP
 #define _QUIX_INSTANCE_HPP
 
+#include "quix_readback.hpp"
 #include "quix_resource.hpp"
 namespace quix {
 
@@ -20,8 +21,25 @@ namespace descriptor {
     struct allocator_pool;
 }
 
+namespace capture {
+    class recorder;
+    class player;
+}
+
 class sync;
 class command_pool;
+class frame_context;
+class frame_manager;
+class frame_pipeline;
+class frame_stats;
+class upload_manager;
+class texture_streamer;
+class geometry_pool;
+class transient_attachment_pool;
+struct defragment_stats;
+struct memory_delta;
+struct preload_settings;
+struct preload_result;
 
 class buffer_handle;
 
@@ -42,9 +60,53 @@ public:
     NODISCARD render_target create_single_pass_depth_render_target() noexcept;
     NODISCARD render_target create_render_target(const VkRenderPassCreateInfo&& render_pass_create_info) noexcept;
     NODISCARD sync create_sync_objects() noexcept;
+
+    // acquires the next image and hands out the frame's command list, descriptor pool and upload memory
+    // returns nullptr when the swapchain had to be recreated, skip the frame in that case
+    NODISCARD frame_context* begin_frame(render_target& target);
+    // flushes the upload manager, then submits and presents the frame returned by begin_frame
+    void end_frame();
+
+    // threaded alternative to begin_frame/end_frame, see frame_pipeline. do not mix the two on the same target
+    NODISCARD frame_pipeline create_frame_pipeline(render_target& target, uint32_t queue_depth = 1);
+
+    // frame pacing, all of these can be changed while running. present mode and image count
+    // are applied by recreating the swapchain at the end of the current frame
+    void set_present_mode(VkPresentModeKHR present_mode);
+    // 0 restores the default of minImageCount + 1
+    void set_swapchain_image_count(uint32_t image_count);
+    // 0 disables the limiter
+    void set_frame_limit(double fps);
+    void set_adaptive_frames_in_flight(bool enabled);
+    NODISCARD double get_frame_latency_ms();
+
+    // cpu frame, fence wait, acquire, present and gpu times with p50/p95/p99 over the last frames,
+    // frame_stats::set_dump_interval logs them periodically
+    NODISCARD frame_stats& get_frame_stats() const noexcept;
+
+    // the buffer behind frame_context::allocate_upload for a UNIFORM_BUFFER_DYNAMIC descriptor, see
+    // frame_manager::get_upload_descriptor_info. range is the largest struct read through it
+    NODISCARD VkDescriptorBufferInfo get_upload_descriptor_info(VkDeviceSize range);
     
     NODISCARD buffer_handle create_buffer_handle() const noexcept;
     NODISCARD image_handle create_image_handle() const noexcept;
+    // vertices and indices of many meshes in one vertex and one index buffer, uploads go through get_upload_manager
+    NODISCARD geometry_pool create_geometry_pool(uint32_t vertex_stride, VkIndexType index_type, uint32_t max_vertices, uint32_t max_indices);
+    // intermediate attachments of multi pass frames, aliased by pass range and lazily allocated where supported
+    NODISCARD transient_attachment_pool create_transient_attachment_pool();
+
+    // device::defragment_step after flushing the upload manager, pending uploads still point at the old objects.
+    // call once per frame between frames, movable images have to be in the layout they were made movable with
+    bool defragment_step(VkDeviceSize max_bytes_per_pass = 8ull * 1024 * 1024);
+    NODISCARD defragment_stats get_defragment_stats() const;
+
+    // see device::dump_memory_stats and device::get_memory_delta
+    NODISCARD std::string dump_memory_stats(bool detailed = false) const;
+    NODISCARD memory_delta get_memory_delta();
+
+    // copies the frame's swapchain image out and writes it on a worker thread, call after the last render pass
+    // and before end_frame. the future resolves a couple of frames later, false when the surface does not allow it
+    NODISCARD std::future<bool> screenshot(frame_context* frame, std::string path, readback_file_format format = readback_file_format::png);
 
     void wait_idle();
 
@@ -54,16 +116,29 @@ public:
 
     NODISCARD weakref<graphics::pipeline_manager> get_pipeline_manager() noexcept;
     NODISCARD command_pool get_command_pool();
+    // shared staging ring, created on first use
+    NODISCARD weakref<upload_manager> get_upload_manager();
+    // budgeted mip streaming for textures that do not all fit in vram, created on first use
+    NODISCARD weakref<texture_streamer> get_texture_streamer();
 
     NODISCARD descriptor::allocator_pool get_descriptor_allocator_pool() const noexcept;
     NODISCARD descriptor::builder get_descriptor_builder(descriptor::allocator_pool* allocator_pool) const noexcept;
+    // a shared sampler from the device's sampler cache, also what descriptor::builder::bind_image takes as an immutable sampler
+    NODISCARD VkSampler get_sampler(const VkSamplerCreateInfo& create_info);
 
     NODISCARD VkFence create_fence(VkFenceCreateFlags flags = 0);
 
+    // records the api stream into a binary file, quix_replay plays back its transfer work
+    void begin_capture(const char* path);
+    void end_capture();
+
 private:
     friend class swapchain;
+    friend class capture::player;
+    friend preload_result preload_images(instance* inst, std::span<const std::string> paths, const preload_settings& settings);
 
     NODISCARD weakref<device> get_device() const noexcept;
+    NODISCARD weakref<frame_manager> get_frame_manager();
     void create_pipeline_manager();
 
     static constexpr std::size_t m_buffer_size = 2048;
@@ -76,6 +151,11 @@ private:
     allocated_unique_ptr<graphics::pipeline_manager> m_pipeline_manager;
     allocated_unique_ptr<descriptor::allocator> m_descriptor_allocator;
     allocated_unique_ptr<descriptor::layout_cache> m_descriptor_layout_cache;
+
+    std::unique_ptr<capture::recorder> m_recorder;
+    std::unique_ptr<frame_manager> m_frame_manager;
+    std::unique_ptr<upload_manager> m_upload_manager;
+    std::unique_ptr<texture_streamer> m_texture_streamer;
 };
 
 } // namespace quix
@@ -0,0 +1,61 @@
+#ifndef _QUIX_PACING_CPP
+#define _QUIX_PACING_CPP
+
+#include "quix_pacing.hpp"
+
+namespace quix {
+
+void frame_limiter::set_target_fps(double fps) noexcept
+{
+    m_target_fps = std::max(fps, 0.0);
+    if (m_target_fps > 0.0) {
+        m_interval = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / m_target_fps));
+    } else {
+        m_interval = clock::duration::zero();
+    }
+    m_next_frame = {};
+}
+
+void frame_limiter::wait()
+{
+    if (m_interval == clock::duration::zero()) {
+        return;
+    }
+
+    const auto now = clock::now();
+    if (m_next_frame == clock::time_point {} || now - m_next_frame > m_interval) {
+        // first frame or more than a whole frame late, resync instead of trying to catch up with a burst
+        m_next_frame = now + m_interval;
+        return;
+    }
+
+    sleep_until(m_next_frame);
+    m_next_frame += m_interval;
+}
+
+void frame_limiter::sleep_until(clock::time_point deadline)
+{
+    using seconds = std::chrono::duration<double>;
+
+    // sleep in 1ms steps while the remaining time is safely above what a sleep tends to cost
+    while (seconds(deadline - clock::now()).count() > m_sleep_estimate) {
+        const auto start = clock::now();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        const double observed = seconds(clock::now() - start).count();
+
+        m_sleep_count++;
+        const double delta = observed - m_sleep_mean;
+        m_sleep_mean += delta / static_cast<double>(m_sleep_count);
+        m_sleep_m2 += delta * (observed - m_sleep_mean);
+        m_sleep_estimate = m_sleep_mean + std::sqrt(m_sleep_m2 / static_cast<double>(m_sleep_count - 1));
+    }
+
+    // spin out the remainder
+    while (clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+}
+
+} // namespace quix
+
+#endif // _QUIX_PACING_CPP
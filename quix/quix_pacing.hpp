@@ -0,0 +1,43 @@
+#ifndef _QUIX_PACING_HPP
+#define _QUIX_PACING_HPP
+
+namespace quix {
+
+// caps the frame rate by sleeping for most of the remaining frame time and spinning the rest,
+// os sleeps overshoot by up to a scheduler tick so the sleep margin is learned from how long sleeps actually take
+class frame_limiter {
+public:
+    using clock = std::chrono::steady_clock;
+
+    frame_limiter() = default;
+    ~frame_limiter() = default;
+
+    frame_limiter(const frame_limiter&) = delete;
+    frame_limiter& operator=(const frame_limiter&) = delete;
+    frame_limiter(frame_limiter&&) = delete;
+    frame_limiter& operator=(frame_limiter&&) = delete;
+
+    // 0 disables the limiter
+    void set_target_fps(double fps) noexcept;
+    NODISCARD inline double get_target_fps() const noexcept { return m_target_fps; }
+
+    // blocks until the next frame is due
+    void wait();
+
+private:
+    void sleep_until(clock::time_point deadline);
+
+    double m_target_fps = 0.0;
+    clock::duration m_interval {};
+    clock::time_point m_next_frame {};
+
+    // running mean and variance of how long a 1ms sleep really takes, in seconds
+    double m_sleep_estimate = 5e-3;
+    double m_sleep_mean = 5e-3;
+    double m_sleep_m2 = 0.0;
+    uint64_t m_sleep_count = 1;
+};
+
+} // namespace quix
+
+#endif // _QUIX_PACING_HPP
@@ -5,6 +5,8 @@
 
 #include <utility>
 
+#include "quix_archive.hpp"
+#include "quix_capture.hpp"
 #include "quix_device.hpp"
 #include "quix_instance.hpp"
 #include "quix_render_target.hpp"
@@ -53,8 +55,7 @@ namespace graphics {
         // return pipeline { m_device, m_render_target, &m_layout_info, &pipeline_create_info };
     }
 
-    VkPipelineShaderStageCreateInfo pipeline_builder::create_shader_stage(
-        const char* file_path, const VkShaderStageFlagBits shader_stage)
+    static EShLanguage to_esh_language(const VkShaderStageFlagBits shader_stage)
     {
         EShLanguage EShStage {};
         switch (shader_stage) {
@@ -79,10 +80,11 @@ namespace graphics {
         default:
             quix_error("invalid shader stage");
         }
+        return EShStage;
+    }
 
-        shader shader_obj(file_path, EShStage);
-        VkShaderModule shader_module = shader_obj.createShaderModule(m_device->get_logical_device());
-
+    static VkPipelineShaderStageCreateInfo to_stage_info(VkShaderModule shader_module, const VkShaderStageFlagBits shader_stage)
+    {
         return VkPipelineShaderStageCreateInfo {
             .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
             .pNext = nullptr,
@@ -94,6 +96,20 @@ namespace graphics {
         };
     }
 
+    VkPipelineShaderStageCreateInfo pipeline_builder::create_shader_stage(
+        const char* file_path, const VkShaderStageFlagBits shader_stage)
+    {
+        shader shader_obj(file_path, to_esh_language(shader_stage));
+        return to_stage_info(shader_obj.createShaderModule(m_device->get_logical_device()), shader_stage);
+    }
+
+    VkPipelineShaderStageCreateInfo pipeline_builder::create_shader_stage(
+        const asset_archive& archive, const char* name, const VkShaderStageFlagBits shader_stage)
+    {
+        shader shader_obj(archive, name, to_esh_language(shader_stage));
+        return to_stage_info(shader_obj.createShaderModule(m_device->get_logical_device()), shader_stage);
+    }
+
     // pipeline_builder end
 
     // pipeline class
@@ -107,6 +123,11 @@ namespace graphics {
     {
         create_pipeline_layout(pipeline_layout_info);
         create_pipeline(pipeline_create_info);
+
+        if (auto* recorder = m_device->get_recorder()) {
+            recorder->record_create_pipeline(pipeline_create_info, pipeline_layout_info);
+        }
+
         for (uint32_t i = 0; i < pipeline_create_info->stageCount; i++) {
             vkDestroyShaderModule(m_device->get_logical_device(), pipeline_create_info->pStages[i].module, nullptr);
         }
@@ -5,6 +5,7 @@ namespace quix {
 
 class device;
 class render_target;
+class asset_archive;
 
 namespace graphics {
     class pipeline_manager;
@@ -46,6 +47,8 @@ namespace graphics {
 
         NODISCARD VkPipelineShaderStageCreateInfo create_shader_stage(
             const char* file_path, const VkShaderStageFlagBits shader_stage);
+        NODISCARD VkPipelineShaderStageCreateInfo create_shader_stage(
+            const asset_archive& archive, const char* name, const VkShaderStageFlagBits shader_stage);
 
         NODISCARD std::shared_ptr<pipeline> create_graphics_pipeline();
 
@@ -0,0 +1,228 @@
+#ifndef _QUIX_PRELOAD_CPP
+#define _QUIX_PRELOAD_CPP
+
+#include "quix_preload.hpp"
+
+#include "quix_device.hpp"
+#include "quix_instance.hpp"
+#include "quix_texture_container.hpp"
+#include "quix_upload.hpp"
+
+namespace quix {
+
+// where a decoded texture goes in the staging buffers of its wave
+struct preload_source {
+    uint32_t width {};
+    uint32_t height {};
+    VkDeviceSize size {};
+    std::size_t block {};
+    VkDeviceSize offset {};
+};
+
+// runs function for every index below count on up to threads threads, the calling one included
+template <typename Function>
+static void run_parallel(std::size_t count, uint32_t threads, const Function& function)
+{
+    std::atomic<std::size_t> next = 0;
+    auto work = [&]() {
+        for (auto index = next.fetch_add(1, std::memory_order_relaxed); index < count; index = next.fetch_add(1, std::memory_order_relaxed)) {
+            function(index);
+        }
+    };
+
+    std::vector<std::thread> workers {};
+    for (std::size_t i = 1; i < std::min<std::size_t>(threads, count); i++) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+NODISCARD preload_result preload_images(instance* inst, std::span<const std::string> paths, const preload_settings& settings)
+{
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+
+    auto p_device = inst->get_device();
+    auto uploader = inst->get_upload_manager();
+    const uint32_t threads = settings.threads != 0 ? settings.threads : std::max(std::thread::hardware_concurrency(), 1u);
+
+    preload_result result {};
+    result.images.reserve(paths.size());
+    for (std::size_t i = 0; i < paths.size(); i++) {
+        result.images.emplace_back(p_device);
+    }
+
+    std::vector<std::size_t> decoded {};
+    std::vector<std::size_t> containers {};
+    for (std::size_t i = 0; i < paths.size(); i++) {
+        (is_texture_container(paths[i].c_str()) ? containers : decoded).push_back(i);
+    }
+
+    // the headers place every texture in staging memory before anything is decoded
+    std::vector<preload_source> sources(paths.size());
+    run_parallel(decoded.size(), threads, [&](std::size_t index) {
+        const std::size_t i = decoded[index];
+        int width {};
+        int height {};
+        int channels {};
+        quix_assert(stbi_info(paths[i].c_str(), &width, &height, &channels) == 1, fmt::format("failed to read the header of {}", paths[i]));
+
+        auto& source = sources[i];
+        source.width = static_cast<uint32_t>(width);
+        source.height = static_cast<uint32_t>(height);
+        source.size = static_cast<VkDeviceSize>(source.width) * source.height * 4;
+    });
+
+    bool mips_supported = false;
+    if (settings.generate_mips) {
+        VkFormatProperties format_properties {};
+        vkGetPhysicalDeviceFormatProperties(p_device->get_physical_device(), VK_FORMAT_R8G8B8A8_SRGB, &format_properties);
+
+        constexpr VkFormatFeatureFlags blit_features = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+        mips_supported = (format_properties.optimalTilingFeatures & blit_features) == blit_features;
+        if (!mips_supported) {
+            spdlog::warn("format can not be blitted with linear filtering, textures are preloaded without mips");
+        }
+    }
+
+    std::chrono::duration<double> decode_time {};
+    std::chrono::duration<double> upload_time {};
+    std::vector<upload_ticket> tickets {};
+
+    for (std::size_t first = 0; first < decoded.size();) {
+        // a wave takes textures until max_staging_size is used up, but always at least one
+        std::size_t last = first;
+        VkDeviceSize wave_size {};
+        std::vector<VkDeviceSize> block_sizes {};
+        for (; last < decoded.size(); last++) {
+            auto& source = sources[decoded[last]];
+            if (last > first && wave_size + source.size > settings.max_staging_size) {
+                break;
+            }
+            wave_size += source.size;
+
+            // every texture is rgba8, so the offsets stay multiples of the texel size the copies need
+            if (block_sizes.empty() || block_sizes.back() + source.size > settings.staging_block_size) {
+                block_sizes.push_back(0);
+            }
+            source.block = block_sizes.size() - 1;
+            source.offset = block_sizes.back();
+            block_sizes.back() += source.size;
+        }
+
+        // only the previous wave may still be copying, which bounds staging memory at twice max_staging_size
+        if (tickets.size() >= 2) {
+            const auto wait_start = clock::now();
+            uploader->wait(tickets[tickets.size() - 2]);
+            upload_time += clock::now() - wait_start;
+        }
+
+        std::vector<std::unique_ptr<buffer_handle>> staging {};
+        for (VkDeviceSize size : block_sizes) {
+            staging.push_back(std::make_unique<buffer_handle>(p_device));
+            staging.back()->create_staging_buffer(size);
+        }
+
+        // the images are created on this thread so a capture sees them in path order
+        for (std::size_t index = first; index < last; index++) {
+            const std::size_t i = decoded[index];
+            const auto& source = sources[i];
+
+            VkImageCreateInfo image_info {};
+            image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            image_info.imageType = VK_IMAGE_TYPE_2D;
+            image_info.extent = { source.width, source.height, 1 };
+            image_info.mipLevels = mips_supported ? static_cast<uint32_t>(std::floor(std::log2(std::max(source.width, source.height)))) + 1 : 1;
+            image_info.arrayLayers = 1;
+            image_info.format = VK_FORMAT_R8G8B8A8_SRGB;
+            image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+            image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            image_info.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+            image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+            image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+            VmaAllocationCreateInfo alloc_info {};
+            alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+            alloc_info.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+            result.images[i].set_tag(paths[i]);
+            result.images[i].create_image(&image_info, &alloc_info);
+        }
+
+        const auto decode_start = clock::now();
+        run_parallel(last - first, threads, [&](std::size_t index) {
+            const std::size_t i = decoded[first + index];
+            const auto& source = sources[i];
+
+            int width {};
+            int height {};
+            int channels {};
+            stbi_uc* pixels = stbi_load(paths[i].c_str(), &width, &height, &channels, STBI_rgb_alpha);
+            quix_assert(pixels != nullptr, fmt::format("failed to load {}", paths[i]));
+            quix_assert(static_cast<uint32_t>(width) == source.width && static_cast<uint32_t>(height) == source.height, fmt::format("{} changed while loading", paths[i]));
+
+            std::memcpy(static_cast<char*>(staging[source.block]->get_mapped_data()) + source.offset, pixels, source.size);
+            stbi_image_free(pixels);
+        });
+        decode_time += clock::now() - decode_start;
+
+        const auto upload_start = clock::now();
+        std::vector<std::vector<staged_image_copy>> copies(block_sizes.size());
+        for (std::size_t index = first; index < last; index++) {
+            const std::size_t i = decoded[index];
+            const auto& source = sources[i];
+
+            VkBufferImageCopy region {};
+            region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+            region.imageExtent = { source.width, source.height, 1 };
+
+            copies[source.block].push_back({ &result.images[i], source.offset, source.size, { region }, result.images[i].get_mip_levels() > 1 });
+            result.stats.bytes += source.size;
+        }
+        for (std::size_t block = 0; block < staging.size(); block++) {
+            uploader->upload_staged(std::move(staging[block]), copies[block]);
+        }
+        tickets.push_back(uploader->flush());
+        upload_time += clock::now() - upload_start;
+
+        first = last;
+    }
+
+    // the containers go out in one more batch
+    if (!containers.empty()) {
+        uploader->begin_batch();
+        for (std::size_t i : containers) {
+            result.images[i].create_image_from_container(paths[i].c_str(), inst);
+        }
+        tickets.push_back(uploader->end_batch());
+    }
+
+    if (!tickets.empty()) {
+        const auto wait_start = clock::now();
+        uploader->wait(tickets.back());
+        upload_time += clock::now() - wait_start;
+    }
+
+    const std::chrono::duration<double> total_time = clock::now() - start;
+
+    auto& stats = result.stats;
+    stats.textures = static_cast<uint32_t>(paths.size());
+    stats.batches = static_cast<uint32_t>(tickets.size());
+    stats.decode_seconds = decode_time.count();
+    stats.upload_seconds = upload_time.count();
+    stats.total_seconds = total_time.count();
+    stats.megabytes_per_second = stats.total_seconds > 0.0 ? static_cast<double>(stats.bytes) / (1024.0 * 1024.0) / stats.total_seconds : 0.0;
+
+    spdlog::info("preloaded {} textures, {:.1f} MB in {:.3f}s ({:.3f}s decoding on {} threads, {:.3f}s uploading in {} batches), {:.1f} MB/s",
+        stats.textures, static_cast<double>(stats.bytes) / (1024.0 * 1024.0), stats.total_seconds, stats.decode_seconds, threads,
+        stats.upload_seconds, stats.batches, stats.megabytes_per_second);
+
+    return result;
+}
+
+} // namespace quix
+
+#endif // _QUIX_PRELOAD_CPP
@@ -0,0 +1,49 @@
+#ifndef _QUIX_PRELOAD_HPP
+#define _QUIX_PRELOAD_HPP
+
+#include "quix_resource.hpp"
+
+namespace quix {
+
+class instance;
+
+struct preload_settings {
+    // decoding threads, the calling thread included. 0 takes every core
+    uint32_t threads = 0;
+    // decoded textures are packed into staging buffers of about this size, larger textures get one of their own
+    VkDeviceSize staging_block_size = 64ull * 1024 * 1024;
+    // staging memory per wave. a wave of textures that fills it is submitted and the next one decodes while it
+    // copies, so at most twice this is alive instead of host memory for every texture at the same time
+    VkDeviceSize max_staging_size = 512ull * 1024 * 1024;
+    // builds the full mip chain on the gpu like create_image_from_file does
+    bool generate_mips = false;
+};
+
+struct preload_stats {
+    uint32_t textures {};
+    // submissions made, one per wave of max_staging_size
+    uint32_t batches {};
+    // decoded texels uploaded, mips not included
+    VkDeviceSize bytes {};
+    // time spent decoding into staging memory, and recording, submitting and waiting for the copies
+    double decode_seconds {};
+    double upload_seconds {};
+    double total_seconds {};
+    double megabytes_per_second {};
+};
+
+struct preload_result {
+    // in the order of the paths, tagged with them
+    std::vector<image_handle> images {};
+    preload_stats stats {};
+};
+
+// loads many textures at once for startup. the headers are read and the files are decoded with stb_image on
+// worker threads straight into a few large staging buffers, and every texture of a wave goes to the gpu in one
+// upload_manager batch. returns once the images can be sampled.
+// .ktx2 and .dds paths are loaded through create_image_from_container after the rest, in one more batch
+NODISCARD preload_result preload_images(instance* inst, std::span<const std::string> paths, const preload_settings& settings = {});
+
+} // namespace quix
+
+#endif // _QUIX_PRELOAD_HPP
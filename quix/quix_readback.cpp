@@ -0,0 +1,368 @@
+#ifndef _QUIX_READBACK_CPP
+#define _QUIX_READBACK_CPP
+
+#include "quix_readback.hpp"
+
+#include "quix_commands.hpp"
+#include "quix_device.hpp"
+#include "quix_texture_container.hpp"
+#include <numeric>
+
+namespace quix {
+
+readback_ring::readback_ring(device* p_device, VkDeviceSize ring_size)
+    : m_device(p_device)
+    , m_size(ring_size)
+{
+    quix_assert(ring_size > 0, "readback ring needs a size");
+
+    VkBufferCreateInfo buffer_info {};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = ring_size;
+    buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    // random access picks host cached memory, reading write combined memory back is very slow
+    VmaAllocationCreateInfo alloc_info {};
+    alloc_info.usage = VMA_MEMORY_USAGE_AUTO;
+    alloc_info.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    VmaAllocationInfo info {};
+    VK_CHECK(vmaCreateBuffer(m_device->get_allocator(), &buffer_info, &alloc_info, &m_buffer, &m_alloc, &info), "failed to create readback ring");
+    m_mapped_data = info.pMappedData;
+
+    m_worker = std::thread(&readback_ring::worker_loop, this);
+}
+
+readback_ring::~readback_ring()
+{
+    // the device retires every frame before the ring goes away, so the queued saves can all finish
+    {
+        std::lock_guard<std::mutex> lock(m_save_mutex);
+        m_closing = true;
+    }
+    m_save_ready.notify_one();
+    if (m_worker.joinable()) {
+        m_worker.join();
+    }
+
+    vmaDestroyBuffer(m_device->get_allocator(), m_buffer, m_alloc);
+}
+
+NODISCARD std::future<readback_result> readback_ring::readback_buffer(command_list* commands, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size)
+{
+    quix_assert(size > 0, "readback of an empty buffer range");
+
+    const auto destination = allocate(size, 4);
+
+    VkBufferCopy region {};
+    region.srcOffset = offset;
+    region.dstOffset = destination.offset;
+    region.size = size;
+    vkCmdCopyBuffer(commands->get_cmd_buffer(), buffer, destination.buffer, 1, &region);
+
+    VkBufferMemoryBarrier barrier {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = destination.buffer;
+    barrier.offset = destination.offset;
+    barrier.size = size;
+    vkCmdPipelineBarrier(commands->get_cmd_buffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+    return resolve(destination, size, {});
+}
+
+NODISCARD std::future<readback_result> readback_ring::readback_image(command_list* commands, VkImage image, VkFormat format, VkExtent3D extent,
+    VkImageLayout current_layout, const VkImageSubresourceLayers& subresource)
+{
+    quix_assert(current_layout != VK_IMAGE_LAYOUT_UNDEFINED, "readback of an image without contents");
+
+    const auto block = get_format_block(format);
+    quix_assert(block.has_value(), "readback of an image format with an unknown layout");
+
+    const VkExtent3D mip_extent {
+        std::max(extent.width >> subresource.mipLevel, 1u),
+        std::max(extent.height >> subresource.mipLevel, 1u),
+        std::max(extent.depth >> subresource.mipLevel, 1u)
+    };
+    const VkDeviceSize size = get_mip_size(*block, mip_extent.width, mip_extent.height, mip_extent.depth) * subresource.layerCount;
+
+    // image copies need the buffer offset aligned to both the texel block and 4 bytes
+    const auto destination = allocate(size, std::lcm<VkDeviceSize, VkDeviceSize>(block->bytes, 4));
+
+    const VkImageSubresourceRange range { subresource.aspectMask, subresource.mipLevel, 1, subresource.baseArrayLayer, subresource.layerCount };
+
+    VkImageMemoryBarrier to_transfer {};
+    to_transfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    to_transfer.oldLayout = current_layout;
+    to_transfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    to_transfer.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+    to_transfer.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    to_transfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    to_transfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    to_transfer.image = image;
+    to_transfer.subresourceRange = range;
+    vkCmdPipelineBarrier(commands->get_cmd_buffer(), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &to_transfer);
+
+    VkBufferImageCopy region {};
+    region.bufferOffset = destination.offset;
+    region.imageSubresource = subresource;
+    region.imageExtent = mip_extent;
+    vkCmdCopyImageToBuffer(commands->get_cmd_buffer(), image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, destination.buffer, 1, &region);
+
+    // the copy only read the image, later work just has to wait for it to finish
+    VkImageMemoryBarrier to_current = to_transfer;
+    to_current.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    to_current.newLayout = current_layout;
+    to_current.srcAccessMask = 0;
+    to_current.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+    VkBufferMemoryBarrier to_host {};
+    to_host.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    to_host.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    to_host.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    to_host.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    to_host.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    to_host.buffer = destination.buffer;
+    to_host.offset = destination.offset;
+    to_host.size = size;
+
+    vkCmdPipelineBarrier(commands->get_cmd_buffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &to_current);
+    vkCmdPipelineBarrier(commands->get_cmd_buffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &to_host, 0, nullptr);
+
+    readback_result metadata {};
+    metadata.format = format;
+    metadata.extent = mip_extent;
+    metadata.layers = subresource.layerCount;
+    return resolve(destination, size, std::move(metadata));
+}
+
+NODISCARD std::future<bool> readback_ring::save(std::future<readback_result>&& result, std::string path, readback_file_format format)
+{
+    save_job job {};
+    job.result = std::move(result);
+    job.path = std::move(path);
+    job.format = format;
+    auto written = job.written.get_future();
+
+    {
+        std::lock_guard<std::mutex> lock(m_save_mutex);
+        m_saves.push_back(std::move(job));
+    }
+    // the result may already be resolved
+    m_save_ready.notify_one();
+    return written;
+}
+
+void readback_ring::flush()
+{
+    {
+        auto lock = m_device->lock_queue(m_device->get_graphics_queue());
+        VK_CHECK(vkQueueWaitIdle(m_device->get_graphics_queue()), "failed to wait for the graphics queue");
+    }
+
+    std::deque<std::shared_ptr<pending_resolve>> resolves {};
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        resolves.swap(m_resolves);
+    }
+    // the deferred destruction of the frames still runs them later, but only the first run resolves
+    for (const auto& pending : resolves) {
+        pending->run();
+    }
+}
+
+NODISCARD readback_ring::target readback_ring::allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+    if (size <= m_size) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // ranges are retired in frame order, the first one still in flight ends the scan
+        while (!m_pending.empty() && m_pending.front().done->load(std::memory_order_acquire)) {
+            m_tail = m_pending.front().end;
+            m_pending.pop_front();
+        }
+
+        uint64_t start = m_head - m_head % m_size + (m_head % m_size + alignment - 1) / alignment * alignment;
+        if (start % m_size + size > m_size || start % m_size < m_head % m_size) {
+            // no room before the end of the ring, wrap around
+            start = (m_head / m_size + 1) * m_size;
+        }
+
+        if (start + size - m_tail <= m_size) {
+            auto done = std::make_shared<std::atomic<bool>>(false);
+            m_pending.push_back({ start + size, done });
+            m_head = start + size;
+            return { m_buffer, m_alloc, start % m_size, m_mapped_data, std::move(done) };
+        }
+    }
+
+    // the ring is full or too small, never wait for the gpu to drain it
+    VkBufferCreateInfo buffer_info {};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = size;
+    buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VmaAllocationCreateInfo alloc_info {};
+    alloc_info.usage = VMA_MEMORY_USAGE_AUTO;
+    alloc_info.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    target dedicated {};
+    VmaAllocationInfo info {};
+    VK_CHECK(vmaCreateBuffer(m_device->get_allocator(), &buffer_info, &alloc_info, &dedicated.buffer, &dedicated.alloc, &info), "failed to create readback buffer");
+    dedicated.mapped_data = info.pMappedData;
+    return dedicated;
+}
+
+NODISCARD std::future<readback_result> readback_ring::resolve(const target& destination, VkDeviceSize size, readback_result&& metadata)
+{
+    auto promise = std::make_shared<std::promise<readback_result>>();
+    auto result = promise->get_future();
+
+    auto pending = std::make_shared<pending_resolve>();
+    pending->resolve = [this, allocator = m_device->get_allocator(), destination, size, promise, metadata = std::move(metadata)]() mutable {
+        VK_CHECK(vmaInvalidateAllocation(allocator, destination.alloc, destination.offset, size), "failed to invalidate readback memory");
+
+        const auto* bytes = static_cast<const uint8_t*>(destination.mapped_data) + destination.offset;
+        metadata.data.assign(bytes, bytes + size);
+
+        if (destination.done != nullptr) {
+            destination.done->store(true, std::memory_order_release);
+        } else {
+            vmaDestroyBuffer(allocator, destination.buffer, destination.alloc);
+        }
+
+        promise->set_value(std::move(metadata));
+
+        // the save waiting on this result can be written now
+        {
+            std::lock_guard<std::mutex> lock(m_save_mutex);
+        }
+        m_save_ready.notify_one();
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        while (!m_resolves.empty() && m_resolves.front()->resolved.load(std::memory_order_acquire)) {
+            m_resolves.pop_front();
+        }
+        m_resolves.push_back(pending);
+    }
+    m_device->defer_destroy([pending]() { pending->run(); });
+
+    return result;
+}
+
+NODISCARD std::vector<readback_ring::save_job> readback_ring::take_ready_saves()
+{
+    std::vector<save_job> ready {};
+    for (auto it = m_saves.begin(); it != m_saves.end();) {
+        if (it->result.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            ready.push_back(std::move(*it));
+            it = m_saves.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return ready;
+}
+
+void readback_ring::worker_loop()
+{
+    std::unique_lock<std::mutex> lock(m_save_mutex);
+    while (true) {
+        std::vector<save_job> ready {};
+        m_save_ready.wait(lock, [&]() {
+            ready = take_ready_saves();
+            return !ready.empty() || m_closing;
+        });
+
+        if (ready.empty()) {
+            // closing, whatever is left was never recorded through this ring and can not resolve anymore
+            for (auto& job : m_saves) {
+                spdlog::error("readback for {} never resolved, dropped save", job.path);
+                job.written.set_value(false);
+            }
+            m_saves.clear();
+            return;
+        }
+
+        // the files are written without the lock, save never waits on the worker
+        lock.unlock();
+        for (auto& job : ready) {
+            job.written.set_value(write_file(job.result.get(), job.path, job.format));
+        }
+        lock.lock();
+    }
+}
+
+NODISCARD bool readback_ring::write_file(const readback_result& result, const std::string& path, readback_file_format format)
+{
+    if (format == readback_file_format::raw) {
+        FILE* handle = fopen(path.c_str(), "wb");
+        if (handle == nullptr) {
+            spdlog::error("failed to open {} for writing", path);
+            return false;
+        }
+
+        const bool written = fwrite(result.data.data(), 1, result.data.size(), handle) == result.data.size();
+        fclose(handle);
+        if (!written) {
+            spdlog::error("failed to write {}", path);
+        }
+        return written;
+    }
+
+    int components = 0;
+    bool swizzle = false;
+    switch (result.format) {
+        case VK_FORMAT_R8_UNORM:
+        case VK_FORMAT_R8_SRGB:
+            components = 1;
+            break;
+        case VK_FORMAT_R8G8_UNORM:
+        case VK_FORMAT_R8G8_SRGB:
+            components = 2;
+            break;
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+            components = 4;
+            break;
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+            components = 4;
+            swizzle = true;
+            break;
+        default:
+            spdlog::error("can not write format {} to a png, save {} as raw instead", static_cast<int>(result.format), path);
+            return false;
+    }
+
+    const uint32_t width = result.extent.width;
+    const uint32_t height = result.extent.height * result.extent.depth * result.layers;
+    quix_assert(result.data.size() == static_cast<std::size_t>(width) * height * components, "readback size does not match its extent");
+
+    const uint8_t* pixels = result.data.data();
+    std::vector<uint8_t> rgba {};
+    if (swizzle) {
+        rgba = result.data;
+        for (std::size_t i = 0; i < rgba.size(); i += 4) {
+            std::swap(rgba[i], rgba[i + 2]);
+        }
+        pixels = rgba.data();
+    }
+
+    if (stbi_write_png(path.c_str(), static_cast<int>(width), static_cast<int>(height), components, pixels, static_cast<int>(width) * components) == 0) {
+        spdlog::error("failed to write {}", path);
+        return false;
+    }
+    return true;
+}
+
+} // namespace quix
+
+#endif // _QUIX_READBACK_CPP
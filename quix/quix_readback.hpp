@@ -0,0 +1,123 @@
+#ifndef _QUIX_READBACK_HPP
+#define _QUIX_READBACK_HPP
+
+namespace quix {
+
+class device;
+class command_list;
+
+// what a readback copied out, images are tightly packed mip rows with the layers one after the other
+struct readback_result {
+    std::vector<uint8_t> data {};
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    VkExtent3D extent {};
+    uint32_t layers {};
+};
+
+enum class readback_file_format {
+    // 8 bit r, rg, rgba and bgra images only, layers and depth slices are stacked vertically
+    png,
+    // the bytes as they came off the gpu
+    raw
+};
+
+// copies gpu buffers and images into a ring of host cached memory without waiting on the queue. a readback
+// recorded into a frame's command list resolves when the device retires that frame, which is a couple of
+// frames later, so never wait on it before the next frames were submitted. headless command lists that are
+// submitted outside of frame_manager resolve through flush instead.
+// requests that do not fit in the ring get a dedicated buffer instead of stalling
+class readback_ring {
+public:
+    explicit readback_ring(device* p_device, VkDeviceSize ring_size = 32ull * 1024 * 1024);
+    ~readback_ring();
+
+    readback_ring(const readback_ring&) = delete;
+    readback_ring& operator=(const readback_ring&) = delete;
+    readback_ring(readback_ring&&) = delete;
+    readback_ring& operator=(readback_ring&&) = delete;
+
+    // the buffer needs VK_BUFFER_USAGE_TRANSFER_SRC_BIT and its writes have to be made visible to transfers
+    NODISCARD std::future<readback_result> readback_buffer(command_list* commands, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size);
+    // one mip of the given layers, the image needs VK_IMAGE_USAGE_TRANSFER_SRC_BIT and goes back to current_layout afterwards
+    NODISCARD std::future<readback_result> readback_image(command_list* commands, VkImage image, VkFormat format, VkExtent3D extent,
+        VkImageLayout current_layout, const VkImageSubresourceLayers& subresource);
+
+    // never blocks, the ring's worker thread writes the file once the result resolves and the future tells if it was written
+    NODISCARD std::future<bool> save(std::future<readback_result>&& result, std::string path, readback_file_format format = readback_file_format::png);
+
+    // waits for the graphics queue to go idle and resolves every readback recorded so far. for headless use, call it
+    // after submitting the command lists holding the readbacks and never while a frame is being recorded
+    void flush();
+
+    NODISCARD inline VkDeviceSize get_ring_size() const noexcept { return m_size; }
+
+private:
+    struct pending_range {
+        uint64_t end {};
+        std::shared_ptr<std::atomic<bool>> done {};
+    };
+
+    // runs from the frame's deferred destruction or from flush, whichever comes first
+    struct pending_resolve {
+        std::atomic<bool> resolved = false;
+        std::function<void()> resolve {};
+
+        void run()
+        {
+            if (!resolved.exchange(true, std::memory_order_acq_rel)) {
+                resolve();
+            }
+        }
+    };
+
+    struct save_job {
+        std::future<readback_result> result {};
+        std::string path {};
+        readback_file_format format {};
+        std::promise<bool> written {};
+    };
+
+    struct target {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VmaAllocation alloc {};
+        VkDeviceSize offset {};
+        void* mapped_data = nullptr;
+        // null for a dedicated buffer
+        std::shared_ptr<std::atomic<bool>> done {};
+    };
+
+    // a range of the ring or a dedicated buffer when the ring is full
+    NODISCARD target allocate(VkDeviceSize size, VkDeviceSize alignment);
+    // resolves the future once the frame recording the copy is retired
+    NODISCARD std::future<readback_result> resolve(const target& destination, VkDeviceSize size, readback_result&& metadata);
+
+    // the futures of the saves that resolved, without blocking on the others
+    NODISCARD std::vector<save_job> take_ready_saves();
+    void worker_loop();
+    NODISCARD static bool write_file(const readback_result& result, const std::string& path, readback_file_format format);
+
+    device* m_device;
+
+    VkBuffer m_buffer = VK_NULL_HANDLE;
+    VmaAllocation m_alloc {};
+    void* m_mapped_data = nullptr;
+    VkDeviceSize m_size {};
+
+    // monotonic byte positions, head - tail is what is in flight
+    std::mutex m_mutex {};
+    uint64_t m_head {};
+    uint64_t m_tail {};
+    std::deque<pending_range> m_pending {};
+    std::deque<std::shared_ptr<pending_resolve>> m_resolves {};
+
+    // every resolve wakes the worker, which only ever takes saves whose result is ready
+    std::mutex m_save_mutex {};
+    std::condition_variable m_save_ready {};
+    std::vector<save_job> m_saves {};
+    bool m_closing = false;
+    std::thread m_worker {};
+};
+
+} // namespace quix
+
+#endif // _QUIX_READBACK_HPP
@@ -65,23 +65,42 @@ NODISCARD VkExtent2D render_target::get_extent() const noexcept
 
 void render_target::recreate_swapchain()
 {
-    auto* window = m_window->get_window();
     int width = 0;
     int height = 0;
-    while (width == 0 && height == 0) {
-        glfwGetFramebufferSize(window, &width, &height);
-        glfwWaitEvents();
+    glfwGetFramebufferSize(m_window->get_window(), &width, &height);
+    if (width == 0 || height == 0) {
+        // minimized, there is nothing to present to. wait a little for events instead of
+        // blocking here until the window comes back, the caller just skips the frame
+        window::wait_events_timeout(0.05);
+        return;
     }
 
-    m_device->wait_idle();
+    m_resize_pending = false;
 
     m_swapchain->recreate_swapchain();
 
-    destroy_framebuffers();
+    retire_framebuffers();
 
     create_framebuffers();
 }
 
+void render_target::notify_resized() noexcept
+{
+    m_resize_pending = true;
+    m_last_resize = std::chrono::steady_clock::now();
+}
+
+void render_target::notify_suboptimal() noexcept
+{
+    // every present stays suboptimal until the recreate, restarting the timer here would never let it settle
+    m_resize_pending = true;
+}
+
+NODISCARD bool render_target::get_resize_settled() const noexcept
+{
+    return m_resize_pending && std::chrono::steady_clock::now() - m_last_resize >= resize_debounce;
+}
+
 void render_target::create_renderpass(const VkRenderPassCreateInfo* renderpass_info)
 {
     VK_CHECK(vkCreateRenderPass(m_device->get_logical_device(), renderpass_info, nullptr, &m_render_pass), "failed to create renderpass");
@@ -125,6 +144,16 @@ void render_target::destroy_framebuffers()
     }
 }
 
+void render_target::retire_framebuffers()
+{
+    m_device->defer_destroy([logical_device = m_device->get_logical_device(), framebuffers = std::move(m_framebuffers)]() {
+        for (auto* framebuffer : framebuffers) {
+            vkDestroyFramebuffer(logical_device, framebuffer, nullptr);
+        }
+    });
+    m_framebuffers.clear();
+}
+
 } // namespace quix
 
 #endif // _QUIX_RENDER_TARGET_CPP
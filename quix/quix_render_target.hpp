@@ -43,12 +43,24 @@ public:
     NODISCARD inline VkFramebuffer get_framebuffer(uint32_t index) const noexcept { return m_framebuffers[index]; }
     NODISCARD VkExtent2D get_extent() const noexcept;
 
+    // recreates right away without waiting on the device, the old swapchain and framebuffers are
+    // retired through device::defer_destroy. does nothing while the window is minimized
     void recreate_swapchain();
 
+    // resize storms are debounced, the old swapchain keeps being used until the size
+    // has stopped changing for resize_debounce. only real window resizes restart the debounce,
+    // a suboptimal present recreates once no resize arrived for resize_debounce
+    void notify_resized() noexcept;
+    void notify_suboptimal() noexcept;
+    NODISCARD bool get_resize_settled() const noexcept;
+
+    static constexpr std::chrono::milliseconds resize_debounce { 100 };
+
 private:
     void create_renderpass(const VkRenderPassCreateInfo* renderpass_info);
     void create_framebuffers();
     void destroy_framebuffers();
+    void retire_framebuffers();
 
     weakref<window> m_window;
     weakref<device> m_device;
@@ -56,6 +68,10 @@ private:
 
     std::vector<VkFramebuffer> m_framebuffers;
     VkRenderPass m_render_pass = VK_NULL_HANDLE;
+
+    bool m_resize_pending = false;
+    // the last window resize event, suboptimal presents leave it alone
+    std::chrono::steady_clock::time_point m_last_resize {};
 };
 
 } // namespace quix
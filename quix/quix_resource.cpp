@@ -3,30 +3,123 @@
 
 #include "quix_resource.hpp"
 
+#include "quix_archive.hpp"
+#include "quix_capture.hpp"
 #include "quix_commands.hpp"
 #include "quix_device.hpp"
 #include "quix_instance.hpp"
+#include "quix_sampler_cache.hpp"
+#include "quix_texture_encoder.hpp"
+#include "quix_upload.hpp"
 #include <vulkan/vulkan_core.h>
 
 namespace quix {
 
+// the loaders submit their upload right away, unless the caller batches a whole level load
+static void flush_unless_batching(upload_manager& uploader)
+{
+    if (!uploader.is_batching()) {
+        uploader.flush();
+    }
+}
+
+NODISCARD VkImageAspectFlags get_format_aspect(VkFormat format) noexcept
+{
+    switch (format) {
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_X8_D24_UNORM_PACK32:
+    case VK_FORMAT_D32_SFLOAT:
+        return VK_IMAGE_ASPECT_DEPTH_BIT;
+    case VK_FORMAT_S8_UINT:
+        return VK_IMAGE_ASPECT_STENCIL_BIT;
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+        return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    default:
+        return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+
 buffer_handle::buffer_handle(weakref<device> p_device)
     : m_device(std::move(p_device))
+    , m_slot(std::make_unique<resource_slot>())
 {
 }
 
 buffer_handle::~buffer_handle()
 {
-    if (m_buffer != VK_NULL_HANDLE) {
-        vmaDestroyBuffer(m_device->get_allocator(), m_buffer, m_alloc);
+    if (m_slot == nullptr) {
+        return;
+    }
+
+    if (m_slot->buffer != VK_NULL_HANDLE) {
+        destroy_buffer();
     } else {
         spdlog::warn("buffer was never created");
     }
 }
 
+buffer_handle& buffer_handle::operator=(buffer_handle&& other) noexcept
+{
+    if (this == &other) {
+        return *this;
+    }
+
+    // the slot is tracked and vma's pUserData points at it, freeing it without the device would leave both dangling
+    if (m_slot != nullptr && m_slot->buffer != VK_NULL_HANDLE) {
+        destroy_buffer();
+    }
+
+    m_device = std::move(other.m_device);
+    m_slot = std::move(other.m_slot);
+    return *this;
+}
+
+void buffer_handle::destroy_buffer()
+{
+    if (auto* recorder = m_device->get_recorder()) {
+        recorder->record_destroy_buffer(m_slot->buffer);
+    }
+    m_device->destroy_resource(*m_slot);
+}
+
 void buffer_handle::create_buffer(const VkBufferCreateInfo* create_info, const VmaAllocationCreateInfo* alloc_info)
 {
-    VK_CHECK(vmaCreateBuffer(m_device->get_allocator(), create_info, alloc_info, &m_buffer, &m_alloc, &m_alloc_info), "failed to create buffer");
+    VmaAllocationCreateInfo slot_alloc_info = *alloc_info;
+    slot_alloc_info.pUserData = m_slot.get();
+    VK_CHECK(vmaCreateBuffer(m_device->get_allocator(), create_info, &slot_alloc_info, &m_slot->buffer, &m_slot->alloc, &m_slot->alloc_info), "failed to create buffer");
+
+    m_slot->buffer_info = *create_info;
+    m_slot->buffer_info.pNext = nullptr;
+    m_slot->buffer_info.queueFamilyIndexCount = 0;
+    m_slot->buffer_info.pQueueFamilyIndices = nullptr;
+
+    if (create_info->usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
+        m_slot->address = m_device->get_buffer_address(m_slot->buffer);
+    }
+
+    m_device->track_resource(*m_slot);
+
+    // addresses end up in push constants and other buffers just like descriptors do
+    constexpr VkBufferUsageFlags descriptor_usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+        | VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+    m_slot->movable = m_device->get_resource_movable(*m_slot) && (create_info->usage & descriptor_usage) == 0;
+
+    if (auto* recorder = m_device->get_recorder()) {
+        recorder->record_create_buffer(m_slot->buffer, create_info, alloc_info);
+    }
+}
+
+void buffer_handle::set_tag(std::string tag)
+{
+    m_device->set_resource_tag(*m_slot, std::move(tag));
+}
+
+void buffer_handle::set_movable(bool movable)
+{
+    quix_assert(!movable || m_device->get_resource_movable(*m_slot), "only device local, unmapped buffers with transfer src and dst usage can be moved");
+    m_slot->movable = movable;
 }
 
 void buffer_handle::create_uniform_buffer(const VkDeviceSize size)
@@ -64,7 +157,8 @@ void buffer_handle::create_gpu_buffer(const VkDeviceSize size, const VkBufferUsa
     VkBufferCreateInfo buffer_info {};
     buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     buffer_info.size = size;
-    buffer_info.usage = usage_flags;
+    // both transfer usages let device::defragment_step copy the buffer
+    buffer_info.usage = usage_flags | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
     buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
     VmaAllocationCreateInfo alloc_info {};
@@ -76,14 +170,10 @@ void buffer_handle::create_gpu_buffer(const VkDeviceSize size, const VkBufferUsa
 
 void buffer_handle::create_staged_buffer(const VkDeviceSize size, const VkBufferUsageFlags usage_flags, const void* data, instance* inst)
 {
-    buffer_handle staging_buffer(m_device);
-    staging_buffer.create_staging_buffer(size);
-    memcpy(staging_buffer.get_mapped_data(), data, size);
-
     VkBufferCreateInfo buffer_info {};
     buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     buffer_info.size = size;
-    buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage_flags;
+    buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage_flags;
     buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
     VmaAllocationCreateInfo alloc_info {};
@@ -91,17 +181,52 @@ void buffer_handle::create_staged_buffer(const VkDeviceSize size, const VkBuffer
 
     create_buffer(&buffer_info, &alloc_info);
 
-    auto cmd_pool = inst->get_command_pool();
-    auto cmd_list = cmd_pool.create_command_list();
+    // the batch ends in a barrier and goes to the graphics queue ahead of anything that can use this buffer,
+    // so there is nothing to wait on here
+    auto uploader = inst->get_upload_manager();
+    uploader->upload_buffer(m_slot->buffer, 0, data, size);
+    flush_unless_batching(*uploader);
+}
+
+void buffer_handle::create_staged_buffer(const asset_archive& archive, const char* name, const VkBufferUsageFlags usage_flags, instance* inst)
+{
+    const auto size = archive.get_size(name);
+    quix_assert(size.has_value(), fmt::format("{} is not in the archive", name));
 
-    cmd_list->begin_record(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
-    cmd_list->copy_buffer_to_buffer(staging_buffer.get_buffer(), 0, m_buffer, 0, size);
-    cmd_list->end_record();
-    VkFence fence = inst->create_fence();
-    cmd_list->submit(fence);
-    m_device->wait_idle();
-    vkWaitForFences(m_device->get_logical_device(), 1, &fence, VK_TRUE, UINT64_MAX); // hopefully no deadlocking
-    vkDestroyFence(m_device->get_logical_device(), fence, nullptr);
+    create_gpu_buffer(*size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage_flags);
+
+    bool read = false;
+    auto uploader = inst->get_upload_manager();
+    uploader->upload_buffer(m_slot->buffer, 0, *size, [&](void* staging) { read = archive.read(name, staging); });
+    flush_unless_batching(*uploader);
+
+    quix_assert(read, fmt::format("failed to read {} from the archive", name));
+}
+
+void buffer_handle::create_address_buffer(const VkDeviceSize size, const VkBufferUsageFlags usage_flags)
+{
+    create_gpu_buffer(size, usage_flags | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+}
+
+void buffer_handle::create_mapped_address_buffer(const VkDeviceSize size, const VkBufferUsageFlags usage_flags)
+{
+    VkBufferCreateInfo buffer_info {};
+    buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_info.size = size;
+    buffer_info.usage = usage_flags | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+    buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    // prefers device local host visible memory where there is some, shaders read it every frame
+    VmaAllocationCreateInfo alloc_info {};
+    alloc_info.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+    alloc_info.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+
+    create_buffer(&buffer_info, &alloc_info);
+}
+
+void buffer_handle::create_staged_address_buffer(const VkDeviceSize size, const VkBufferUsageFlags usage_flags, const void* data, instance* inst)
+{
+    create_staged_buffer(size, usage_flags | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, data, inst);
 }
 
 void buffer_handle::create_staging_buffer(const VkDeviceSize size)
@@ -121,63 +246,202 @@ void buffer_handle::create_staging_buffer(const VkDeviceSize size)
 
 image_handle::image_handle(weakref<device> p_device)
     : m_device(std::move(p_device))
+    , m_slot(std::make_unique<resource_slot>())
 {
 }
 
 image_handle::~image_handle()
 {
-    destroy_image();
+    if (m_slot != nullptr) {
+        destroy_image();
+    }
 }
 
-void image_handle::destroy_image()
+image_handle& image_handle::operator=(image_handle&& other) noexcept
 {
-    if (m_sampler != VK_NULL_HANDLE) {
-        vkDestroySampler(m_device->get_logical_device(), m_sampler, nullptr);
+    if (this == &other) {
+        return *this;
     }
 
-    if (m_view != VK_NULL_HANDLE) {
-        vkDestroyImageView(m_device->get_logical_device(), m_view, nullptr);
+    // the slot is tracked and vma's pUserData points at it, freeing it without the device would leave both dangling
+    if (m_slot != nullptr && m_slot->image != VK_NULL_HANDLE) {
+        destroy_image();
     }
 
-    if (m_image != VK_NULL_HANDLE) {
-        vmaDestroyImage(m_device->get_allocator(), m_image, m_alloc);
+    m_device = std::move(other.m_device);
+    m_slot = std::move(other.m_slot);
+    m_sampler = std::exchange(other.m_sampler, VK_NULL_HANDLE);
+    m_type = other.m_type;
+    m_flags = other.m_flags;
+    m_format = other.m_format;
+    m_mip_levels = other.m_mip_levels;
+    m_array_layers = other.m_array_layers;
+    m_samples = other.m_samples;
+    m_extent = other.m_extent;
+    return *this;
+}
+
+void image_handle::destroy_image()
+{
+    // the sampler belongs to the device's sampler cache
+    m_sampler = VK_NULL_HANDLE;
+
+    if (m_slot->image != VK_NULL_HANDLE) {
+        if (auto* recorder = m_device->get_recorder()) {
+            recorder->record_destroy_image(m_slot->image);
+        }
+        // takes the views with it
+        m_device->destroy_resource(*m_slot);
     } else {
         spdlog::warn("image was never created");
     }
 }
 
+void image_handle::set_tag(std::string tag)
+{
+    m_device->set_resource_tag(*m_slot, std::move(tag));
+}
+
+void image_handle::set_movable(bool movable, VkImageLayout layout)
+{
+    constexpr VkImageUsageFlags attachment_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT
+        | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+    quix_assert(!movable
+            || (m_device->get_resource_movable(*m_slot)
+                && (m_slot->image_info.usage & attachment_usage) == 0
+                && (m_slot->image_info.usage & VK_IMAGE_USAGE_SAMPLED_BIT) != 0
+                && m_slot->image_info.samples == VK_SAMPLE_COUNT_1_BIT
+                && m_slot->image_info.tiling == VK_IMAGE_TILING_OPTIMAL),
+        "only device local, single sampled, sampled images with transfer src and dst usage that are not attachments can be moved");
+    // defragmentation copies every aspect of the format at once, multi-planar images would need a copy per plane
+    quix_assert(!movable || m_slot->image_info.format < VK_FORMAT_G8B8G8R8_422_UNORM,
+        "multi-planar images can not be moved");
+    quix_assert(!movable
+            || (layout != VK_IMAGE_LAYOUT_UNDEFINED && layout != VK_IMAGE_LAYOUT_PREINITIALIZED
+                && layout != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL && layout != VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL),
+        "a movable image has to rest in a layout its contents survive in, outside of the transfer layouts the copies use");
+    m_slot->movable = movable;
+    m_slot->movable_layout = layout;
+}
+
 void image_handle::create_image(const VkImageCreateInfo* create_info, const VmaAllocationCreateInfo* alloc_info)
 {
     m_type = create_info->imageType;
+    m_flags = create_info->flags;
     m_format = create_info->format;
     m_mip_levels = create_info->mipLevels;
     m_array_layers = create_info->arrayLayers;
     m_samples = create_info->samples;
     m_extent = create_info->extent;
-    VK_CHECK(vmaCreateImage(m_device->get_allocator(), create_info, alloc_info, &m_image, &m_alloc, &m_alloc_info), "failed to create image");
+
+    VmaAllocationCreateInfo slot_alloc_info = *alloc_info;
+    slot_alloc_info.pUserData = m_slot.get();
+    VK_CHECK(vmaCreateImage(m_device->get_allocator(), create_info, &slot_alloc_info, &m_slot->image, &m_slot->alloc, &m_slot->alloc_info), "failed to create image");
+
+    m_slot->image_info = *create_info;
+    m_slot->image_info.pNext = nullptr;
+    m_slot->image_info.queueFamilyIndexCount = 0;
+    m_slot->image_info.pQueueFamilyIndices = nullptr;
+    m_slot->movable = false;
+
+    m_device->track_resource(*m_slot);
+
+    if (auto* recorder = m_device->get_recorder()) {
+        recorder->record_create_image(m_slot->image, create_info, alloc_info);
+    }
 }
 
-image_handle& image_handle::create_image_from_file(const char* filepath, instance* inst)
+image_handle& image_handle::create_image_from_file(const char* filepath, instance* inst, bool generate_mips, texture_compression compression)
 {
+    if (m_slot->tag.empty()) {
+        m_slot->tag = filepath;
+    }
+
+    if (is_texture_container(filepath)) {
+        return create_image_from_container(filepath, inst);
+    }
+
+    if (compression != texture_compression::none) {
+        if (m_device->get_format_supported(get_compressed_format(compression, true), VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT)) {
+            auto texture = load_compressed_texture(filepath, compression, generate_mips);
+            quix_assert(texture.has_value(), "failed to load image");
+            create_image_from_texture(*texture, inst);
+            return *this;
+        }
+        spdlog::warn("bc formats are not supported or textureCompressionBC is not enabled, {} is loaded uncompressed", filepath);
+    }
+
     int texture_width{};
     int texture_height{};
     int texture_channels{};
     stbi_uc* pixels = stbi_load(filepath, &texture_width, &texture_height, &texture_channels, STBI_rgb_alpha);
-    auto texture_size = (VkDeviceSize)(texture_width * texture_height * 4);
+    quix_assert(pixels != nullptr, "failed to load image");
 
-    auto buffer_handle = inst->create_buffer_handle();
-    buffer_handle.create_staging_buffer(texture_size);
-    std::memcpy(buffer_handle.get_mapped_data(), pixels, texture_size);
+    create_image_from_pixels(pixels, texture_width, texture_height, filepath, inst, generate_mips);
+
+    stbi_image_free(pixels);
+
+    return *this;
+}
 
+image_handle& image_handle::create_image_from_container(const char* filepath, instance* inst)
+{
+    if (m_slot->tag.empty()) {
+        m_slot->tag = filepath;
+    }
+
+    auto container = load_texture_container(filepath);
+    quix_assert(container.has_value(), "failed to load texture container");
+    quix_assert(m_device->get_format_supported(container->format, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT),
+        "texture format is not supported, block compressed formats need textureCompressionBC/ETC2/ASTC_LDR enabled");
+
+    create_image_from_texture(*container, inst);
+
+    return *this;
+}
+
+image_handle& image_handle::create_image_from_archive(const asset_archive& archive, const char* name, instance* inst, bool generate_mips)
+{
+    if (m_slot->tag.empty()) {
+        m_slot->tag = name;
+    }
+
+    auto data = archive.read(name);
+    quix_assert(data.has_value(), fmt::format("failed to read {} from the archive", name));
+
+    if (is_texture_container(name)) {
+        auto container = parse_texture_container(name, std::move(*data));
+        quix_assert(container.has_value(), "failed to load texture container");
+        quix_assert(m_device->get_format_supported(container->format, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT),
+            "texture format is not supported, block compressed formats need textureCompressionBC/ETC2/ASTC_LDR enabled");
+
+        create_image_from_texture(*container, inst);
+        return *this;
+    }
+
+    int texture_width{};
+    int texture_height{};
+    int texture_channels{};
+    stbi_uc* pixels = stbi_load_from_memory(data->data(), static_cast<int>(data->size()), &texture_width, &texture_height, &texture_channels, STBI_rgb_alpha);
+    quix_assert(pixels != nullptr, "failed to load image");
+
+    create_image_from_pixels(pixels, texture_width, texture_height, name, inst, generate_mips);
+
+    stbi_image_free(pixels);
+
+    return *this;
+}
+
+void image_handle::create_image_from_texture(const texture_container& texture, instance* inst)
+{
     VkImageCreateInfo image_info{};
     image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    image_info.imageType = VK_IMAGE_TYPE_2D;
-    image_info.extent.width = texture_width;
-    image_info.extent.height = texture_height;
-    image_info.extent.depth = 1;
-    image_info.mipLevels = 1;
-    image_info.arrayLayers = 1;
-    image_info.format = VK_FORMAT_R8G8B8A8_SRGB;
+    image_info.flags = texture.cube ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0;
+    image_info.imageType = texture.extent.depth > 1 ? VK_IMAGE_TYPE_3D : VK_IMAGE_TYPE_2D;
+    image_info.extent = texture.extent;
+    image_info.mipLevels = texture.mip_levels;
+    image_info.arrayLayers = texture.array_layers;
+    image_info.format = texture.format;
     image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
     image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     image_info.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
@@ -188,44 +452,85 @@ image_handle& image_handle::create_image_from_file(const char* filepath, instanc
     alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
     alloc_info.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 
-    create_image(&image_info, &alloc_info);
+    // every mip is prebuilt, the whole texture can be written from the host without a submission
+    const bool host_copy = m_device->get_host_image_copy_supported(image_info);
+    if (host_copy) {
+        image_info.usage |= VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT;
+    }
 
-    auto cmd_pool = inst->get_command_pool();
-    auto cmd_list = cmd_pool.create_command_list();
+    create_image(&image_info, &alloc_info);
 
-    cmd_list->begin_record(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    if (host_copy) {
+        m_device->host_copy_to_image(m_slot->image, texture.data.data(), texture.regions,
+            { VK_IMAGE_ASPECT_COLOR_BIT, 0, texture.mip_levels, 0, texture.array_layers });
+        return;
+    }
 
-    image_barrier_info barrier_info{};
-    barrier_info.src_access_mask = 0;
-    barrier_info.dst_access_mask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    barrier_info.src_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-    barrier_info.dst_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-    barrier_info.old_layout = VK_IMAGE_LAYOUT_UNDEFINED;
-    barrier_info.new_layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    auto uploader = inst->get_upload_manager();
+    uploader->upload_image(this, texture.data.data(), texture.data.size(), texture.regions);
+    flush_unless_batching(*uploader);
+}
 
-    cmd_list->image_barrier(this, &barrier_info);
+void image_handle::create_image_from_pixels(const uint8_t* pixels, uint32_t width, uint32_t height, const char* name, instance* inst, bool generate_mips)
+{
+    const auto texture_size = static_cast<VkDeviceSize>(width) * height * 4;
+
+    uint32_t mip_levels = 1;
+    if (generate_mips) {
+        VkFormatProperties format_properties {};
+        vkGetPhysicalDeviceFormatProperties(m_device->get_physical_device(), VK_FORMAT_R8G8B8A8_SRGB, &format_properties);
+
+        constexpr VkFormatFeatureFlags blit_features = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+        if ((format_properties.optimalTilingFeatures & blit_features) == blit_features) {
+            mip_levels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+        } else {
+            spdlog::warn("format can not be blitted with linear filtering, {} is loaded without mips", name);
+        }
+    }
 
-    cmd_list->copy_buffer_to_image(buffer_handle.get_buffer(), 0, this, {0, 0, 0});
+    VkImageCreateInfo image_info{};
+    image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_info.imageType = VK_IMAGE_TYPE_2D;
+    image_info.extent.width = width;
+    image_info.extent.height = height;
+    image_info.extent.depth = 1;
+    image_info.mipLevels = mip_levels;
+    image_info.arrayLayers = 1;
+    image_info.format = VK_FORMAT_R8G8B8A8_SRGB;
+    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    image_info.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-    barrier_info.src_access_mask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    barrier_info.dst_access_mask = VK_ACCESS_SHADER_READ_BIT;
-    barrier_info.src_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-    barrier_info.dst_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    barrier_info.old_layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-    barrier_info.new_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    VmaAllocationCreateInfo alloc_info{};
+    alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    alloc_info.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 
-    cmd_list->image_barrier(this, &barrier_info);
-    
-    cmd_list->end_record();
+    // the mips are blitted on the queue anyway, only single mip images skip the staging buffer
+    const bool host_copy = mip_levels == 1 && m_device->get_host_image_copy_supported(image_info);
+    if (host_copy) {
+        image_info.usage |= VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT;
+    }
 
-    VkFence fence = inst->create_fence();
-    cmd_list->submit(fence);
-    vkWaitForFences(m_device->get_logical_device(), 1, &fence, VK_TRUE, UINT64_MAX); // hopefully no deadlocking
-    vkDestroyFence(m_device->get_logical_device(), fence, nullptr);
+    create_image(&image_info, &alloc_info);
 
-    stbi_image_free(pixels);
+    if (host_copy) {
+        VkBufferImageCopy region {};
+        region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+        region.imageExtent = { width, height, 1 };
+        m_device->host_copy_to_image(m_slot->image, pixels, std::span<const VkBufferImageCopy>(&region, 1), { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 });
+        return;
+    }
 
-    return *this;
+    auto uploader = inst->get_upload_manager();
+    if (mip_levels > 1) {
+        uploader->upload_image(this, pixels, texture_size, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+        uploader->generate_mips(this);
+    } else {
+        uploader->upload_image(this, pixels, texture_size);
+    }
+    flush_unless_batching(*uploader);
 }
 
 image_handle& image_handle::create_depth_image(uint32_t width, uint32_t height, VkFormat format)
@@ -241,7 +546,8 @@ image_handle& image_handle::create_depth_image(uint32_t width, uint32_t height,
     image_info.format = format;
     image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
     image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    image_info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    // never read outside the render pass, tile based gpus can keep it in tile memory only
+    image_info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
     image_info.samples = VK_SAMPLE_COUNT_1_BIT;
     image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
@@ -249,6 +555,15 @@ image_handle& image_handle::create_depth_image(uint32_t width, uint32_t height,
     alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
     alloc_info.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 
+    if (m_device->get_lazily_allocated_supported()) {
+        VmaAllocationCreateInfo lazy_info = alloc_info;
+        lazy_info.usage = VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED;
+        uint32_t memory_type {};
+        if (vmaFindMemoryTypeIndexForImageInfo(m_device->get_allocator(), &image_info, &lazy_info, &memory_type) == VK_SUCCESS) {
+            alloc_info = lazy_info;
+        }
+    }
+
     create_image(&image_info, &alloc_info);
 
     return *this;
@@ -258,7 +573,7 @@ image_handle& image_handle::create_view(VkImageAspectFlags aspect_flags)
 {
     VkImageViewCreateInfo create_info{};
     create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    create_info.image = m_image;
+    create_info.image = m_slot->image;
     create_info.viewType = type_to_view_type();
     create_info.format = m_format;
     create_info.subresourceRange.aspectMask = aspect_flags;
@@ -271,7 +586,74 @@ image_handle& image_handle::create_view(VkImageAspectFlags aspect_flags)
     create_info.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
     create_info.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
 
-    VK_CHECK(vkCreateImageView(m_device->get_logical_device(), &create_info, nullptr, &m_view), "failed to create image view");
+    VK_CHECK(vkCreateImageView(m_device->get_logical_device(), &create_info, nullptr, &m_slot->view), "failed to create image view");
+    m_slot->view_info = create_info;
+    if (!m_slot->tag.empty()) {
+        m_device->set_object_name(VK_OBJECT_TYPE_IMAGE_VIEW, reinterpret_cast<uint64_t>(m_slot->view), m_slot->tag.c_str());
+    }
+
+    return *this;
+}
+
+NODISCARD VkImageView image_handle::get_view(const image_view_key& key)
+{
+    quix_assert(m_slot->image != VK_NULL_HANDLE, "views can only be made of created images");
+    quix_assert(key.base_mip < m_mip_levels && key.base_layer < m_array_layers, "view starts past the image's mips or layers");
+
+    // resolve the remaining counts so the same range always finds the same view
+    const uint32_t mip_count = key.mip_count == VK_REMAINING_MIP_LEVELS ? m_mip_levels - key.base_mip : key.mip_count;
+    const uint32_t layer_count = key.layer_count == VK_REMAINING_ARRAY_LAYERS ? m_array_layers - key.base_layer : key.layer_count;
+    quix_assert(mip_count > 0 && key.base_mip + mip_count <= m_mip_levels, "view mip range is out of the image");
+    quix_assert(layer_count > 0 && key.base_layer + layer_count <= m_array_layers, "view layer range is out of the image");
+
+    const VkFormat format = key.format == VK_FORMAT_UNDEFINED ? m_format : key.format;
+    quix_assert(format == m_format || (m_flags & VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT), "view format differs from an image without VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT");
+
+    VkImageViewCreateInfo create_info {};
+    create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    create_info.image = m_slot->image;
+    create_info.viewType = key.type;
+    create_info.format = format;
+    create_info.subresourceRange.aspectMask = key.aspect;
+    create_info.subresourceRange.baseMipLevel = key.base_mip;
+    create_info.subresourceRange.levelCount = mip_count;
+    create_info.subresourceRange.baseArrayLayer = key.base_layer;
+    create_info.subresourceRange.layerCount = layer_count;
+    create_info.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+    create_info.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+    create_info.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+    create_info.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+
+    return m_device->get_subresource_view(*m_slot, create_info);
+}
+
+NODISCARD VkImageView image_handle::get_mip_view(uint32_t mip, VkImageAspectFlags aspect)
+{
+    image_view_key key {};
+    key.type = type_to_view_type();
+    key.aspect = aspect;
+    key.base_mip = mip;
+    key.mip_count = 1;
+    return get_view(key);
+}
+
+NODISCARD VkImageView image_handle::get_layer_view(uint32_t layer, uint32_t mip, VkImageAspectFlags aspect)
+{
+    quix_assert(m_type != VK_IMAGE_TYPE_3D, "3d images have no layers");
+
+    image_view_key key {};
+    key.type = m_type == VK_IMAGE_TYPE_1D ? VK_IMAGE_VIEW_TYPE_1D : VK_IMAGE_VIEW_TYPE_2D;
+    key.aspect = aspect;
+    key.base_mip = mip;
+    key.mip_count = 1;
+    key.base_layer = layer;
+    key.layer_count = 1;
+    return get_view(key);
+}
+
+image_handle& image_handle::create_sampler(const VkSamplerCreateInfo& sampler_info)
+{
+    m_sampler = m_device->get_sampler_cache().get(sampler_info);
 
     return *this;
 }
@@ -313,7 +695,7 @@ image_handle& image_handle::create_sampler(VkFilter m_filter, VkSamplerAddressMo
     sampler_info.minLod = 0.0f;
     sampler_info.maxLod = VK_LOD_CLAMP_NONE; //IDK MAN I THINK THIS IS RIGHT
 
-    VK_CHECK(vkCreateSampler(m_device->get_logical_device(), &sampler_info, nullptr, &m_sampler), "failed to create sampler");
+    m_sampler = m_device->get_sampler_cache().get(sampler_info);
 
     return *this;
 }
@@ -361,7 +743,7 @@ image_handle& image_handle::create_sampler(VkFilter m_filter, VkSamplerAddressMo
     sampler_info.minLod = 0.0f;
     sampler_info.maxLod = VK_LOD_CLAMP_NONE; //IDK MAN I THINK THIS IS RIGHT
 
-    VK_CHECK(vkCreateSampler(m_device->get_logical_device(), &sampler_info, nullptr, &m_sampler), "failed to create sampler");
+    m_sampler = m_device->get_sampler_cache().get(sampler_info);
 
     return *this;
 }
@@ -370,9 +752,12 @@ constexpr VkImageViewType image_handle::type_to_view_type()
 {
     switch (m_type) {
         case VK_IMAGE_TYPE_1D:
-            return VK_IMAGE_VIEW_TYPE_1D;
+            return m_array_layers > 1 ? VK_IMAGE_VIEW_TYPE_1D_ARRAY : VK_IMAGE_VIEW_TYPE_1D;
         case VK_IMAGE_TYPE_2D:
-            return VK_IMAGE_VIEW_TYPE_2D;
+            if ((m_flags & VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT) && m_array_layers % 6 == 0) {
+                return m_array_layers == 6 ? VK_IMAGE_VIEW_TYPE_CUBE : VK_IMAGE_VIEW_TYPE_CUBE_ARRAY;
+            }
+            return m_array_layers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
         case VK_IMAGE_TYPE_3D:
             return VK_IMAGE_VIEW_TYPE_3D;
         default:
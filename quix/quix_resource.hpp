@@ -1,13 +1,72 @@
 #ifndef _QUIX_RESOURCE_HPP
 #define _QUIX_RESOURCE_HPP
 
+#include "quix_texture_encoder.hpp"
+
 namespace quix {
 
 class device;
 class instance;
 class command_list;
+class asset_archive;
+
+// the vulkan objects behind a buffer_handle or image_handle. it lives on the heap and the allocation's
+// pUserData points at it, so device::defragment_step can find it from a vma move and swap in the
+// buffer/image it recreated at the new place while the handle itself may have been moved around
+struct resource_slot {
+    VmaAllocation alloc {};
+    VmaAllocationInfo alloc_info {};
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkImage image = VK_NULL_HANDLE;
+    VkImageView view = VK_NULL_HANDLE;
+    // 0 unless the buffer has VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
+    VkDeviceAddress address {};
+    // groups the allocation in device::dump_memory_stats and names the objects, "untagged" when empty
+    std::string tag {};
+
+    // kept to recreate the objects at the new place, pNext and queue family pointers are not kept
+    VkBufferCreateInfo buffer_info {};
+    VkImageCreateInfo image_info {};
+    VkImageViewCreateInfo view_info {};
+
+    // views of parts of the image made by image_handle::get_view, recreated along with view by defragmentation
+    struct subresource_view {
+        VkImageViewCreateInfo info {};
+        VkImageView view = VK_NULL_HANDLE;
+    };
+    std::vector<subresource_view> subresource_views {};
+
+    // bumped every time defragmentation swaps the objects
+    uint32_t generation {};
+    bool movable = false;
+    // the layout a movable image is in whenever device::defragment_step runs, it is copied out of and left in it
+    VkImageLayout movable_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    // the vma move while a defragmentation pass copies the resource, guarded by the device's defragmentation lock
+    VmaDefragmentationMove* move = nullptr;
+};
 
+// every aspect a format has, depth and or stencil for depth formats and color for the rest
+NODISCARD VkImageAspectFlags get_format_aspect(VkFormat format) noexcept;
+
+// a view of some mips and layers of an image. VK_FORMAT_UNDEFINED takes the image's format, other formats need
+// VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT, and the VK_REMAINING_* counts run to the last mip or layer
+struct image_view_key {
+    VkImageViewType type {};
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+    uint32_t base_mip {};
+    uint32_t mip_count = VK_REMAINING_MIP_LEVELS;
+    uint32_t base_layer {};
+    uint32_t layer_count = VK_REMAINING_ARRAY_LAYERS;
+};
+
+// buffers are movable by default when they are device local, unmapped, can be copied both ways and can neither be
+// bound through a descriptor nor addressed from shaders, i.e. vertex and index buffers that are bound with get_buffer every frame.
+// anything that is cached elsewhere, like a VkBuffer written into a descriptor set, has to be refreshed
+// when get_generation changes, opt in with set_movable for those
 class buffer_handle {
+    friend class buffer_table;
+
 public:
     explicit buffer_handle(weakref<device> p_device);
 
@@ -15,7 +74,8 @@ public:
     buffer_handle(const buffer_handle&) = delete;
     buffer_handle& operator=(const buffer_handle&) = delete;
     buffer_handle(buffer_handle&&) = default;
-    buffer_handle& operator=(buffer_handle&&) = default;
+    // destroys the buffer held before through the device, like the destructor does
+    buffer_handle& operator=(buffer_handle&& other) noexcept;
 
     void create_buffer(const VkBufferCreateInfo* create_info, const VmaAllocationCreateInfo* alloc_info);
     void create_uniform_buffer(const VkDeviceSize size);
@@ -23,33 +83,63 @@ public:
     void create_cpu_buffer(const VkDeviceSize size, const VkBufferUsageFlags usage_flags, const VmaAllocationCreateFlags alloc_flags);
     void create_gpu_buffer(const VkDeviceSize size, const VkBufferUsageFlags usage_flags);
     void create_staged_buffer(const VkDeviceSize size, const VkBufferUsageFlags usage_flags, const void* data, instance* inst);
-
-    NODISCARD inline VkBuffer get_buffer() const noexcept { return m_buffer; }
-    NODISCARD inline VmaAllocationInfo get_alloc_info() const noexcept { return m_alloc_info; }
+    // sized to the archive entry, which is decompressed straight into upload staging memory
+    void create_staged_buffer(const asset_archive& archive, const char* name, const VkBufferUsageFlags usage_flags, instance* inst);
+
+    // buffers for pointer based shader data, they add VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT and storage usage and
+    // need device::get_buffer_device_address_supported. get_device_address goes into push constants, see address_push_constants.
+    // the mapped variant is host visible for data rewritten every frame, like per draw storage
+    void create_address_buffer(const VkDeviceSize size, const VkBufferUsageFlags usage_flags);
+    void create_mapped_address_buffer(const VkDeviceSize size, const VkBufferUsageFlags usage_flags);
+    void create_staged_address_buffer(const VkDeviceSize size, const VkBufferUsageFlags usage_flags, const void* data, instance* inst);
+
+    // can be set before or after the buffer is created
+    void set_tag(std::string tag);
+    NODISCARD inline const std::string& get_tag() const noexcept { return m_slot->tag; }
+
+    // the buffer has to be device local, unmapped and have both transfer usages to be movable
+    void set_movable(bool movable);
+    NODISCARD inline bool get_movable() const noexcept { return m_slot->movable; }
+    NODISCARD inline uint32_t get_generation() const noexcept { return m_slot->generation; }
+
+    NODISCARD inline VkBuffer get_buffer() const noexcept { return m_slot->buffer; }
+    NODISCARD inline VmaAllocationInfo get_alloc_info() const noexcept { return m_slot->alloc_info; }
     NODISCARD inline void* get_mapped_data() const noexcept
     {
-        quix_assert(m_alloc_info.pMappedData != nullptr, "buffer is not mapped");
-        return m_alloc_info.pMappedData;
+        quix_assert(m_slot->alloc_info.pMappedData != nullptr, "buffer is not mapped");
+        return m_slot->alloc_info.pMappedData;
+    }
+    NODISCARD inline VkDeviceSize get_offset() const noexcept { return m_slot->alloc_info.offset; }
+    // changes with get_generation when the buffer was made movable
+    NODISCARD inline VkDeviceAddress get_device_address() const noexcept
+    {
+        quix_assert(m_slot->address != 0, "buffer was not created with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT");
+        return m_slot->address;
     }
-    NODISCARD inline VkDeviceSize get_offset() const noexcept { return m_alloc_info.offset; }
     NODISCARD inline VkDescriptorBufferInfo get_descriptor_info(uint32_t offset = 0)
     {
         VkDescriptorBufferInfo info {};
-        info.buffer = m_buffer;
+        info.buffer = m_slot->buffer;
         info.offset = offset;
-        info.range = m_alloc_info.size;
+        info.range = m_slot->alloc_info.size;
         return info;
     }
 
 private:
+    void destroy_buffer();
+
     weakref<device> m_device;
-    VmaAllocation m_alloc {};
-    VmaAllocationInfo m_alloc_info {};
-    VkBuffer m_buffer = VK_NULL_HANDLE;
+    // null once the handle has been moved from
+    std::unique_ptr<resource_slot> m_slot;
 };
 
+// images are never moved unless set_movable opts them in, the view ends up in descriptor sets and the streamer
+// keeps views of its own. a movable image has to be in the layout given to set_movable whenever
+// device::defragment_step runs, and descriptors written with get_view have to be rewritten when get_generation changes
+
 class image_handle {
     friend class command_list;
+    friend class image_table;
 
 public:
     explicit image_handle(weakref<device> p_device);
@@ -58,26 +148,61 @@ public:
     image_handle(const image_handle&) = delete;
     image_handle& operator=(const image_handle&) = delete;
     image_handle(image_handle&&) = default;
-    image_handle& operator=(image_handle&&) = default;
+    // destroys the image held before through the device, like the destructor does
+    image_handle& operator=(image_handle&& other) noexcept;
 
     void create_image(const VkImageCreateInfo* create_info, const VmaAllocationCreateInfo* alloc_info);
 
-    image_handle& create_image_from_file(const char* filepath, instance* inst);
+    // generate_mips builds the full mip chain on the gpu when the format can be blitted with linear filtering
+    // .ktx2 and .dds files go through create_image_from_container, generate_mips and compression do not apply to them.
+    // compression encodes on the cpu and caches the result next to the file, the mips are built on the cpu in that case.
+    // falls back to uncompressed when the device can not sample the bc format
+    image_handle& create_image_from_file(const char* filepath, instance* inst, bool generate_mips = false,
+        texture_compression compression = texture_compression::none);
+    // uploads the block compressed data and every prebuilt mip as is, the format has to be supported by the device
+    image_handle& create_image_from_container(const char* filepath, instance* inst);
+    // .ktx2 and .dds entries are uploaded as create_image_from_container does, anything else is decoded with stb_image
+    // like create_image_from_file without compression, pack block compressed textures as .ktx2 or .dds instead
+    image_handle& create_image_from_archive(const asset_archive& archive, const char* name, instance* inst, bool generate_mips = false);
     image_handle& create_depth_image(uint32_t width, uint32_t height, VkFormat format);
 
     image_handle& create_view(VkImageAspectFlags aspect_flags = VK_IMAGE_ASPECT_COLOR_BIT);
+    // samplers come from the device's sampler_cache and are shared between every image with the same sampler state
+    image_handle& create_sampler(const VkSamplerCreateInfo& sampler_info);
     image_handle& create_sampler(VkFilter m_filter, VkSamplerAddressMode sampler_address_mode);
     image_handle& create_sampler(VkFilter m_filter, VkSamplerAddressMode sampler_address_mode, float anisotropy);
 
-    NODISCARD inline VkImage get_image() const noexcept { return m_image; }
-    NODISCARD inline VkImageView get_view() const noexcept { return m_view; }
+    // can be set before or after the image is created, the loaders tag with the file or archive entry name unless set before
+    void set_tag(std::string tag);
+    NODISCARD inline const std::string& get_tag() const noexcept { return m_slot->tag; }
+
+    // the image has to be device local, sampled, not an attachment, single sampled and have both transfer usages.
+    // layout is where it sits between frames, e.g. VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL for a depth format
+    void set_movable(bool movable, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    NODISCARD inline bool get_movable() const noexcept { return m_slot->movable; }
+    NODISCARD inline uint32_t get_generation() const noexcept { return m_slot->generation; }
+
+    NODISCARD inline VkImage get_image() const noexcept { return m_slot->image; }
+    NODISCARD inline VkImageView get_view() const noexcept { return m_slot->view; }
+    // created on first use and kept until the image is destroyed, e.g. one storage view per mip for a compute downsample.
+    // defragmentation recreates them, refresh anything holding one when get_generation changes
+    NODISCARD VkImageView get_view(const image_view_key& key);
+    // every layer of one mip, with the view type the whole image would get
+    NODISCARD VkImageView get_mip_view(uint32_t mip, VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT);
+    // one layer of a 1d or 2d array or one face of a cube as a plain 1d or 2d view
+    NODISCARD VkImageView get_layer_view(uint32_t layer, uint32_t mip = 0, VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT);
     NODISCARD inline VkSampler get_sampler() const noexcept { return m_sampler; }
+    NODISCARD inline VkFormat get_format() const noexcept { return m_format; }
+    NODISCARD inline VkExtent3D get_extent() const noexcept { return m_extent; }
+    NODISCARD inline uint32_t get_mip_levels() const noexcept { return m_mip_levels; }
+    NODISCARD inline uint32_t get_array_layers() const noexcept { return m_array_layers; }
+    NODISCARD inline VmaAllocationInfo get_alloc_info() const noexcept { return m_slot->alloc_info; }
 
     NODISCARD inline VkDescriptorImageInfo get_descriptor_info()
     {
         VkDescriptorImageInfo info {};
         info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        info.imageView = m_view;
+        info.imageView = m_slot->view;
         info.sampler = m_sampler;
         return info;
     }
@@ -85,16 +210,17 @@ public:
     void destroy_image();
 
 private:
+    void create_image_from_texture(const texture_container& texture, instance* inst);
+    void create_image_from_pixels(const uint8_t* pixels, uint32_t width, uint32_t height, const char* name, instance* inst, bool generate_mips);
     constexpr VkImageViewType type_to_view_type();
 
     weakref<device> m_device;
-    VmaAllocation m_alloc {};
-    VmaAllocationInfo m_alloc_info {};
-    VkImage m_image = VK_NULL_HANDLE;
-    VkImageView m_view = VK_NULL_HANDLE;
+    // null once the handle has been moved from
+    std::unique_ptr<resource_slot> m_slot;
     VkSampler m_sampler = VK_NULL_HANDLE;
 
     VkImageType m_type {};
+    VkImageCreateFlags m_flags {};
     VkFormat m_format {};
     uint32_t m_mip_levels {};
     uint32_t m_array_layers {};
@@ -0,0 +1,93 @@
+#ifndef _QUIX_SAMPLER_CACHE_CPP
+#define _QUIX_SAMPLER_CACHE_CPP
+
+#include "quix_sampler_cache.hpp"
+
+namespace quix {
+
+sampler_cache::sampler_cache(VkDevice device)
+    : m_device(device)
+{
+}
+
+sampler_cache::~sampler_cache()
+{
+    for (const auto& [info, sampler] : m_samplers) {
+        vkDestroySampler(m_device, sampler, nullptr);
+    }
+}
+
+NODISCARD VkSampler sampler_cache::get(const VkSamplerCreateInfo& create_info)
+{
+    quix_assert(create_info.pNext == nullptr, "cached samplers can not have a pNext chain");
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_samplers.find(create_info);
+    if (it != m_samplers.end()) {
+        return it->second;
+    }
+
+    VkSampler sampler = VK_NULL_HANDLE;
+    VK_CHECK(vkCreateSampler(m_device, &create_info, nullptr, &sampler), "failed to create sampler");
+    m_samplers.emplace(create_info, sampler);
+    return sampler;
+}
+
+NODISCARD std::size_t sampler_cache::get_count()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_samplers.size();
+}
+
+std::size_t sampler_cache::sampler_info_hash::operator()(const VkSamplerCreateInfo& info) const noexcept
+{
+    std::size_t result = 0;
+    const auto combine = [&result](std::size_t value) {
+        result ^= value + 0x9e3779b97f4a7c15ull + (result << 6) + (result >> 2);
+    };
+
+    // the enums and flags are all small, pack them before mixing
+    combine(static_cast<std::size_t>(info.flags)
+        | static_cast<std::size_t>(info.magFilter) << 8
+        | static_cast<std::size_t>(info.minFilter) << 16
+        | static_cast<std::size_t>(info.mipmapMode) << 24
+        | static_cast<std::size_t>(info.addressModeU) << 32
+        | static_cast<std::size_t>(info.addressModeV) << 40
+        | static_cast<std::size_t>(info.addressModeW) << 48);
+    combine(static_cast<std::size_t>(info.anisotropyEnable)
+        | static_cast<std::size_t>(info.compareEnable) << 1
+        | static_cast<std::size_t>(info.unnormalizedCoordinates) << 2
+        | static_cast<std::size_t>(info.compareOp) << 8
+        | static_cast<std::size_t>(info.borderColor) << 16);
+    combine(std::hash<float>()(info.mipLodBias));
+    combine(std::hash<float>()(info.maxAnisotropy));
+    combine(std::hash<float>()(info.minLod));
+    combine(std::hash<float>()(info.maxLod));
+
+    return result;
+}
+
+bool sampler_cache::sampler_info_equal::operator()(const VkSamplerCreateInfo& lhs, const VkSamplerCreateInfo& rhs) const noexcept
+{
+    return lhs.flags == rhs.flags
+        && lhs.magFilter == rhs.magFilter
+        && lhs.minFilter == rhs.minFilter
+        && lhs.mipmapMode == rhs.mipmapMode
+        && lhs.addressModeU == rhs.addressModeU
+        && lhs.addressModeV == rhs.addressModeV
+        && lhs.addressModeW == rhs.addressModeW
+        && lhs.mipLodBias == rhs.mipLodBias
+        && lhs.anisotropyEnable == rhs.anisotropyEnable
+        && lhs.maxAnisotropy == rhs.maxAnisotropy
+        && lhs.compareEnable == rhs.compareEnable
+        && lhs.compareOp == rhs.compareOp
+        && lhs.minLod == rhs.minLod
+        && lhs.maxLod == rhs.maxLod
+        && lhs.borderColor == rhs.borderColor
+        && lhs.unnormalizedCoordinates == rhs.unnormalizedCoordinates;
+}
+
+} // namespace quix
+
+#endif // _QUIX_SAMPLER_CACHE_CPP
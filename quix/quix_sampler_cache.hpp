@@ -0,0 +1,39 @@
+#ifndef _QUIX_SAMPLER_CACHE_HPP
+#define _QUIX_SAMPLER_CACHE_HPP
+
+namespace quix {
+
+// one VkSampler per distinct VkSamplerCreateInfo, shared by everything that asks for the same state and
+// destroyed with the device. keeps thousands of textures from running into maxSamplerAllocationCount
+class sampler_cache {
+public:
+    explicit sampler_cache(VkDevice device);
+    ~sampler_cache();
+
+    sampler_cache(const sampler_cache&) = delete;
+    sampler_cache& operator=(const sampler_cache&) = delete;
+    sampler_cache(sampler_cache&&) = delete;
+    sampler_cache& operator=(sampler_cache&&) = delete;
+
+    // never destroy the returned sampler, pNext chains are not supported
+    NODISCARD VkSampler get(const VkSamplerCreateInfo& create_info);
+
+    NODISCARD std::size_t get_count();
+
+private:
+    struct sampler_info_hash {
+        std::size_t operator()(const VkSamplerCreateInfo& info) const noexcept;
+    };
+
+    struct sampler_info_equal {
+        bool operator()(const VkSamplerCreateInfo& lhs, const VkSamplerCreateInfo& rhs) const noexcept;
+    };
+
+    VkDevice m_device;
+    std::mutex m_mutex {};
+    std::unordered_map<VkSamplerCreateInfo, VkSampler, sampler_info_hash, sampler_info_equal> m_samplers {};
+};
+
+} // namespace quix
+
+#endif // _QUIX_SAMPLER_CACHE_HPP
@@ -3,6 +3,8 @@
 
 #include "quix_shader.hpp"
 
+#include "quix_archive.hpp"
+
 #include <spirv-tools/libspirv.hpp>
 #include <spirv-tools/optimizer.hpp>
 
@@ -56,6 +58,24 @@ shader::shader(const char* path, EShLanguage stage)
     spdlog::trace("Shader created from {}", path);
 }
 
+shader::shader(const asset_archive& archive, const char* name, EShLanguage stage)
+{
+    spdlog::trace("Creating shader from {} in archive", name);
+
+    const std::string spvName = ends_with(name, ".spv") ? std::string(name) : std::string(name) + ".spv";
+    if (auto size = archive.get_size(spvName)) {
+        quix_assert(*size % sizeof(uint32_t) == 0, fmt::format("Error in {} spv size is not a multiple of 4", spvName));
+        code.resize(*size / sizeof(uint32_t));
+        quix_assert(archive.read(spvName, code.data()), fmt::format("failed to read {} from the archive", spvName));
+        return;
+    }
+
+    auto source = archive.read(name);
+    quix_assert(source.has_value(), fmt::format("Error in {} shader is not in the archive", name));
+    compileSource(stage, name, std::string(source->begin(), source->end()));
+    spdlog::trace("Shader created from {} in archive", name);
+}
+
 std::vector<uint32_t>& shader::getSpirvCode()
 {
     return code;
@@ -131,6 +151,14 @@ void shader::setShaderVersion(uint32_t apiVersion)
 }
 
 void shader::compileShader(EShLanguage stage, const char* path, const char* cSpvPath)
+{
+    compileSource(stage, path, getSourceCode(path));
+
+    // save the spv code to a file
+    saveSpvCode(cSpvPath);
+}
+
+void shader::compileSource(EShLanguage stage, const char* path, const std::string& source)
 {
     spdlog::trace("Compiling shader {}", path);
     const TBuiltInResource* resources = GetDefaultResources();
@@ -142,7 +170,6 @@ void shader::compileShader(EShLanguage stage, const char* path, const char* cSpv
     shader.setEnvClient(glslang::EShClientVulkan, eshTargetClientVersion);
     shader.setEnvTarget(glslang::EShTargetSpv, eshTargetLanguageVersion);
 
-    std::string source = getSourceCode(path);
     const char* cSource = source.c_str();
     shader.setStrings(&cSource, 1);
 
@@ -203,9 +230,6 @@ void shader::compileShader(EShLanguage stage, const char* path, const char* cSpv
     //
     // bool validationResult = core.Validate(code);
     // quix_assert(validationResult == true, fmt::format("error in {}", path));
-
-    // save the spv code to a file
-    saveSpvCode(cSpvPath);
 }
 
 const std::string shader::getSourceCode(const char* path)
@@ -3,9 +3,13 @@
 
 namespace quix {
 
+class asset_archive;
+
 class shader {
 public:
     shader(const char* path, EShLanguage stage);
+    // loads <name>.spv from the archive when it was packed, otherwise compiles the glsl entry without caching it
+    shader(const asset_archive& archive, const char* name, EShLanguage stage);
     ~shader() = default;
 
     shader(const shader&) = delete;
@@ -20,6 +24,7 @@ public:
 
 private:
     void compileShader(EShLanguage stage, const char* path, const char* cSpvPath);
+    void compileSource(EShLanguage stage, const char* path, const std::string& source);
     const std::string getSourceCode(const char* path);
     void loadSpvCode(const char* path);
     void saveSpvCode(const char* path);
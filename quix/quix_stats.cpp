@@ -0,0 +1,109 @@
+#ifndef _QUIX_STATS_CPP
+#define _QUIX_STATS_CPP
+
+#include "quix_stats.hpp"
+
+namespace quix {
+
+void frame_stats::record(frame_metric metric, double milliseconds) noexcept
+{
+    auto& target = m_rings[static_cast<std::size_t>(metric)];
+    const uint64_t index = target.written.fetch_add(1, std::memory_order_acq_rel);
+    target.samples[index & (ring_size - 1)].store(static_cast<float>(milliseconds), std::memory_order_relaxed);
+}
+
+NODISCARD frame_metric_summary frame_stats::get_summary(frame_metric metric) const
+{
+    const auto& source = m_rings[static_cast<std::size_t>(metric)];
+    const auto count = static_cast<std::size_t>(std::min<uint64_t>(source.written.load(std::memory_order_acquire), ring_size));
+
+    frame_metric_summary summary {};
+    if (count == 0) {
+        return summary;
+    }
+
+    std::vector<float> samples(count);
+    for (std::size_t i = 0; i < count; i++) {
+        samples[i] = source.samples[i].load(std::memory_order_relaxed);
+    }
+    std::sort(samples.begin(), samples.end());
+
+    auto percentile = [&](double p) {
+        const auto index = static_cast<std::size_t>(p * static_cast<double>(count - 1) + 0.5);
+        return static_cast<double>(samples[index]);
+    };
+
+    double total = 0.0;
+    for (float sample : samples) {
+        total += sample;
+    }
+
+    summary.p50 = percentile(0.50);
+    summary.p95 = percentile(0.95);
+    summary.p99 = percentile(0.99);
+    summary.average = total / static_cast<double>(count);
+    summary.max = samples.back();
+    summary.samples = count;
+    return summary;
+}
+
+NODISCARD const char* frame_stats::get_metric_name(frame_metric metric) noexcept
+{
+    switch (metric) {
+    case frame_metric::cpu_frame:
+        return "cpu frame";
+    case frame_metric::fence_wait:
+        return "fence wait";
+    case frame_metric::acquire:
+        return "acquire";
+    case frame_metric::present:
+        return "present";
+    case frame_metric::gpu:
+        return "gpu";
+    case frame_metric::count:
+        break;
+    }
+    return "unknown";
+}
+
+void frame_stats::dump() const
+{
+    for (uint32_t i = 0; i < static_cast<uint32_t>(frame_metric::count); i++) {
+        const auto metric = static_cast<frame_metric>(i);
+        const auto summary = get_summary(metric);
+        if (summary.samples == 0) {
+            continue;
+        }
+
+        spdlog::info("{:>10}: p50 {:.3f} ms  p95 {:.3f} ms  p99 {:.3f} ms  avg {:.3f} ms  max {:.3f} ms  ({} samples)",
+            get_metric_name(metric), summary.p50, summary.p95, summary.p99, summary.average, summary.max, summary.samples);
+    }
+}
+
+void frame_stats::set_dump_interval(double seconds) noexcept
+{
+    m_dump_interval.store(std::max(seconds, 0.0), std::memory_order_relaxed);
+}
+
+void frame_stats::tick()
+{
+    const double interval = m_dump_interval.load(std::memory_order_relaxed);
+    if (interval <= 0.0) {
+        return;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    if (m_last_dump == std::chrono::steady_clock::time_point {}) {
+        m_last_dump = now;
+        return;
+    }
+
+    if (std::chrono::duration<double>(now - m_last_dump).count() >= interval) {
+        m_last_dump = now;
+        dump();
+    }
+}
+
+} // namespace quix
+
+#endif // _QUIX_STATS_CPP
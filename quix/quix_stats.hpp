@@ -0,0 +1,92 @@
+#ifndef _QUIX_STATS_HPP
+#define _QUIX_STATS_HPP
+
+namespace quix {
+
+enum class frame_metric : uint32_t {
+    cpu_frame,
+    fence_wait,
+    acquire,
+    present,
+    gpu,
+    count
+};
+
+struct frame_metric_summary {
+    double p50 {};
+    double p95 {};
+    double p99 {};
+    double average {};
+    double max {};
+    std::size_t samples {};
+};
+
+// per metric rings of the last ring_size samples in milliseconds, recording never locks so it
+// can sit on the acquire/present path, summaries sort a copy of the ring so the tail is visible
+class frame_stats {
+public:
+    static constexpr std::size_t ring_size = 1024;
+    static_assert((ring_size & (ring_size - 1)) == 0, "ring_size must be a power of two");
+
+    frame_stats() = default;
+    ~frame_stats() = default;
+
+    frame_stats(const frame_stats&) = delete;
+    frame_stats& operator=(const frame_stats&) = delete;
+    frame_stats(frame_stats&&) = delete;
+    frame_stats& operator=(frame_stats&&) = delete;
+
+    void record(frame_metric metric, double milliseconds) noexcept;
+
+    NODISCARD frame_metric_summary get_summary(frame_metric metric) const;
+    NODISCARD static const char* get_metric_name(frame_metric metric) noexcept;
+
+    // logs a summary of every metric that has samples
+    void dump() const;
+
+    // 0 disables the periodic dump
+    void set_dump_interval(double seconds) noexcept;
+    // called once a frame by whoever submits frames, dumps when the interval has passed
+    void tick();
+
+private:
+    struct ring {
+        std::array<std::atomic<float>, ring_size> samples {};
+        std::atomic<uint64_t> written = 0;
+    };
+
+    std::array<ring, static_cast<std::size_t>(frame_metric::count)> m_rings {};
+
+    std::atomic<double> m_dump_interval = 0.0;
+    std::chrono::steady_clock::time_point m_last_dump {};
+};
+
+// records the lifetime of the scope into a metric
+class scoped_frame_timer {
+public:
+    scoped_frame_timer(frame_stats& stats, frame_metric metric) noexcept
+        : m_stats(stats)
+        , m_metric(metric)
+        , m_start(std::chrono::steady_clock::now())
+    {
+    }
+
+    ~scoped_frame_timer()
+    {
+        m_stats.record(m_metric, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count());
+    }
+
+    scoped_frame_timer(const scoped_frame_timer&) = delete;
+    scoped_frame_timer& operator=(const scoped_frame_timer&) = delete;
+    scoped_frame_timer(scoped_frame_timer&&) = delete;
+    scoped_frame_timer& operator=(scoped_frame_timer&&) = delete;
+
+private:
+    frame_stats& m_stats;
+    frame_metric m_metric;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+} // namespace quix
+
+#endif // _QUIX_STATS_HPP
@@ -0,0 +1,423 @@
+#ifndef _QUIX_STREAMING_CPP
+#define _QUIX_STREAMING_CPP
+
+#include "quix_streaming.hpp"
+
+#include "quix_device.hpp"
+#include "quix_sampler_cache.hpp"
+#include "quix_texture_container.hpp"
+#include "quix_upload.hpp"
+
+namespace quix {
+
+static constexpr VkFormat streamed_format = VK_FORMAT_R8G8B8A8_SRGB;
+static constexpr uint32_t decode_queue_size = 1024;
+void streamed_texture::request(float screen_size) noexcept
+{
+    float current = m_requested_size.load(std::memory_order_relaxed);
+    while (screen_size > current && !m_requested_size.compare_exchange_weak(current, screen_size, std::memory_order_relaxed)) { }
+    m_used.store(true, std::memory_order_release);
+}
+
+NODISCARD VkDescriptorImageInfo streamed_texture::get_descriptor_info() const noexcept
+{
+    VkDescriptorImageInfo info {};
+    info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    info.imageView = m_view.load(std::memory_order_acquire);
+    info.sampler = m_sampler;
+    return info;
+}
+
+texture_streamer::texture_streamer(weakref<device> p_device, weakref<upload_manager> p_uploader)
+    : m_device(std::move(p_device))
+    , m_uploader(std::move(p_uploader))
+    , m_fallback(std::make_unique<image_handle>(m_device))
+    , m_jobs(decode_queue_size)
+    , m_retiring_bytes(std::make_shared<std::atomic<VkDeviceSize>>(0))
+{
+    VkSamplerCreateInfo sampler_info {};
+    sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    sampler_info.magFilter = VK_FILTER_LINEAR;
+    sampler_info.minFilter = VK_FILTER_LINEAR;
+    sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    sampler_info.anisotropyEnable = m_device->get_max_sampler_anisotropy() > 1.0f ? VK_TRUE : VK_FALSE;
+    sampler_info.maxAnisotropy = m_device->get_max_sampler_anisotropy();
+    sampler_info.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+    sampler_info.compareOp = VK_COMPARE_OP_ALWAYS;
+    sampler_info.minLod = 0.0f;
+    sampler_info.maxLod = VK_LOD_CLAMP_NONE;
+    m_sampler = m_device->get_sampler_cache().get(sampler_info);
+
+    VkImageCreateInfo image_info {};
+    image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_info.imageType = VK_IMAGE_TYPE_2D;
+    image_info.extent = { 1, 1, 1 };
+    image_info.mipLevels = 1;
+    image_info.arrayLayers = 1;
+    image_info.format = streamed_format;
+    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    image_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VmaAllocationCreateInfo alloc_info {};
+    alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    alloc_info.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+    m_fallback->create_image(&image_info, &alloc_info);
+    m_fallback->create_view();
+
+    const uint32_t white = 0xffffffff;
+    m_uploader->upload_image(m_fallback.get(), &white, sizeof(white));
+    m_uploader->flush();
+
+    m_decoder = std::thread(&texture_streamer::decode_loop, this);
+}
+
+texture_streamer::~texture_streamer()
+{
+    m_jobs.close();
+    if (m_decoder.joinable()) {
+        m_decoder.join();
+    }
+
+    m_uploader->wait_all();
+    m_device->wait_idle();
+
+    for (auto& texture : m_textures) {
+        auto* view = texture->m_view.load(std::memory_order_relaxed);
+        if (view != m_fallback->get_view()) {
+            vkDestroyImageView(m_device->get_logical_device(), view, nullptr);
+        }
+    }
+    m_textures.clear();
+}
+
+NODISCARD weakref<streamed_texture> texture_streamer::load(const char* path)
+{
+    auto texture = std::make_unique<streamed_texture>();
+    texture->m_view.store(m_fallback->get_view(), std::memory_order_release);
+    texture->m_sampler = m_sampler;
+
+    auto* texture_ptr = texture.get();
+    m_textures.push_back(std::move(texture));
+    m_jobs.push({ texture_ptr, path });
+
+    return weakref<streamed_texture>(texture_ptr);
+}
+
+void texture_streamer::update()
+{
+    m_frame++;
+
+    finish_decoded();
+
+    for (auto& texture : m_textures) {
+        if (texture->m_image == nullptr || !texture->m_used.exchange(false, std::memory_order_acquire)) {
+            continue;
+        }
+
+        texture->m_last_used = m_frame;
+
+        const float screen_size = texture->m_requested_size.exchange(0.0f, std::memory_order_relaxed);
+        const auto& top = texture->m_mips.front();
+        const auto levels = static_cast<uint32_t>(texture->m_mips.size());
+        if (screen_size <= 0.0f) {
+            texture->m_wanted_mip = 0;
+            continue;
+        }
+
+        const float ratio = static_cast<float>(std::max(top.width, top.height)) / screen_size;
+        const auto mip = ratio <= 1.0f ? 0u : static_cast<uint32_t>(std::floor(std::log2(ratio)));
+        texture->m_wanted_mip = std::min(mip, levels - 1);
+    }
+
+    if (const auto overshoot = get_overshoot(0)) {
+        evict(overshoot, m_frame, nullptr);
+    }
+
+    stream_in();
+
+    m_uploader->flush();
+}
+
+void texture_streamer::decode_loop()
+{
+    while (auto job = m_jobs.pop()) {
+        int width {};
+        int height {};
+        int channels {};
+        stbi_uc* pixels = stbi_load(job->path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+        if (pixels == nullptr) {
+            spdlog::error("failed to load streamed texture {}", job->path);
+            continue;
+        }
+
+        decoded_texture decoded {};
+        decoded.texture = job->texture;
+        build_rgba8_mip_chain(pixels, static_cast<uint32_t>(width), static_cast<uint32_t>(height), decoded.pixels, decoded.mips);
+        stbi_image_free(pixels);
+
+        std::lock_guard<std::mutex> lock(m_decoded_mutex);
+        m_decoded.push_back(std::move(decoded));
+    }
+}
+
+void texture_streamer::finish_decoded()
+{
+    std::vector<decoded_texture> decoded {};
+    {
+        std::lock_guard<std::mutex> lock(m_decoded_mutex);
+        decoded.swap(m_decoded);
+    }
+
+    for (auto& result : decoded) {
+        auto& texture = *result.texture;
+        texture.m_pixels = std::move(result.pixels);
+        texture.m_mips = std::move(result.mips);
+
+        const auto levels = static_cast<uint32_t>(texture.m_mips.size());
+        uint32_t initial = 0;
+        while (initial + 1 < levels && std::max(texture.m_mips[initial].width, texture.m_mips[initial].height) > initial_mip_size) {
+            initial++;
+        }
+
+        texture.m_mip_levels.store(levels, std::memory_order_release);
+        texture.m_resident_mip.store(levels, std::memory_order_release);
+        texture.m_alloc_mip = levels;
+        texture.m_wanted_mip = initial;
+        texture.m_last_used = m_frame;
+
+        set_allocation(texture, initial, initial);
+    }
+}
+
+void texture_streamer::stream_in()
+{
+    std::vector<streamed_texture*> candidates {};
+    for (auto& texture : m_textures) {
+        if (texture->m_image != nullptr && texture->m_wanted_mip < texture->get_resident_mip()) {
+            candidates.push_back(texture.get());
+        }
+    }
+
+    // whatever was seen this frame first, then larger on screen first, then closest to done
+    std::sort(candidates.begin(), candidates.end(), [](const streamed_texture* a, const streamed_texture* b) {
+        if (a->m_last_used != b->m_last_used) {
+            return a->m_last_used > b->m_last_used;
+        }
+        const auto a_size = a->m_mips[a->m_wanted_mip].width;
+        const auto b_size = b->m_mips[b->m_wanted_mip].width;
+        if (a_size != b_size) {
+            return a_size > b_size;
+        }
+        return a->get_resident_mip() < b->get_resident_mip();
+    });
+
+    VkDeviceSize streamed = 0;
+    for (auto* texture : candidates) {
+        if (streamed >= m_stream_bytes) {
+            break;
+        }
+
+        const uint32_t resident = texture->get_resident_mip();
+
+        if (texture->m_wanted_mip < texture->m_alloc_mip) {
+            // grow once to the wanted size, the finer mips are then filled in place
+            const VkDeviceSize needed = get_allocation_size(*texture, texture->m_wanted_mip) - get_allocation_size(*texture, texture->m_alloc_mip);
+            if (const auto overshoot = get_overshoot(needed)) {
+                if (!evict(overshoot, m_frame - 1, texture)) {
+                    continue;
+                }
+            }
+
+            set_allocation(*texture, texture->m_wanted_mip, resident);
+            streamed += get_allocation_size(*texture, resident);
+        }
+
+        const uint32_t next = resident - 1;
+        upload_mips(*texture, next, next + 1);
+        texture->m_resident_mip.store(next, std::memory_order_release);
+        update_view(*texture);
+        streamed += texture->m_mips[next].size;
+    }
+}
+
+bool texture_streamer::evict(VkDeviceSize bytes, uint64_t max_last_used, const streamed_texture* keep)
+{
+    VkDeviceSize freed = 0;
+    while (freed < bytes) {
+        streamed_texture* victim = nullptr;
+        for (auto& texture : m_textures) {
+            if (texture.get() == keep || texture->m_image == nullptr || texture->m_last_used > max_last_used) {
+                continue;
+            }
+            // the coarsest mip always stays so there is something to sample
+            if (texture->m_alloc_mip + 1 >= texture->m_mips.size()) {
+                continue;
+            }
+            if (victim == nullptr || texture->m_last_used < victim->m_last_used
+                || (texture->m_last_used == victim->m_last_used && texture->m_alloc_mip < victim->m_alloc_mip)) {
+                victim = texture.get();
+            }
+        }
+
+        if (victim == nullptr) {
+            return false;
+        }
+
+        const VkDeviceSize before = m_resident_bytes;
+        const uint32_t alloc_mip = victim->m_alloc_mip + 1;
+        set_allocation(*victim, alloc_mip, std::max(alloc_mip, victim->get_resident_mip()));
+        victim->m_wanted_mip = std::max(victim->m_wanted_mip, alloc_mip);
+        freed += before > m_resident_bytes ? before - m_resident_bytes : 0;
+    }
+
+    return true;
+}
+
+NODISCARD VkDeviceSize texture_streamer::get_overshoot(VkDeviceSize extra)
+{
+    VkDeviceSize usage = 0;
+    VkDeviceSize budget = 0;
+
+    if (m_budget != 0) {
+        usage = m_resident_bytes;
+        budget = m_budget;
+    } else {
+        // without VK_EXT_memory_budget vma estimates this from its own allocations
+        std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets {};
+        vmaGetHeapBudgets(m_device->get_allocator(), budgets.data());
+
+        const VkPhysicalDeviceMemoryProperties* memory_properties = nullptr;
+        vmaGetMemoryProperties(m_device->get_allocator(), &memory_properties);
+
+        for (uint32_t i = 0; i < memory_properties->memoryHeapCount; i++) {
+            if (memory_properties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+                usage += budgets[i].usage;
+                budget += budgets[i].budget;
+            }
+        }
+        budget = budget / 10 * 9;
+
+        const VkDeviceSize retiring = m_retiring_bytes->load(std::memory_order_relaxed);
+        usage = usage > retiring ? usage - retiring : 0;
+    }
+
+    return usage + extra > budget ? usage + extra - budget : 0;
+}
+
+void texture_streamer::set_allocation(streamed_texture& texture, uint32_t alloc_mip, uint32_t resident_mip)
+{
+    const auto levels = static_cast<uint32_t>(texture.m_mips.size());
+    const auto& top = texture.m_mips[alloc_mip];
+
+    VkImageCreateInfo image_info {};
+    image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_info.imageType = VK_IMAGE_TYPE_2D;
+    image_info.extent = { top.width, top.height, 1 };
+    image_info.mipLevels = levels - alloc_mip;
+    image_info.arrayLayers = 1;
+    image_info.format = streamed_format;
+    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    image_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VmaAllocationCreateInfo alloc_info {};
+    alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    alloc_info.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+    auto image = std::make_unique<image_handle>(m_device);
+    image->create_image(&image_info, &alloc_info);
+    m_resident_bytes += image->get_alloc_info().size;
+
+    if (texture.m_image != nullptr) {
+        const VkDeviceSize old_size = texture.m_image->get_alloc_info().size;
+        m_resident_bytes -= old_size;
+        m_retiring_bytes->fetch_add(old_size, std::memory_order_relaxed);
+
+        // frames in flight may still sample the old image through the old view
+        m_device->defer_destroy([old_image = texture.m_image.release(), old_size, retiring = m_retiring_bytes]() {
+            delete old_image;
+            retiring->fetch_sub(old_size, std::memory_order_relaxed);
+        });
+    }
+
+    texture.m_image = std::move(image);
+    texture.m_alloc_mip = alloc_mip;
+    texture.m_resident_mip.store(resident_mip, std::memory_order_release);
+
+    upload_mips(texture, resident_mip, levels);
+    update_view(texture);
+}
+
+void texture_streamer::upload_mips(streamed_texture& texture, uint32_t first_mip, uint32_t last_mip)
+{
+    const VkDeviceSize base = texture.m_mips[first_mip].offset;
+
+    std::vector<VkBufferImageCopy> regions {};
+    VkDeviceSize size = 0;
+    for (uint32_t mip = first_mip; mip < last_mip; mip++) {
+        const auto& level = texture.m_mips[mip];
+
+        VkBufferImageCopy region {};
+        region.bufferOffset = level.offset - base;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = mip - texture.m_alloc_mip;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = { level.width, level.height, 1 };
+        regions.push_back(region);
+
+        size += level.size;
+    }
+
+    m_uploader->upload_image(texture.m_image.get(), texture.m_pixels.data() + base, size, regions);
+}
+
+void texture_streamer::update_view(streamed_texture& texture)
+{
+    const auto levels = static_cast<uint32_t>(texture.m_mips.size());
+    const uint32_t resident = texture.get_resident_mip();
+
+    // the base mip does the job of a minLod clamp, the unfilled finer mips are never sampled
+    VkImageViewCreateInfo create_info {};
+    create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    create_info.image = texture.m_image->get_image();
+    create_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    create_info.format = streamed_format;
+    create_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    create_info.subresourceRange.baseMipLevel = resident - texture.m_alloc_mip;
+    create_info.subresourceRange.levelCount = levels - resident;
+    create_info.subresourceRange.baseArrayLayer = 0;
+    create_info.subresourceRange.layerCount = 1;
+
+    VkImageView view = VK_NULL_HANDLE;
+    VK_CHECK(vkCreateImageView(m_device->get_logical_device(), &create_info, nullptr, &view), "failed to create image view");
+
+    auto* old_view = texture.m_view.exchange(view, std::memory_order_acq_rel);
+    if (old_view != m_fallback->get_view()) {
+        m_device->defer_destroy([logical_device = m_device->get_logical_device(), old_view]() {
+            vkDestroyImageView(logical_device, old_view, nullptr);
+        });
+    }
+}
+
+NODISCARD VkDeviceSize texture_streamer::get_allocation_size(const streamed_texture& texture, uint32_t alloc_mip) noexcept
+{
+    VkDeviceSize size = 0;
+    for (auto mip = alloc_mip; mip < texture.m_mips.size(); mip++) {
+        size += texture.m_mips[mip].size;
+    }
+    return size;
+}
+
+} // namespace quix
+
+#endif // _QUIX_STREAMING_CPP
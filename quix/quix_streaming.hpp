@@ -0,0 +1,145 @@
+#ifndef _QUIX_STREAMING_HPP
+#define _QUIX_STREAMING_HPP
+
+#include "quix_bounded_queue.hpp"
+#include "quix_resource.hpp"
+#include "quix_texture_container.hpp"
+
+namespace quix {
+
+class device;
+class upload_manager;
+class texture_streamer;
+
+// a texture whose mips come and go with texture_streamer::update.
+// the object stays valid for the lifetime of the streamer, the image behind it does not
+class streamed_texture {
+    friend class texture_streamer;
+
+public:
+    streamed_texture() = default;
+    ~streamed_texture() = default;
+
+    streamed_texture(const streamed_texture&) = delete;
+    streamed_texture& operator=(const streamed_texture&) = delete;
+    streamed_texture(streamed_texture&&) = delete;
+    streamed_texture& operator=(streamed_texture&&) = delete;
+
+    // marks the texture as used this frame and asks for enough mips to cover screen_size pixels
+    // along its largest side, larger requests stream first. callable from any thread
+    void request(float screen_size) noexcept;
+
+    // the streamer's fallback texture until the first mips are resident. the view is replaced whenever
+    // residency changes, so fetch this when writing descriptors instead of caching it
+    NODISCARD VkDescriptorImageInfo get_descriptor_info() const noexcept;
+
+    NODISCARD inline uint32_t get_mip_levels() const noexcept { return m_mip_levels.load(std::memory_order_acquire); }
+    // finest mip that can be sampled, equal to get_mip_levels while nothing is resident
+    NODISCARD inline uint32_t get_resident_mip() const noexcept { return m_resident_mip.load(std::memory_order_acquire); }
+
+private:
+    // decoded rgba8 pixels of every mip, finest first, kept so evicted mips can come back
+    std::vector<uint8_t> m_pixels {};
+    std::vector<mip_level> m_mips {};
+
+    // the image holds mips [m_alloc_mip, levels), the view only [m_resident_mip, levels)
+    std::unique_ptr<image_handle> m_image {};
+    std::atomic<VkImageView> m_view = VK_NULL_HANDLE;
+    VkSampler m_sampler = VK_NULL_HANDLE;
+    uint32_t m_alloc_mip {};
+    uint32_t m_wanted_mip {};
+    uint64_t m_last_used {};
+
+    std::atomic<uint32_t> m_mip_levels = 0;
+    std::atomic<uint32_t> m_resident_mip = 0;
+    std::atomic<float> m_requested_size = 0.0f;
+    std::atomic<bool> m_used = false;
+};
+
+// keeps texture memory under the device local heap budget.
+// files are decoded and mipped on a worker thread, the mips up to initial_mip_size are uploaded first,
+// finer mips stream in one level per texture per update in order of the requested screen size
+// and the least recently used textures lose their finest mips whenever the budget is exceeded.
+// growing a texture allocates the target mip count once and fills it in place with the view's base mip
+// clamping sampling to what is resident, shrinking reallocates so the memory is actually returned
+class texture_streamer {
+public:
+    // coarser mips are loaded as soon as a file is decoded
+    static constexpr uint32_t initial_mip_size = 64;
+    static constexpr VkDeviceSize default_stream_bytes = 16 * 1024 * 1024;
+
+    texture_streamer(weakref<device> p_device, weakref<upload_manager> p_uploader);
+    ~texture_streamer();
+
+    texture_streamer(const texture_streamer&) = delete;
+    texture_streamer& operator=(const texture_streamer&) = delete;
+    texture_streamer(texture_streamer&&) = delete;
+    texture_streamer& operator=(texture_streamer&&) = delete;
+
+    // main thread only, returns right away and decodes in the background
+    NODISCARD weakref<streamed_texture> load(const char* path);
+
+    // main thread only, once per frame before recording. uploads decoded textures, evicts, streams
+    // and flushes the upload_manager so the uploads land before the frame is submitted
+    void update();
+
+    // 0 uses 90% of the device local heap budget reported by vma, anything else is a hard limit in bytes
+    // on the memory held by streamed textures
+    void set_budget(VkDeviceSize bytes) noexcept { m_budget = bytes; }
+    // upper bound on bytes uploaded per update
+    void set_stream_bytes_per_update(VkDeviceSize bytes) noexcept { m_stream_bytes = bytes; }
+
+    NODISCARD inline VkDeviceSize get_resident_bytes() const noexcept { return m_resident_bytes; }
+
+private:
+    struct decode_job {
+        streamed_texture* texture = nullptr;
+        std::string path {};
+    };
+
+    struct decoded_texture {
+        streamed_texture* texture = nullptr;
+        std::vector<uint8_t> pixels {};
+        std::vector<mip_level> mips {};
+    };
+
+    void decode_loop();
+    void finish_decoded();
+    void stream_in();
+
+    // frees at least bytes by dropping the finest mip of the least recently used textures,
+    // only textures last used at or before max_last_used are touched
+    bool evict(VkDeviceSize bytes, uint64_t max_last_used, const streamed_texture* keep);
+    // bytes over the budget if extra more were allocated, 0 when it fits
+    NODISCARD VkDeviceSize get_overshoot(VkDeviceSize extra);
+
+    // replaces the image with one holding [alloc_mip, levels) and uploads [resident_mip, levels) from the cpu copy
+    void set_allocation(streamed_texture& texture, uint32_t alloc_mip, uint32_t resident_mip);
+    void upload_mips(streamed_texture& texture, uint32_t first_mip, uint32_t last_mip);
+    void update_view(streamed_texture& texture);
+    NODISCARD static VkDeviceSize get_allocation_size(const streamed_texture& texture, uint32_t alloc_mip) noexcept;
+
+    weakref<device> m_device;
+    weakref<upload_manager> m_uploader;
+
+    VkSampler m_sampler = VK_NULL_HANDLE;
+    std::unique_ptr<image_handle> m_fallback;
+
+    std::vector<std::unique_ptr<streamed_texture>> m_textures {};
+
+    bounded_queue<decode_job> m_jobs;
+    std::thread m_decoder;
+    std::mutex m_decoded_mutex;
+    std::vector<decoded_texture> m_decoded {};
+
+    VkDeviceSize m_budget {};
+    VkDeviceSize m_stream_bytes = default_stream_bytes;
+    VkDeviceSize m_resident_bytes {};
+    // retired images still count in vma's usage until the device frees them, shared with those callbacks
+    std::shared_ptr<std::atomic<VkDeviceSize>> m_retiring_bytes;
+    uint64_t m_frame {};
+};
+
+} // namespace quix
+
+#endif // _QUIX_STREAMING_HPP
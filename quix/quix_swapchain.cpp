@@ -32,15 +32,36 @@ swapchain::~swapchain()
 void swapchain::recreate_swapchain()
 {
     VkSwapchainKHR old_swapchain = m_swapchain;
+    std::vector<VkImageView> old_image_views = std::move(m_swapchain_image_views);
     m_swapchain_images.clear();
-    create_swapchain(old_swapchain);
-
-    destroy_image_views();
     m_swapchain_image_views.clear();
 
+    create_swapchain(old_swapchain);
     create_image_views();
 
-    vkDestroySwapchainKHR(m_device->get_logical_device(), old_swapchain, nullptr);
+    // frames still in flight may be using the old images, retire them instead of waiting on the device
+    m_device->defer_destroy([logical_device = m_device->get_logical_device(), old_swapchain, old_image_views = std::move(old_image_views)]() {
+        for (auto* image_view : old_image_views) {
+            vkDestroyImageView(logical_device, image_view, nullptr);
+        }
+        vkDestroySwapchainKHR(logical_device, old_swapchain, nullptr);
+    });
+}
+
+void swapchain::set_present_mode(VkPresentModeKHR present_mode) noexcept
+{
+    if (present_mode != m_present_mode) {
+        m_present_mode = present_mode;
+        m_settings_changed = true;
+    }
+}
+
+void swapchain::set_image_count(uint32_t image_count) noexcept
+{
+    if (image_count != m_requested_image_count) {
+        m_requested_image_count = image_count;
+        m_settings_changed = true;
+    }
 }
 
 void swapchain::create_swapchain(VkSwapchainKHR old_swapchain)
@@ -51,7 +72,13 @@ void swapchain::create_swapchain(VkSwapchainKHR old_swapchain)
     VkPresentModeKHR present_mode = choose_swap_present_mode(swapchain_support.present_modes);
     m_swapchain_extent = choose_swap_extent(swapchain_support.capabilities);
 
+    m_active_present_mode = present_mode;
+    m_settings_changed = false;
+
     uint32_t imageCount = swapchain_support.capabilities.minImageCount + 1;
+    if (m_requested_image_count != 0) {
+        imageCount = std::max(m_requested_image_count, swapchain_support.capabilities.minImageCount);
+    }
     if (swapchain_support.capabilities.maxImageCount > 0 && imageCount > swapchain_support.capabilities.maxImageCount) {
         imageCount = swapchain_support.capabilities.maxImageCount;
     }
@@ -66,6 +93,11 @@ void swapchain::create_swapchain(VkSwapchainKHR old_swapchain)
     createInfo.imageExtent = m_swapchain_extent;
     createInfo.imageArrayLayers = 1;
     createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    // lets screenshots copy out of the swapchain images
+    m_readback_supported = (swapchain_support.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
+    if (m_readback_supported) {
+        createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
 
     queue_family_indices indices = m_device->find_queue_families(m_device->get_physical_device());
     uint32_t queueFamilyIndices[] = { indices.graphics_family.value(), indices.present_family.value() };
@@ -137,13 +169,26 @@ void swapchain::destroy_image_views()
 
 void swapchain::create_depth_image()
 {
-    if (depth_image == nullptr) {
-        depth_image = new image_handle(m_device);
-    } else {
-        depth_image->destroy_image();
+    // a framebuffer attachment only has to be at least as large as the framebuffer, so the depth buffer
+    // is kept across resizes unless it is too small or wastes most of its memory
+    const bool fits = m_depth_extent.width >= m_swapchain_extent.width && m_depth_extent.height >= m_swapchain_extent.height;
+    const bool wasteful = static_cast<uint64_t>(m_swapchain_extent.width) * m_swapchain_extent.height * 4 < static_cast<uint64_t>(m_depth_extent.width) * m_depth_extent.height;
+    if (depth_image != nullptr && fits && !wasteful) {
+        return;
     }
 
-    depth_image->create_depth_image(m_swapchain_extent.width, m_swapchain_extent.height, find_depth_format());
+    if (depth_image != nullptr) {
+        m_device->defer_destroy([old_depth_image = depth_image]() {
+            delete old_depth_image;
+        });
+    }
+
+    // round up so a drag resize does not reallocate on every step
+    m_depth_extent.width = (m_swapchain_extent.width + depth_granularity - 1) / depth_granularity * depth_granularity;
+    m_depth_extent.height = (m_swapchain_extent.height + depth_granularity - 1) / depth_granularity * depth_granularity;
+
+    depth_image = new image_handle(m_device);
+    depth_image->create_depth_image(m_depth_extent.width, m_depth_extent.height, find_depth_format());
     depth_image->create_view(VK_IMAGE_ASPECT_DEPTH_BIT);
 }
 
@@ -28,7 +28,19 @@ public:
     NODISCARD inline int32_t get_frames_in_flight() const noexcept { return m_frames_in_flight; }
     NODISCARD inline VkSurfaceFormatKHR get_surface_format() const noexcept { return m_swapchain_surface_format; }
     NODISCARD inline VkExtent2D get_extent() const noexcept { return m_swapchain_extent; }
+    NODISCARD const inline std::vector<VkImage>& get_images() const noexcept { return m_swapchain_images; }
     NODISCARD const inline std::vector<VkImageView>& get_image_views() const noexcept { return m_swapchain_image_views; }
+    // VK_IMAGE_USAGE_TRANSFER_SRC_BIT is only set when the surface supports it
+    NODISCARD inline bool get_readback_supported() const noexcept { return m_readback_supported; }
+    // the mode actually in use, it falls back to FIFO when the requested one is unsupported
+    NODISCARD inline VkPresentModeKHR get_present_mode() const noexcept { return m_active_present_mode; }
+    NODISCARD inline uint32_t get_image_count() const noexcept { return static_cast<uint32_t>(m_swapchain_images.size()); }
+
+    // both only take effect once the swapchain is recreated, frame_manager does that on the next end_frame
+    void set_present_mode(VkPresentModeKHR present_mode) noexcept;
+    // 0 requests minImageCount + 1, anything else is clamped to what the surface supports
+    void set_image_count(uint32_t image_count) noexcept;
+    NODISCARD inline bool get_settings_changed() const noexcept { return m_settings_changed; }
 
 private:
     void recreate_swapchain();
@@ -56,9 +68,13 @@ private:
 
     int32_t m_frames_in_flight;
     VkPresentModeKHR m_present_mode;
+    VkPresentModeKHR m_active_present_mode {};
+    uint32_t m_requested_image_count = 0;
+    bool m_settings_changed = false;
 
     VkSwapchainKHR m_swapchain = VK_NULL_HANDLE;
     std::vector<VkImage> m_swapchain_images {};
+    bool m_readback_supported = false;
     std::vector<VkImageView> m_swapchain_image_views {};
     VkSurfaceFormatKHR m_swapchain_surface_format {};
     VkExtent2D m_swapchain_extent {};
@@ -66,6 +82,8 @@ private:
     bool depth_buffer_enabled;
     std::optional<VkFormat> depth_format;
     image_handle* depth_image{nullptr};
+    static constexpr uint32_t depth_granularity = 256;
+    VkExtent2D m_depth_extent {};
 
 };
 
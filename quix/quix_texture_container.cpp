@@ -0,0 +1,497 @@
+#ifndef _QUIX_TEXTURE_CONTAINER_CPP
+#define _QUIX_TEXTURE_CONTAINER_CPP
+
+#include "quix_texture_container.hpp"
+
+namespace quix {
+
+static constexpr std::array<uint8_t, 12> ktx2_identifier = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+static constexpr std::size_t ktx2_header_size = 80;
+static constexpr std::size_t ktx2_level_size = 24;
+
+static constexpr uint32_t make_fourcc(char a, char b, char c, char d) noexcept
+{
+    return static_cast<uint32_t>(a) | (static_cast<uint32_t>(b) << 8) | (static_cast<uint32_t>(c) << 16) | (static_cast<uint32_t>(d) << 24);
+}
+
+static constexpr uint32_t dds_magic = make_fourcc('D', 'D', 'S', ' ');
+static constexpr std::size_t dds_header_size = 128;
+static constexpr std::size_t dds_dx10_header_size = 20;
+static constexpr uint32_t dds_pixel_format_fourcc = 0x4;
+static constexpr uint32_t dds_pixel_format_rgb = 0x40;
+static constexpr uint32_t dds_caps2_cubemap = 0x200;
+static constexpr uint32_t dds_caps2_volume = 0x200000;
+static constexpr uint32_t dds_dx10_misc_cube = 0x4;
+static constexpr uint32_t dds_dx10_dimension_3d = 4;
+
+template <typename Type>
+NODISCARD static Type read_value(const std::vector<uint8_t>& data, std::size_t offset) noexcept
+{
+    Type value {};
+    std::memcpy(&value, data.data() + offset, sizeof(Type));
+    return value;
+}
+
+NODISCARD bool read_binary_file(const char* path, std::vector<uint8_t>& data)
+{
+    FILE* handle = fopen(path, "rb");
+    if (handle == nullptr) {
+        return false;
+    }
+
+    (void)fseek(handle, 0, SEEK_END);
+    const long file_size = ftell(handle);
+    (void)fseek(handle, 0, SEEK_SET);
+
+    data.resize(file_size > 0 ? static_cast<std::size_t>(file_size) : 0);
+    const std::size_t read = fread(data.data(), 1, data.size(), handle);
+    (void)fclose(handle);
+
+    return read == data.size();
+}
+
+static constexpr uint32_t linear_to_srgb_steps = 4096;
+
+void build_rgba8_mip_chain(const uint8_t* pixels, uint32_t width, uint32_t height, std::vector<uint8_t>& out, std::vector<mip_level>& mips)
+{
+    static const auto to_linear = [] {
+        std::array<float, 256> table {};
+        for (uint32_t i = 0; i < 256; i++) {
+            const float c = static_cast<float>(i) / 255.0f;
+            table[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        return table;
+    }();
+    static const auto to_srgb = [] {
+        std::vector<uint8_t> table(linear_to_srgb_steps + 1);
+        for (uint32_t i = 0; i <= linear_to_srgb_steps; i++) {
+            const float c = static_cast<float>(i) / static_cast<float>(linear_to_srgb_steps);
+            const float s = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+            table[i] = static_cast<uint8_t>(std::clamp(s * 255.0f + 0.5f, 0.0f, 255.0f));
+        }
+        return table;
+    }();
+
+    const auto levels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+
+    VkDeviceSize total = 0;
+    uint32_t w = width;
+    uint32_t h = height;
+    for (uint32_t i = 0; i < levels; i++) {
+        const VkDeviceSize size = static_cast<VkDeviceSize>(w) * h * 4;
+        mips.push_back({ w, h, total, size });
+        total += size;
+        w = std::max(w / 2, 1u);
+        h = std::max(h / 2, 1u);
+    }
+
+    out.resize(total);
+    std::memcpy(out.data(), pixels, mips[0].size);
+
+    for (uint32_t i = 1; i < levels; i++) {
+        const auto& src_mip = mips[i - 1];
+        const auto& dst_mip = mips[i];
+        const uint8_t* src = out.data() + src_mip.offset;
+        uint8_t* dst = out.data() + dst_mip.offset;
+
+        for (uint32_t y = 0; y < dst_mip.height; y++) {
+            const uint32_t y0 = std::min(y * 2, src_mip.height - 1);
+            const uint32_t y1 = std::min(y * 2 + 1, src_mip.height - 1);
+            for (uint32_t x = 0; x < dst_mip.width; x++) {
+                const uint32_t x0 = std::min(x * 2, src_mip.width - 1);
+                const uint32_t x1 = std::min(x * 2 + 1, src_mip.width - 1);
+                const uint8_t* texels[4] = {
+                    src + (static_cast<std::size_t>(y0) * src_mip.width + x0) * 4,
+                    src + (static_cast<std::size_t>(y0) * src_mip.width + x1) * 4,
+                    src + (static_cast<std::size_t>(y1) * src_mip.width + x0) * 4,
+                    src + (static_cast<std::size_t>(y1) * src_mip.width + x1) * 4,
+                };
+
+                uint8_t* out_texel = dst + (static_cast<std::size_t>(y) * dst_mip.width + x) * 4;
+                for (uint32_t c = 0; c < 3; c++) {
+                    const float linear = (to_linear[texels[0][c]] + to_linear[texels[1][c]] + to_linear[texels[2][c]] + to_linear[texels[3][c]]) * 0.25f;
+                    out_texel[c] = to_srgb[static_cast<std::size_t>(linear * linear_to_srgb_steps + 0.5f)];
+                }
+                // alpha is linear already
+                out_texel[3] = static_cast<uint8_t>((texels[0][3] + texels[1][3] + texels[2][3] + texels[3][3] + 2) / 4);
+            }
+        }
+    }
+}
+
+NODISCARD std::optional<format_block> get_format_block(VkFormat format) noexcept
+{
+    switch (format) {
+    case VK_FORMAT_R8_UNORM:
+    case VK_FORMAT_R8_SRGB:
+        return format_block { 1, 1, 1 };
+    case VK_FORMAT_R8G8_UNORM:
+    case VK_FORMAT_R8G8_SRGB:
+        return format_block { 1, 1, 2 };
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+        return format_block { 1, 1, 4 };
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+        return format_block { 1, 1, 8 };
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+        return format_block { 1, 1, 16 };
+
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+    case VK_FORMAT_BC4_SNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK:
+    case VK_FORMAT_EAC_R11_UNORM_BLOCK:
+    case VK_FORMAT_EAC_R11_SNORM_BLOCK:
+        return format_block { 4, 4, 8 };
+
+    case VK_FORMAT_BC2_UNORM_BLOCK:
+    case VK_FORMAT_BC2_SRGB_BLOCK:
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC5_SNORM_BLOCK:
+    case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+    case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+    case VK_FORMAT_EAC_R11G11_UNORM_BLOCK:
+    case VK_FORMAT_EAC_R11G11_SNORM_BLOCK:
+        return format_block { 4, 4, 16 };
+
+    default:
+        break;
+    }
+
+    // every astc ldr format is 16 bytes, unorm and srgb alternate for each block size
+    if (format >= VK_FORMAT_ASTC_4x4_UNORM_BLOCK && format <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK) {
+        static constexpr std::array<std::pair<uint32_t, uint32_t>, 14> astc_blocks = { {
+            { 4, 4 }, { 5, 4 }, { 5, 5 }, { 6, 5 }, { 6, 6 }, { 8, 5 }, { 8, 6 },
+            { 8, 8 }, { 10, 5 }, { 10, 6 }, { 10, 8 }, { 10, 10 }, { 12, 10 }, { 12, 12 },
+        } };
+        const auto& [width, height] = astc_blocks[(format - VK_FORMAT_ASTC_4x4_UNORM_BLOCK) / 2];
+        return format_block { width, height, 16 };
+    }
+
+    return std::nullopt;
+}
+
+NODISCARD VkDeviceSize get_mip_size(const format_block& block, uint32_t width, uint32_t height, uint32_t depth) noexcept
+{
+    const VkDeviceSize blocks_x = (width + block.width - 1) / block.width;
+    const VkDeviceSize blocks_y = (height + block.height - 1) / block.height;
+    return blocks_x * blocks_y * depth * block.bytes;
+}
+
+NODISCARD bool is_texture_container(const char* path) noexcept
+{
+    const std::string_view view(path);
+    auto ends_with = [&](std::string_view extension) {
+        if (view.size() < extension.size()) {
+            return false;
+        }
+        const auto tail = view.substr(view.size() - extension.size());
+        return std::equal(tail.begin(), tail.end(), extension.begin(), [](char a, char b) {
+            return std::tolower(static_cast<unsigned char>(a)) == b;
+        });
+    };
+    return ends_with(".ktx2") || ends_with(".dds");
+}
+
+NODISCARD static std::optional<texture_container> parse_ktx2(const char* path, std::vector<uint8_t>&& data)
+{
+    if (data.size() < ktx2_header_size) {
+        spdlog::error("{} is too small to be a ktx2 file", path);
+        return std::nullopt;
+    }
+
+    const auto vk_format = read_value<uint32_t>(data, 12);
+    const auto width = read_value<uint32_t>(data, 20);
+    const auto height = read_value<uint32_t>(data, 24);
+    const auto depth = read_value<uint32_t>(data, 28);
+    const auto layer_count = read_value<uint32_t>(data, 32);
+    const auto face_count = read_value<uint32_t>(data, 36);
+    const auto level_count = read_value<uint32_t>(data, 40);
+    const auto supercompression = read_value<uint32_t>(data, 44);
+
+    if (vk_format == VK_FORMAT_UNDEFINED) {
+        spdlog::error("{} is a basis universal ktx2, transcoding is not supported", path);
+        return std::nullopt;
+    }
+    if (supercompression != 0) {
+        spdlog::error("{} uses ktx2 supercompression scheme {}, only uncompressed level data is supported", path, supercompression);
+        return std::nullopt;
+    }
+
+    texture_container container {};
+    container.format = static_cast<VkFormat>(vk_format);
+    container.extent = { width, std::max(height, 1u), std::max(depth, 1u) };
+    // 0 asks the loader to generate mips, we only upload what is there
+    container.mip_levels = std::max(level_count, 1u);
+    container.array_layers = std::max(layer_count, 1u) * std::max(face_count, 1u);
+    container.cube = face_count == 6;
+
+    const auto block = get_format_block(container.format);
+    if (!block.has_value()) {
+        spdlog::error("{} uses vulkan format {} which the loader does not know", path, vk_format);
+        return std::nullopt;
+    }
+
+    if (data.size() < ktx2_header_size + ktx2_level_size * container.mip_levels) {
+        spdlog::error("{} has a truncated level index", path);
+        return std::nullopt;
+    }
+
+    for (uint32_t level = 0; level < container.mip_levels; level++) {
+        const std::size_t entry = ktx2_header_size + ktx2_level_size * level;
+        const auto offset = read_value<uint64_t>(data, entry);
+        const auto length = read_value<uint64_t>(data, entry + 8);
+
+        const uint32_t mip_width = std::max(container.extent.width >> level, 1u);
+        const uint32_t mip_height = std::max(container.extent.height >> level, 1u);
+        const uint32_t mip_depth = std::max(container.extent.depth >> level, 1u);
+
+        // a level holds every layer and face back to back
+        const VkDeviceSize expected = get_mip_size(*block, mip_width, mip_height, mip_depth) * container.array_layers;
+        if (length < expected || offset + length > data.size()) {
+            spdlog::error("{} level {} is truncated", path, level);
+            return std::nullopt;
+        }
+
+        VkBufferImageCopy region {};
+        region.bufferOffset = offset;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = level;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = container.array_layers;
+        region.imageExtent = { mip_width, mip_height, mip_depth };
+        container.regions.push_back(region);
+    }
+
+    container.data = std::move(data);
+    return container;
+}
+
+NODISCARD static VkFormat dxgi_to_vk_format(uint32_t dxgi_format) noexcept
+{
+    switch (dxgi_format) {
+    case 2:
+        return VK_FORMAT_R32G32B32A32_SFLOAT;
+    case 10:
+        return VK_FORMAT_R16G16B16A16_SFLOAT;
+    case 28:
+        return VK_FORMAT_R8G8B8A8_UNORM;
+    case 29:
+        return VK_FORMAT_R8G8B8A8_SRGB;
+    case 71:
+        return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+    case 72:
+        return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+    case 74:
+        return VK_FORMAT_BC2_UNORM_BLOCK;
+    case 75:
+        return VK_FORMAT_BC2_SRGB_BLOCK;
+    case 77:
+        return VK_FORMAT_BC3_UNORM_BLOCK;
+    case 78:
+        return VK_FORMAT_BC3_SRGB_BLOCK;
+    case 80:
+        return VK_FORMAT_BC4_UNORM_BLOCK;
+    case 81:
+        return VK_FORMAT_BC4_SNORM_BLOCK;
+    case 83:
+        return VK_FORMAT_BC5_UNORM_BLOCK;
+    case 84:
+        return VK_FORMAT_BC5_SNORM_BLOCK;
+    case 87:
+        return VK_FORMAT_B8G8R8A8_UNORM;
+    case 91:
+        return VK_FORMAT_B8G8R8A8_SRGB;
+    case 95:
+        return VK_FORMAT_BC6H_UFLOAT_BLOCK;
+    case 96:
+        return VK_FORMAT_BC6H_SFLOAT_BLOCK;
+    case 98:
+        return VK_FORMAT_BC7_UNORM_BLOCK;
+    case 99:
+        return VK_FORMAT_BC7_SRGB_BLOCK;
+    default:
+        return VK_FORMAT_UNDEFINED;
+    }
+}
+
+NODISCARD static VkFormat dds_legacy_format(const std::vector<uint8_t>& data) noexcept
+{
+    const auto flags = read_value<uint32_t>(data, 80);
+    const auto fourcc = read_value<uint32_t>(data, 84);
+
+    if (flags & dds_pixel_format_fourcc) {
+        switch (fourcc) {
+        case make_fourcc('D', 'X', 'T', '1'):
+            return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+        case make_fourcc('D', 'X', 'T', '2'):
+        case make_fourcc('D', 'X', 'T', '3'):
+            return VK_FORMAT_BC2_UNORM_BLOCK;
+        case make_fourcc('D', 'X', 'T', '4'):
+        case make_fourcc('D', 'X', 'T', '5'):
+            return VK_FORMAT_BC3_UNORM_BLOCK;
+        case make_fourcc('A', 'T', 'I', '1'):
+        case make_fourcc('B', 'C', '4', 'U'):
+            return VK_FORMAT_BC4_UNORM_BLOCK;
+        case make_fourcc('B', 'C', '4', 'S'):
+            return VK_FORMAT_BC4_SNORM_BLOCK;
+        case make_fourcc('A', 'T', 'I', '2'):
+        case make_fourcc('B', 'C', '5', 'U'):
+            return VK_FORMAT_BC5_UNORM_BLOCK;
+        case make_fourcc('B', 'C', '5', 'S'):
+            return VK_FORMAT_BC5_SNORM_BLOCK;
+        default:
+            return VK_FORMAT_UNDEFINED;
+        }
+    }
+
+    if ((flags & dds_pixel_format_rgb) && read_value<uint32_t>(data, 88) == 32) {
+        const auto red_mask = read_value<uint32_t>(data, 92);
+        if (red_mask == 0x000000ff) {
+            return VK_FORMAT_R8G8B8A8_UNORM;
+        }
+        if (red_mask == 0x00ff0000) {
+            return VK_FORMAT_B8G8R8A8_UNORM;
+        }
+    }
+
+    return VK_FORMAT_UNDEFINED;
+}
+
+NODISCARD static std::optional<texture_container> parse_dds(const char* path, std::vector<uint8_t>&& data)
+{
+    if (data.size() < dds_header_size) {
+        spdlog::error("{} is too small to be a dds file", path);
+        return std::nullopt;
+    }
+
+    const auto height = read_value<uint32_t>(data, 12);
+    const auto width = read_value<uint32_t>(data, 16);
+    const auto depth = read_value<uint32_t>(data, 24);
+    const auto mip_count = read_value<uint32_t>(data, 28);
+    const auto fourcc = read_value<uint32_t>(data, 84);
+    const auto caps2 = read_value<uint32_t>(data, 112);
+
+    texture_container container {};
+    container.extent = { width, std::max(height, 1u), 1 };
+    container.mip_levels = std::max(mip_count, 1u);
+    container.array_layers = 1;
+
+    std::size_t data_offset = dds_header_size;
+
+    if (fourcc == make_fourcc('D', 'X', '1', '0')) {
+        if (data.size() < dds_header_size + dds_dx10_header_size) {
+            spdlog::error("{} has a truncated dx10 header", path);
+            return std::nullopt;
+        }
+
+        const auto dxgi_format = read_value<uint32_t>(data, dds_header_size);
+        const auto dimension = read_value<uint32_t>(data, dds_header_size + 4);
+        const auto misc_flags = read_value<uint32_t>(data, dds_header_size + 8);
+        const auto array_size = read_value<uint32_t>(data, dds_header_size + 12);
+
+        container.format = dxgi_to_vk_format(dxgi_format);
+        if (container.format == VK_FORMAT_UNDEFINED) {
+            spdlog::error("{} uses dxgi format {} which the loader does not know", path, dxgi_format);
+            return std::nullopt;
+        }
+
+        container.cube = (misc_flags & dds_dx10_misc_cube) != 0;
+        container.array_layers = std::max(array_size, 1u) * (container.cube ? 6 : 1);
+        if (dimension == dds_dx10_dimension_3d) {
+            container.extent.depth = std::max(depth, 1u);
+        }
+
+        data_offset += dds_dx10_header_size;
+    } else {
+        container.format = dds_legacy_format(data);
+        if (container.format == VK_FORMAT_UNDEFINED) {
+            spdlog::error("{} uses a legacy dds pixel format the loader does not know", path);
+            return std::nullopt;
+        }
+
+        container.cube = (caps2 & dds_caps2_cubemap) != 0;
+        container.array_layers = container.cube ? 6 : 1;
+        if (caps2 & dds_caps2_volume) {
+            container.extent.depth = std::max(depth, 1u);
+        }
+    }
+
+    const auto block = get_format_block(container.format);
+    quix_assert(block.has_value(), "every dds format maps to a known block");
+
+    // dds stores every mip of a layer before the next layer. the offsets start at the payload, with a dx10 header
+    // it begins at byte 148, which would leave every region off the 8 and 16 byte block alignment copies need
+    VkDeviceSize offset = data_offset;
+    for (uint32_t layer = 0; layer < container.array_layers; layer++) {
+        for (uint32_t level = 0; level < container.mip_levels; level++) {
+            const uint32_t mip_width = std::max(container.extent.width >> level, 1u);
+            const uint32_t mip_height = std::max(container.extent.height >> level, 1u);
+            const uint32_t mip_depth = std::max(container.extent.depth >> level, 1u);
+            const VkDeviceSize size = get_mip_size(*block, mip_width, mip_height, mip_depth);
+
+            if (offset + size > data.size()) {
+                spdlog::error("{} layer {} mip {} is truncated", path, layer, level);
+                return std::nullopt;
+            }
+
+            VkBufferImageCopy region {};
+            region.bufferOffset = offset - data_offset;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel = level;
+            region.imageSubresource.baseArrayLayer = layer;
+            region.imageSubresource.layerCount = 1;
+            region.imageExtent = { mip_width, mip_height, mip_depth };
+            container.regions.push_back(region);
+
+            offset += size;
+        }
+    }
+
+    data.erase(data.begin(), data.begin() + static_cast<std::ptrdiff_t>(data_offset));
+    container.data = std::move(data);
+    return container;
+}
+
+NODISCARD std::optional<texture_container> load_texture_container(const char* path)
+{
+    std::vector<uint8_t> data {};
+    if (!read_binary_file(path, data)) {
+        spdlog::error("failed to read {}", path);
+        return std::nullopt;
+    }
+
+    return parse_texture_container(path, std::move(data));
+}
+
+NODISCARD std::optional<texture_container> parse_texture_container(const char* path, std::vector<uint8_t>&& data)
+{
+    if (data.size() >= ktx2_identifier.size() && std::equal(ktx2_identifier.begin(), ktx2_identifier.end(), data.begin())) {
+        return parse_ktx2(path, std::move(data));
+    }
+
+    if (data.size() >= sizeof(uint32_t) && read_value<uint32_t>(data, 0) == dds_magic) {
+        return parse_dds(path, std::move(data));
+    }
+
+    spdlog::error("{} is neither a ktx2 nor a dds file", path);
+    return std::nullopt;
+}
+
+} // namespace quix
+
+#endif // _QUIX_TEXTURE_CONTAINER_CPP
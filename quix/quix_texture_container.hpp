@@ -0,0 +1,58 @@
+#ifndef _QUIX_TEXTURE_CONTAINER_HPP
+#define _QUIX_TEXTURE_CONTAINER_HPP
+
+namespace quix {
+
+// a texel block, 1x1 for uncompressed formats
+struct format_block {
+    uint32_t width {};
+    uint32_t height {};
+    uint32_t bytes {};
+};
+
+// std::nullopt for formats the loaders do not know the layout of
+NODISCARD std::optional<format_block> get_format_block(VkFormat format) noexcept;
+
+// bytes of one mip of one layer, rounded up to whole blocks
+NODISCARD VkDeviceSize get_mip_size(const format_block& block, uint32_t width, uint32_t height, uint32_t depth) noexcept;
+
+// one mip of a tightly packed chain, finest first
+struct mip_level {
+    uint32_t width {};
+    uint32_t height {};
+    VkDeviceSize offset {};
+    VkDeviceSize size {};
+};
+
+// box filters rgba8 srgb pixels down to 1x1 in linear space so the mips do not darken,
+// out holds every mip back to back
+void build_rgba8_mip_chain(const uint8_t* pixels, uint32_t width, uint32_t height, std::vector<uint8_t>& out, std::vector<mip_level>& mips);
+
+NODISCARD bool read_binary_file(const char* path, std::vector<uint8_t>& data);
+
+// a texture file with its prebuilt mips, laid out the way vkCmdCopyBufferToImage wants it
+struct texture_container {
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    VkExtent3D extent {};
+    uint32_t mip_levels {};
+    // faces count as layers, cube is set when they come in groups of 6
+    uint32_t array_layers {};
+    bool cube = false;
+
+    std::vector<uint8_t> data {};
+    // bufferOffsets are relative to data
+    std::vector<VkBufferImageCopy> regions {};
+};
+
+// true for the .ktx2 and .dds extensions
+NODISCARD bool is_texture_container(const char* path) noexcept;
+
+// ktx2 without supercompression and dds with legacy fourcc or dx10 headers.
+// logs why and returns std::nullopt when the file can not be used as is
+NODISCARD std::optional<texture_container> load_texture_container(const char* path);
+// same as load_texture_container for a file that is already in memory, path is only used in logs
+NODISCARD std::optional<texture_container> parse_texture_container(const char* path, std::vector<uint8_t>&& data);
+
+} // namespace quix
+
+#endif // _QUIX_TEXTURE_CONTAINER_HPP
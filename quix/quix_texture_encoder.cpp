@@ -0,0 +1,619 @@
+#ifndef _QUIX_TEXTURE_ENCODER_CPP
+#define _QUIX_TEXTURE_ENCODER_CPP
+
+#include "quix_texture_encoder.hpp"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define QUIX_ENCODER_X86 1
+#include <immintrin.h>
+#endif
+
+namespace quix {
+
+static constexpr uint32_t cache_magic = 0x43425851; // "QXBC"
+static constexpr uint32_t cache_version = 1;
+
+struct cache_header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t source_hash;
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mip_levels;
+};
+
+// a 4x4 block split by channel so the index search can run over 4 or 8 texels at once
+struct block_texels {
+    alignas(32) std::array<std::array<int32_t, 16>, 4> channels {};
+};
+
+// indices[i] = clamp(round(dot(texel - base, axis) * scale), 0, steps)
+using quantize_function = void (*)(const block_texels& block, const std::array<int32_t, 4>& base, const std::array<int32_t, 4>& axis,
+    float scale, int32_t steps, std::array<uint8_t, 16>& indices);
+
+static void quantize_scalar(const block_texels& block, const std::array<int32_t, 4>& base, const std::array<int32_t, 4>& axis,
+    float scale, int32_t steps, std::array<uint8_t, 16>& indices)
+{
+    for (uint32_t i = 0; i < 16; i++) {
+        int32_t dot = 0;
+        for (uint32_t c = 0; c < 4; c++) {
+            dot += (block.channels[c][i] - base[c]) * axis[c];
+        }
+        const auto index = static_cast<int32_t>(std::lrint(static_cast<float>(dot) * scale));
+        indices[i] = static_cast<uint8_t>(std::clamp(index, 0, steps));
+    }
+}
+
+#ifdef QUIX_ENCODER_X86
+static __attribute__((target("sse4.1"))) void quantize_sse41(const block_texels& block, const std::array<int32_t, 4>& base, const std::array<int32_t, 4>& axis,
+    float scale, int32_t steps, std::array<uint8_t, 16>& indices)
+{
+    const __m128 scale_v = _mm_set1_ps(scale);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i steps_v = _mm_set1_epi32(steps);
+
+    alignas(16) std::array<int32_t, 16> result {};
+    for (uint32_t i = 0; i < 16; i += 4) {
+        __m128i dot = zero;
+        for (uint32_t c = 0; c < 4; c++) {
+            const __m128i texels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block.channels[c].data() + i));
+            const __m128i offset = _mm_sub_epi32(texels, _mm_set1_epi32(base[c]));
+            dot = _mm_add_epi32(dot, _mm_mullo_epi32(offset, _mm_set1_epi32(axis[c])));
+        }
+
+        __m128i index = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(dot), scale_v));
+        index = _mm_min_epi32(_mm_max_epi32(index, zero), steps_v);
+        _mm_store_si128(reinterpret_cast<__m128i*>(result.data() + i), index);
+    }
+
+    for (uint32_t i = 0; i < 16; i++) {
+        indices[i] = static_cast<uint8_t>(result[i]);
+    }
+}
+
+static __attribute__((target("avx2"))) void quantize_avx2(const block_texels& block, const std::array<int32_t, 4>& base, const std::array<int32_t, 4>& axis,
+    float scale, int32_t steps, std::array<uint8_t, 16>& indices)
+{
+    const __m256 scale_v = _mm256_set1_ps(scale);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i steps_v = _mm256_set1_epi32(steps);
+
+    alignas(32) std::array<int32_t, 16> result {};
+    for (uint32_t i = 0; i < 16; i += 8) {
+        __m256i dot = zero;
+        for (uint32_t c = 0; c < 4; c++) {
+            const __m256i texels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block.channels[c].data() + i));
+            const __m256i offset = _mm256_sub_epi32(texels, _mm256_set1_epi32(base[c]));
+            dot = _mm256_add_epi32(dot, _mm256_mullo_epi32(offset, _mm256_set1_epi32(axis[c])));
+        }
+
+        __m256i index = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(dot), scale_v));
+        index = _mm256_min_epi32(_mm256_max_epi32(index, zero), steps_v);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(result.data() + i), index);
+    }
+
+    for (uint32_t i = 0; i < 16; i++) {
+        indices[i] = static_cast<uint8_t>(result[i]);
+    }
+}
+#endif
+
+NODISCARD static quantize_function select_quantize() noexcept
+{
+#ifdef QUIX_ENCODER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return quantize_avx2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return quantize_sse41;
+    }
+#endif
+    return quantize_scalar;
+}
+
+static const quantize_function quantize = select_quantize();
+
+static void load_block(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t block_x, uint32_t block_y, block_texels& block) noexcept
+{
+    // edge blocks repeat the last row and column
+    for (uint32_t y = 0; y < 4; y++) {
+        const uint32_t py = std::min(block_y * 4 + y, height - 1);
+        for (uint32_t x = 0; x < 4; x++) {
+            const uint32_t px = std::min(block_x * 4 + x, width - 1);
+            const uint8_t* texel = pixels + (static_cast<std::size_t>(py) * width + px) * 4;
+            for (uint32_t c = 0; c < 4; c++) {
+                block.channels[c][y * 4 + x] = texel[c];
+            }
+        }
+    }
+}
+
+// endpoints at the extremes of the block's principal axis over the first channel_count channels
+static void find_endpoints(const block_texels& block, uint32_t channel_count, std::array<float, 4>& low, std::array<float, 4>& high) noexcept
+{
+    std::array<float, 4> mean {};
+    std::array<float, 4> min_value { 255.0f, 255.0f, 255.0f, 255.0f };
+    std::array<float, 4> max_value {};
+    for (uint32_t c = 0; c < channel_count; c++) {
+        for (uint32_t i = 0; i < 16; i++) {
+            const auto value = static_cast<float>(block.channels[c][i]);
+            mean[c] += value;
+            min_value[c] = std::min(min_value[c], value);
+            max_value[c] = std::max(max_value[c], value);
+        }
+        mean[c] /= 16.0f;
+    }
+
+    std::array<float, 16> covariance {};
+    for (uint32_t i = 0; i < 16; i++) {
+        std::array<float, 4> offset {};
+        for (uint32_t c = 0; c < channel_count; c++) {
+            offset[c] = static_cast<float>(block.channels[c][i]) - mean[c];
+        }
+        for (uint32_t a = 0; a < channel_count; a++) {
+            for (uint32_t b = 0; b < channel_count; b++) {
+                covariance[a * 4 + b] += offset[a] * offset[b];
+            }
+        }
+    }
+
+    // power iteration from the bounding box diagonal
+    std::array<float, 4> axis {};
+    for (uint32_t c = 0; c < channel_count; c++) {
+        axis[c] = max_value[c] - min_value[c];
+    }
+    for (uint32_t iteration = 0; iteration < 8; iteration++) {
+        std::array<float, 4> next {};
+        float largest = 0.0f;
+        for (uint32_t a = 0; a < channel_count; a++) {
+            for (uint32_t b = 0; b < channel_count; b++) {
+                next[a] += covariance[a * 4 + b] * axis[b];
+            }
+            largest = std::max(largest, std::abs(next[a]));
+        }
+        if (largest < 1e-6f) {
+            break;
+        }
+        for (uint32_t c = 0; c < channel_count; c++) {
+            axis[c] = next[c] / largest;
+        }
+    }
+
+    float length = 0.0f;
+    for (uint32_t c = 0; c < channel_count; c++) {
+        length += axis[c] * axis[c];
+    }
+    length = std::sqrt(length);
+
+    low = mean;
+    high = mean;
+    if (length < 1e-6f) {
+        return;
+    }
+
+    float t_min = std::numeric_limits<float>::max();
+    float t_max = std::numeric_limits<float>::lowest();
+    for (uint32_t i = 0; i < 16; i++) {
+        float t = 0.0f;
+        for (uint32_t c = 0; c < channel_count; c++) {
+            t += (static_cast<float>(block.channels[c][i]) - mean[c]) * axis[c] / length;
+        }
+        t_min = std::min(t_min, t);
+        t_max = std::max(t_max, t);
+    }
+
+    for (uint32_t c = 0; c < channel_count; c++) {
+        low[c] = std::clamp(mean[c] + axis[c] / length * t_min, 0.0f, 255.0f);
+        high[c] = std::clamp(mean[c] + axis[c] / length * t_max, 0.0f, 255.0f);
+    }
+}
+
+NODISCARD static uint16_t to_565(const std::array<float, 4>& color) noexcept
+{
+    const auto r = static_cast<uint16_t>(std::lrint(color[0] * 31.0f / 255.0f));
+    const auto g = static_cast<uint16_t>(std::lrint(color[1] * 63.0f / 255.0f));
+    const auto b = static_cast<uint16_t>(std::lrint(color[2] * 31.0f / 255.0f));
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+NODISCARD static std::array<int32_t, 4> from_565(uint16_t color) noexcept
+{
+    const int32_t r = (color >> 11) & 31;
+    const int32_t g = (color >> 5) & 63;
+    const int32_t b = color & 31;
+    return { (r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2), 0 };
+}
+
+// 8 bytes, always in 4 color mode so it doubles as the color half of bc3
+static void encode_bc1_color(const block_texels& block, uint8_t* out) noexcept
+{
+    std::array<float, 4> low {};
+    std::array<float, 4> high {};
+    find_endpoints(block, 3, low, high);
+
+    uint16_t color0 = to_565(high);
+    uint16_t color1 = to_565(low);
+    if (color0 < color1) {
+        std::swap(color0, color1);
+    }
+
+    uint32_t packed = 0;
+    if (color0 != color1) {
+        const auto endpoint0 = from_565(color0);
+        const auto endpoint1 = from_565(color1);
+        const std::array<int32_t, 4> axis { endpoint1[0] - endpoint0[0], endpoint1[1] - endpoint0[1], endpoint1[2] - endpoint0[2], 0 };
+        const int32_t length = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+
+        std::array<uint8_t, 16> indices {};
+        quantize(block, endpoint0, axis, 3.0f / static_cast<float>(length), 3, indices);
+
+        // position along the line to bc1 palette order, 2 and 3 are the interpolated colors
+        static constexpr std::array<uint32_t, 4> palette_order = { 0, 2, 3, 1 };
+        for (uint32_t i = 0; i < 16; i++) {
+            packed |= palette_order[indices[i]] << (i * 2);
+        }
+    }
+
+    std::memcpy(out, &color0, sizeof(color0));
+    std::memcpy(out + 2, &color1, sizeof(color1));
+    std::memcpy(out + 4, &packed, sizeof(packed));
+}
+
+// 8 bytes of bc4 over the alpha channel, always in 8 value mode
+static void encode_bc4_alpha(const block_texels& block, uint8_t* out) noexcept
+{
+    const auto [min_alpha, max_alpha] = std::minmax_element(block.channels[3].begin(), block.channels[3].end());
+
+    out[0] = static_cast<uint8_t>(*max_alpha);
+    out[1] = static_cast<uint8_t>(*min_alpha);
+
+    uint64_t packed = 0;
+    if (*max_alpha != *min_alpha) {
+        const int32_t range = *max_alpha - *min_alpha;
+
+        std::array<uint8_t, 16> indices {};
+        quantize(block, { 0, 0, 0, *min_alpha }, { 0, 0, 0, range }, 7.0f / static_cast<float>(range * range), 7, indices);
+
+        for (uint32_t i = 0; i < 16; i++) {
+            // 0 is max, 1 is min, 2 to 7 step from max towards min
+            const uint32_t t = indices[i];
+            const uint64_t index = t == 7 ? 0 : (t == 0 ? 1 : 8 - t);
+            packed |= index << (i * 3);
+        }
+    }
+
+    std::memcpy(out + 2, &packed, 6);
+}
+
+struct bit_writer {
+    std::array<uint64_t, 2> bits {};
+    uint32_t position = 0;
+
+    void write(uint32_t value, uint32_t count) noexcept
+    {
+        for (uint32_t i = 0; i < count; i++, position++) {
+            bits[position / 64] |= static_cast<uint64_t>((value >> i) & 1) << (position % 64);
+        }
+    }
+};
+
+// 7 bits per channel plus a shared lsb per endpoint, picks the lsb that lands closer
+static void quantize_bc7_endpoint(const std::array<float, 4>& color, std::array<int32_t, 4>& quantized, uint32_t& pbit, std::array<int32_t, 4>& expanded) noexcept
+{
+    float best_error = std::numeric_limits<float>::max();
+    for (uint32_t p = 0; p < 2; p++) {
+        std::array<int32_t, 4> candidate {};
+        std::array<int32_t, 4> candidate_expanded {};
+        float error = 0.0f;
+        for (uint32_t c = 0; c < 4; c++) {
+            candidate[c] = std::clamp(static_cast<int32_t>(std::lrint((color[c] - static_cast<float>(p)) / 2.0f)), 0, 127);
+            candidate_expanded[c] = (candidate[c] << 1) | static_cast<int32_t>(p);
+            const float difference = static_cast<float>(candidate_expanded[c]) - color[c];
+            error += difference * difference;
+        }
+        if (error < best_error) {
+            best_error = error;
+            quantized = candidate;
+            expanded = candidate_expanded;
+            pbit = p;
+        }
+    }
+}
+
+// 16 bytes, mode 6 is a single rgba subset with 4 bit indices
+static void encode_bc7_mode6(const block_texels& block, uint8_t* out) noexcept
+{
+    std::array<float, 4> low {};
+    std::array<float, 4> high {};
+    find_endpoints(block, 4, low, high);
+
+    std::array<int32_t, 4> quantized0 {};
+    std::array<int32_t, 4> quantized1 {};
+    std::array<int32_t, 4> endpoint0 {};
+    std::array<int32_t, 4> endpoint1 {};
+    uint32_t pbit0 = 0;
+    uint32_t pbit1 = 0;
+    quantize_bc7_endpoint(low, quantized0, pbit0, endpoint0);
+    quantize_bc7_endpoint(high, quantized1, pbit1, endpoint1);
+
+    std::array<uint8_t, 16> indices {};
+    std::array<int32_t, 4> axis {};
+    int32_t length = 0;
+    for (uint32_t c = 0; c < 4; c++) {
+        axis[c] = endpoint1[c] - endpoint0[c];
+        length += axis[c] * axis[c];
+    }
+    if (length > 0) {
+        quantize(block, endpoint0, axis, 15.0f / static_cast<float>(length), 15, indices);
+    }
+
+    // the first index only stores 3 bits so its top bit has to be 0
+    if (indices[0] >= 8) {
+        std::swap(quantized0, quantized1);
+        std::swap(pbit0, pbit1);
+        for (auto& index : indices) {
+            index = static_cast<uint8_t>(15 - index);
+        }
+    }
+
+    bit_writer writer {};
+    writer.write(1 << 6, 7);
+    for (uint32_t c = 0; c < 4; c++) {
+        writer.write(static_cast<uint32_t>(quantized0[c]), 7);
+        writer.write(static_cast<uint32_t>(quantized1[c]), 7);
+    }
+    writer.write(pbit0, 1);
+    writer.write(pbit1, 1);
+    writer.write(indices[0], 3);
+    for (uint32_t i = 1; i < 16; i++) {
+        writer.write(indices[i], 4);
+    }
+
+    std::memcpy(out, writer.bits.data(), 16);
+}
+
+NODISCARD VkFormat get_compressed_format(texture_compression compression, bool srgb) noexcept
+{
+    switch (compression) {
+    case texture_compression::bc1:
+        return srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    case texture_compression::bc3:
+        return srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+    case texture_compression::bc7:
+        return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+    case texture_compression::none:
+        break;
+    }
+    return srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+}
+
+NODISCARD std::vector<uint8_t> encode_bc(const uint8_t* pixels, std::span<const mip_level> mips, texture_compression compression, std::vector<mip_level>& encoded_mips)
+{
+    quix_assert(compression != texture_compression::none, "encode_bc needs a bc format");
+
+    const uint32_t block_bytes = compression == texture_compression::bc1 ? 8 : 16;
+
+    struct block_row {
+        uint32_t mip;
+        uint32_t row;
+    };
+
+    std::vector<block_row> rows {};
+    VkDeviceSize total = 0;
+    encoded_mips.clear();
+    for (uint32_t mip = 0; mip < mips.size(); mip++) {
+        const uint32_t blocks_x = (mips[mip].width + 3) / 4;
+        const uint32_t blocks_y = (mips[mip].height + 3) / 4;
+        const VkDeviceSize size = static_cast<VkDeviceSize>(blocks_x) * blocks_y * block_bytes;
+
+        encoded_mips.push_back({ mips[mip].width, mips[mip].height, total, size });
+        total += size;
+
+        for (uint32_t row = 0; row < blocks_y; row++) {
+            rows.push_back({ mip, row });
+        }
+    }
+
+    std::vector<uint8_t> encoded(total);
+    std::atomic<std::size_t> next_row = 0;
+
+    auto encode_rows = [&]() {
+        block_texels block {};
+        for (auto job = next_row.fetch_add(1, std::memory_order_relaxed); job < rows.size(); job = next_row.fetch_add(1, std::memory_order_relaxed)) {
+            const auto [mip, row] = rows[job];
+            const auto& source = mips[mip];
+            const uint32_t blocks_x = (source.width + 3) / 4;
+
+            uint8_t* out = encoded.data() + encoded_mips[mip].offset + static_cast<VkDeviceSize>(row) * blocks_x * block_bytes;
+            for (uint32_t block_x = 0; block_x < blocks_x; block_x++, out += block_bytes) {
+                load_block(pixels + source.offset, source.width, source.height, block_x, row, block);
+
+                switch (compression) {
+                case texture_compression::bc1:
+                    encode_bc1_color(block, out);
+                    break;
+                case texture_compression::bc3:
+                    encode_bc4_alpha(block, out);
+                    encode_bc1_color(block, out + 8);
+                    break;
+                case texture_compression::bc7:
+                    encode_bc7_mode6(block, out);
+                    break;
+                case texture_compression::none:
+                    break;
+                }
+            }
+        }
+    };
+
+    const auto worker_count = static_cast<uint32_t>(std::min<std::size_t>(std::max(std::thread::hardware_concurrency(), 1u), rows.size()));
+    std::vector<std::thread> workers {};
+    for (uint32_t i = 1; i < worker_count; i++) {
+        workers.emplace_back(encode_rows);
+    }
+    encode_rows();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    return encoded;
+}
+
+NODISCARD static uint64_t hash_bytes(const std::vector<uint8_t>& data) noexcept
+{
+    // fnv-1a
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (uint8_t byte : data) {
+        hash ^= byte;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+NODISCARD static const char* get_cache_extension(texture_compression compression) noexcept
+{
+    switch (compression) {
+    case texture_compression::bc1:
+        return ".bc1";
+    case texture_compression::bc3:
+        return ".bc3";
+    case texture_compression::bc7:
+        return ".bc7";
+    case texture_compression::none:
+        break;
+    }
+    return ".rgba";
+}
+
+NODISCARD static texture_container make_container(VkFormat format, uint32_t width, uint32_t height, std::vector<uint8_t>&& data, const std::vector<mip_level>& mips)
+{
+    texture_container container {};
+    container.format = format;
+    container.extent = { width, height, 1 };
+    container.mip_levels = static_cast<uint32_t>(mips.size());
+    container.array_layers = 1;
+    container.data = std::move(data);
+
+    for (uint32_t mip = 0; mip < mips.size(); mip++) {
+        VkBufferImageCopy region {};
+        region.bufferOffset = mips[mip].offset;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = mip;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = { mips[mip].width, mips[mip].height, 1 };
+        container.regions.push_back(region);
+    }
+
+    return container;
+}
+
+NODISCARD static std::optional<texture_container> load_cache(const std::string& cache_path, const cache_header& expected)
+{
+    std::vector<uint8_t> data {};
+    if (!read_binary_file(cache_path.c_str(), data) || data.size() < sizeof(cache_header)) {
+        return std::nullopt;
+    }
+
+    cache_header header {};
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (header.magic != expected.magic || header.version != expected.version || header.source_hash != expected.source_hash
+        || header.format != expected.format || header.width != expected.width || header.height != expected.height
+        || header.mip_levels != expected.mip_levels) {
+        return std::nullopt;
+    }
+
+    const auto block = get_format_block(static_cast<VkFormat>(header.format));
+    if (!block.has_value()) {
+        return std::nullopt;
+    }
+
+    std::vector<mip_level> mips {};
+    VkDeviceSize total = 0;
+    for (uint32_t mip = 0; mip < header.mip_levels; mip++) {
+        const uint32_t width = std::max(header.width >> mip, 1u);
+        const uint32_t height = std::max(header.height >> mip, 1u);
+        const VkDeviceSize size = get_mip_size(*block, width, height, 1);
+        mips.push_back({ width, height, total, size });
+        total += size;
+    }
+
+    if (data.size() - sizeof(cache_header) != total) {
+        return std::nullopt;
+    }
+
+    data.erase(data.begin(), data.begin() + sizeof(cache_header));
+    return make_container(static_cast<VkFormat>(header.format), header.width, header.height, std::move(data), mips);
+}
+
+static void store_cache(const std::string& cache_path, const cache_header& header, const std::vector<uint8_t>& data)
+{
+    FILE* handle = fopen(cache_path.c_str(), "wb");
+    if (handle == nullptr) {
+        spdlog::warn("failed to write texture cache {}", cache_path);
+        return;
+    }
+
+    (void)fwrite(&header, sizeof(header), 1, handle);
+    (void)fwrite(data.data(), 1, data.size(), handle);
+    (void)fclose(handle);
+}
+
+NODISCARD std::optional<texture_container> load_compressed_texture(const char* path, texture_compression compression, bool generate_mips)
+{
+    std::vector<uint8_t> source {};
+    if (!read_binary_file(path, source)) {
+        spdlog::error("failed to read {}", path);
+        return std::nullopt;
+    }
+
+    int width {};
+    int height {};
+    int channels {};
+    if (stbi_info_from_memory(source.data(), static_cast<int>(source.size()), &width, &height, &channels) == 0) {
+        spdlog::error("failed to load image {}", path);
+        return std::nullopt;
+    }
+
+    cache_header header {};
+    header.magic = cache_magic;
+    header.version = cache_version;
+    header.source_hash = hash_bytes(source);
+    header.format = get_compressed_format(compression, true);
+    header.width = static_cast<uint32_t>(width);
+    header.height = static_cast<uint32_t>(height);
+    header.mip_levels = generate_mips ? static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1 : 1;
+
+    const std::string cache_path = std::string(path) + get_cache_extension(compression);
+    if (auto cached = load_cache(cache_path, header)) {
+        return cached;
+    }
+
+    stbi_uc* pixels = stbi_load_from_memory(source.data(), static_cast<int>(source.size()), &width, &height, &channels, STBI_rgb_alpha);
+    if (pixels == nullptr) {
+        spdlog::error("failed to load image {}", path);
+        return std::nullopt;
+    }
+
+    std::vector<uint8_t> chain {};
+    std::vector<mip_level> mips {};
+    if (generate_mips) {
+        build_rgba8_mip_chain(pixels, header.width, header.height, chain, mips);
+    } else {
+        mips.push_back({ header.width, header.height, 0, static_cast<VkDeviceSize>(header.width) * header.height * 4 });
+    }
+
+    std::vector<mip_level> encoded_mips {};
+    auto encoded = encode_bc(generate_mips ? chain.data() : pixels, mips, compression, encoded_mips);
+    stbi_image_free(pixels);
+
+    store_cache(cache_path, header, encoded);
+
+    return make_container(static_cast<VkFormat>(header.format), header.width, header.height, std::move(encoded), encoded_mips);
+}
+
+} // namespace quix
+
+#endif // _QUIX_TEXTURE_ENCODER_CPP
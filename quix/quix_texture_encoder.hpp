@@ -0,0 +1,29 @@
+#ifndef _QUIX_TEXTURE_ENCODER_HPP
+#define _QUIX_TEXTURE_ENCODER_HPP
+
+#include "quix_texture_container.hpp"
+
+namespace quix {
+
+// bc1 is opaque rgb at 4 bits per texel, bc3 adds interpolated alpha and bc7 (mode 6 only)
+// is higher quality rgba, both at 8 bits per texel
+enum class texture_compression : uint32_t {
+    none,
+    bc1,
+    bc3,
+    bc7,
+};
+
+NODISCARD VkFormat get_compressed_format(texture_compression compression, bool srgb) noexcept;
+
+// encodes every mip of a tightly packed rgba8 chain, block rows are spread over worker threads
+// and the index search uses avx2 or sse4.1 when the cpu has them
+NODISCARD std::vector<uint8_t> encode_bc(const uint8_t* pixels, std::span<const mip_level> mips, texture_compression compression, std::vector<mip_level>& encoded_mips);
+
+// decodes a jpeg/png, optionally builds its mips and encodes them. the result is cached next to the
+// source as <path>.bc1/.bc3/.bc7 and reused as long as the hash of the source file matches
+NODISCARD std::optional<texture_container> load_compressed_texture(const char* path, texture_compression compression, bool generate_mips);
+
+} // namespace quix
+
+#endif // _QUIX_TEXTURE_ENCODER_HPP
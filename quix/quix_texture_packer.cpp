@@ -0,0 +1,320 @@
+#ifndef _QUIX_TEXTURE_PACKER_CPP
+#define _QUIX_TEXTURE_PACKER_CPP
+
+#include "quix_texture_packer.hpp"
+
+#include "quix_device.hpp"
+#include "quix_instance.hpp"
+#include "quix_texture_container.hpp"
+#include "quix_upload.hpp"
+
+namespace quix {
+
+texture_packer::texture_packer(weakref<device> p_device, const texture_packer_settings& settings)
+    : m_device(std::move(p_device))
+    , m_settings(settings)
+{
+    m_settings.atlas_size = std::min(m_settings.atlas_size, m_device->get_max_image_dimension_2d());
+    quix_assert(m_settings.max_atlas_entry + 2 * m_settings.atlas_padding <= m_settings.atlas_size, "padded atlas entries do not fit in an atlas page");
+}
+
+NODISCARD uint32_t texture_packer::add(const char* filepath)
+{
+    int texture_width {};
+    int texture_height {};
+    int texture_channels {};
+    stbi_uc* pixels = stbi_load(filepath, &texture_width, &texture_height, &texture_channels, STBI_rgb_alpha);
+    quix_assert(pixels != nullptr, fmt::format("failed to load {}", filepath));
+
+    const uint32_t texture = add(pixels, texture_width, texture_height, VK_FORMAT_R8G8B8A8_SRGB, filepath);
+
+    stbi_image_free(pixels);
+
+    return texture;
+}
+
+NODISCARD uint32_t texture_packer::add(const uint8_t* pixels, uint32_t width, uint32_t height, VkFormat format, const char* name)
+{
+    quix_assert(!m_built, "texture packer is already built, reset it before adding textures");
+
+    const auto block = get_format_block(format);
+    quix_assert(block.has_value() && block->width == 1 && block->height == 1, "only uncompressed formats can be packed");
+    quix_assert(width > 0 && height > 0, "texture is empty");
+    quix_assert(width <= m_device->get_max_image_dimension_2d() && height <= m_device->get_max_image_dimension_2d(), "texture is larger than maxImageDimension2D");
+
+    entry texture {};
+    texture.name = name != nullptr ? name : "";
+    texture.format = format;
+    texture.width = width;
+    texture.height = height;
+    texture.pixels.assign(pixels, pixels + static_cast<std::size_t>(width) * height * block->bytes);
+    texture.atlas = width <= m_settings.max_atlas_entry && height <= m_settings.max_atlas_entry;
+
+    m_entries.push_back(std::move(texture));
+    m_textures.emplace_back();
+    return static_cast<uint32_t>(m_entries.size() - 1);
+}
+
+void texture_packer::build(instance* inst)
+{
+    quix_assert(!m_built, "texture packer is already built, reset it first");
+
+    std::vector<pending_image> pending {};
+    pack_arrays(pending);
+    pack_atlases(pending);
+
+    // every image goes into the same batch, one submission for all of them
+    m_images.reserve(pending.size());
+    for (const auto& image : pending) {
+        m_images.emplace_back(m_device);
+        upload(image, m_images.back(), inst);
+    }
+    inst->get_upload_manager()->flush();
+
+    for (auto& texture : m_entries) {
+        std::vector<uint8_t>().swap(texture.pixels);
+    }
+    m_built = true;
+
+    spdlog::info("packed {} textures into {} images, {} atlas texels unused", m_entries.size(), m_images.size(), m_atlas_waste);
+}
+
+void texture_packer::reset()
+{
+    m_images.clear();
+    m_entries.clear();
+    m_textures.clear();
+    m_atlas_waste = 0;
+    m_built = false;
+}
+
+NODISCARD const packed_texture& texture_packer::get_texture(uint32_t texture) const
+{
+    quix_assert(m_built && texture < m_textures.size(), "texture is out of range or the packer is not built");
+    return m_textures[texture];
+}
+
+NODISCARD image_handle& texture_packer::get_image(uint32_t image)
+{
+    quix_assert(image < m_images.size(), "packed image is out of range");
+    return m_images[image];
+}
+
+NODISCARD VkImageView texture_packer::get_view(uint32_t image)
+{
+    image_view_key key {};
+    key.type = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+    return get_image(image).get_view(key);
+}
+
+NODISCARD VkDescriptorImageInfo texture_packer::get_descriptor_info(uint32_t image, VkSampler sampler)
+{
+    VkDescriptorImageInfo info {};
+    info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    info.imageView = get_view(image);
+    info.sampler = sampler;
+    return info;
+}
+
+void texture_packer::pack_arrays(std::vector<pending_image>& images)
+{
+    // ordered so the same set of textures always packs into the same images
+    std::map<std::tuple<VkFormat, uint32_t, uint32_t>, std::vector<uint32_t>> groups {};
+    for (uint32_t i = 0; i < m_entries.size(); i++) {
+        const auto& texture = m_entries[i];
+        if (!texture.atlas) {
+            groups[{ texture.format, texture.width, texture.height }].push_back(i);
+        }
+    }
+
+    const uint32_t max_layers = m_device->get_max_image_array_layers();
+    for (const auto& [key, members] : groups) {
+        for (std::size_t first = 0; first < members.size(); first += max_layers) {
+            pending_image image {};
+            image.format = std::get<0>(key);
+            image.extent = { std::get<1>(key), std::get<2>(key) };
+            image.layers = static_cast<uint32_t>(std::min<std::size_t>(members.size() - first, max_layers));
+            image.entries.assign(members.begin() + first, members.begin() + first + image.layers);
+
+            for (uint32_t layer = 0; layer < image.layers; layer++) {
+                auto& packed = m_textures[image.entries[layer]];
+                packed.image = static_cast<uint32_t>(images.size());
+                packed.layer = layer;
+            }
+            images.push_back(std::move(image));
+        }
+    }
+}
+
+void texture_packer::pack_atlases(std::vector<pending_image>& images)
+{
+    std::map<VkFormat, std::vector<uint32_t>> groups {};
+    for (uint32_t i = 0; i < m_entries.size(); i++) {
+        if (m_entries[i].atlas) {
+            groups[m_entries[i].format].push_back(i);
+        }
+    }
+
+    const uint32_t padding = m_settings.atlas_padding;
+    const uint32_t size = m_settings.atlas_size;
+    const uint32_t max_layers = m_device->get_max_image_array_layers();
+
+    for (auto& [format, members] : groups) {
+        // tallest first, every shelf is as tall as the first entry placed on it
+        std::ranges::stable_sort(members, std::greater {}, [this](uint32_t index) { return m_entries[index].height; });
+
+        std::vector<uint32_t> pages(members.size());
+        uint32_t page = 0;
+        uint32_t shelf_x = 0;
+        uint32_t shelf_y = 0;
+        uint32_t shelf_height = 0;
+        VkExtent2D used {};
+        VkDeviceSize texels {};
+
+        for (std::size_t i = 0; i < members.size(); i++) {
+            auto& texture = m_entries[members[i]];
+            const uint32_t width = texture.width + 2 * padding;
+            const uint32_t height = texture.height + 2 * padding;
+
+            if (shelf_x + width > size) {
+                shelf_x = 0;
+                shelf_y += shelf_height;
+                shelf_height = 0;
+            }
+            if (shelf_y + height > size) {
+                page++;
+                shelf_x = 0;
+                shelf_y = 0;
+                shelf_height = 0;
+            }
+
+            texture.x = shelf_x;
+            texture.y = shelf_y;
+            pages[i] = page;
+
+            shelf_x += width;
+            shelf_height = std::max(shelf_height, height);
+            used.width = std::max(used.width, texture.x + width);
+            used.height = std::max(used.height, texture.y + height);
+            texels += static_cast<VkDeviceSize>(texture.width) * texture.height;
+        }
+
+        // every page is cut down to what the fullest one uses, a handful of icons do not need a full page
+        const uint32_t page_count = page + 1;
+        m_atlas_waste += static_cast<VkDeviceSize>(used.width) * used.height * page_count - texels;
+
+        for (uint32_t first_page = 0; first_page < page_count; first_page += max_layers) {
+            pending_image image {};
+            image.format = format;
+            image.extent = used;
+            image.layers = std::min(page_count - first_page, max_layers);
+            image.atlas = true;
+
+            for (std::size_t i = 0; i < members.size(); i++) {
+                if (pages[i] < first_page || pages[i] >= first_page + image.layers) {
+                    continue;
+                }
+
+                const auto& texture = m_entries[members[i]];
+                auto& packed = m_textures[members[i]];
+                packed.image = static_cast<uint32_t>(images.size());
+                packed.layer = pages[i] - first_page;
+                packed.uv_offset = { static_cast<float>(texture.x + padding) / used.width, static_cast<float>(texture.y + padding) / used.height };
+                packed.uv_scale = { static_cast<float>(texture.width) / used.width, static_cast<float>(texture.height) / used.height };
+                image.entries.push_back(members[i]);
+            }
+            images.push_back(std::move(image));
+        }
+    }
+}
+
+void texture_packer::upload(const pending_image& pending, image_handle& image, instance* inst)
+{
+    const uint32_t texel_bytes = get_format_block(pending.format)->bytes;
+
+    uint32_t mip_levels = 1;
+    if (m_settings.generate_mips && !pending.atlas) {
+        VkFormatProperties format_properties {};
+        vkGetPhysicalDeviceFormatProperties(m_device->get_physical_device(), pending.format, &format_properties);
+
+        constexpr VkFormatFeatureFlags blit_features = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+        if ((format_properties.optimalTilingFeatures & blit_features) == blit_features) {
+            mip_levels = static_cast<uint32_t>(std::floor(std::log2(std::max(pending.extent.width, pending.extent.height)))) + 1;
+        } else {
+            spdlog::warn("format can not be blitted with linear filtering, a {}x{} texture array is packed without mips", pending.extent.width, pending.extent.height);
+        }
+    }
+
+    VkImageCreateInfo image_info {};
+    image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_info.imageType = VK_IMAGE_TYPE_2D;
+    image_info.extent = { pending.extent.width, pending.extent.height, 1 };
+    image_info.mipLevels = mip_levels;
+    image_info.arrayLayers = pending.layers;
+    image_info.format = pending.format;
+    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    image_info.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VmaAllocationCreateInfo alloc_info {};
+    alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    alloc_info.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+    image.set_tag(fmt::format("{} {}x{}", pending.atlas ? "texture atlas" : "texture array", pending.extent.width, pending.extent.height));
+    image.create_image(&image_info, &alloc_info);
+
+    // atlas entries are uploaded with their padding, which is why the region is larger than the texture
+    const uint32_t padding = pending.atlas ? m_settings.atlas_padding : 0;
+    std::vector<VkBufferImageCopy> regions {};
+    regions.reserve(pending.entries.size());
+    VkDeviceSize size {};
+    for (uint32_t index : pending.entries) {
+        const auto& texture = m_entries[index];
+
+        VkBufferImageCopy region {};
+        region.bufferOffset = size;
+        region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, m_textures[index].layer, 1 };
+        region.imageOffset = { static_cast<int32_t>(texture.x), static_cast<int32_t>(texture.y), 0 };
+        region.imageExtent = { texture.width + 2 * padding, texture.height + 2 * padding, 1 };
+        regions.push_back(region);
+
+        size += static_cast<VkDeviceSize>(region.imageExtent.width) * region.imageExtent.height * texel_bytes;
+    }
+
+    const auto write = [&](void* staging) {
+        auto* out = static_cast<uint8_t*>(staging);
+        for (uint32_t index : pending.entries) {
+            const auto& texture = m_entries[index];
+            const std::size_t row_bytes = static_cast<std::size_t>(texture.width) * texel_bytes;
+
+            for (uint32_t y = 0; y < texture.height + 2 * padding; y++) {
+                // the border repeats the edge texels, like clamp to edge would sample them
+                const uint32_t source_y = std::clamp(y, padding, padding + texture.height - 1) - padding;
+                const uint8_t* row = texture.pixels.data() + source_y * row_bytes;
+
+                for (uint32_t x = 0; x < padding; x++, out += texel_bytes) {
+                    std::memcpy(out, row, texel_bytes);
+                }
+                std::memcpy(out, row, row_bytes);
+                out += row_bytes;
+                for (uint32_t x = 0; x < padding; x++, out += texel_bytes) {
+                    std::memcpy(out, row + row_bytes - texel_bytes, texel_bytes);
+                }
+            }
+        }
+    };
+
+    auto uploader = inst->get_upload_manager();
+    if (mip_levels > 1) {
+        uploader->upload_image(&image, size, regions, write, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+        uploader->generate_mips(&image);
+    } else {
+        uploader->upload_image(&image, size, regions, write);
+    }
+}
+
+} // namespace quix
+
+#endif // _QUIX_TEXTURE_PACKER_CPP
@@ -0,0 +1,104 @@
+#ifndef _QUIX_TEXTURE_PACKER_HPP
+#define _QUIX_TEXTURE_PACKER_HPP
+
+#include "quix_resource.hpp"
+
+namespace quix {
+
+class device;
+class instance;
+
+struct texture_packer_settings {
+    // textures no larger than this on either side are shelf packed into atlas pages, the rest become array layers
+    uint32_t max_atlas_entry = 256;
+    // largest side of an atlas page, the pages of one format are the layers of one array image
+    uint32_t atlas_size = 2048;
+    // texels of clamped border around every atlas entry, so linear filtering does not pick up the neighbours
+    uint32_t atlas_padding = 2;
+    // full mip chains for the array images, atlas pages never get mips since they would bleed across entries
+    bool generate_mips = false;
+};
+
+// where a texture ended up. sample the 2d array view of image at layer with uv * uv_scale + uv_offset,
+// textures that got a layer of their own have no offset and a scale of one
+struct packed_texture {
+    uint32_t image {};
+    uint32_t layer {};
+    std::array<float, 2> uv_offset {};
+    std::array<float, 2> uv_scale { 1.0f, 1.0f };
+};
+
+// packs many textures into a few images so a material system can bind one descriptor for hundreds of them.
+// textures of the same format and size become layers of one array image, small ones of the same format are
+// shelf packed into atlas pages. images are split where they would exceed maxImageArrayLayers
+class texture_packer {
+public:
+    explicit texture_packer(weakref<device> p_device, const texture_packer_settings& settings = {});
+    ~texture_packer() = default;
+
+    texture_packer(const texture_packer&) = delete;
+    texture_packer& operator=(const texture_packer&) = delete;
+    texture_packer(texture_packer&&) = delete;
+    texture_packer& operator=(texture_packer&&) = delete;
+
+    // decoded with stb_image as VK_FORMAT_R8G8B8A8_SRGB, returns the texture's index
+    NODISCARD uint32_t add(const char* filepath);
+    // the pixels are copied, the format has to be uncompressed
+    NODISCARD uint32_t add(const uint8_t* pixels, uint32_t width, uint32_t height, VkFormat format, const char* name = nullptr);
+    // places every texture, creates the images and uploads them all in one upload_manager batch.
+    // the pixels are dropped afterwards
+    void build(instance* inst);
+    // destroys the images and forgets every texture
+    void reset();
+
+    NODISCARD const packed_texture& get_texture(uint32_t texture) const;
+    NODISCARD inline uint32_t get_texture_count() const noexcept { return static_cast<uint32_t>(m_textures.size()); }
+    NODISCARD inline uint32_t get_image_count() const noexcept { return static_cast<uint32_t>(m_images.size()); }
+    NODISCARD image_handle& get_image(uint32_t image);
+    // VK_IMAGE_VIEW_TYPE_2D_ARRAY over every layer, also for images that ended up with a single layer
+    NODISCARD VkImageView get_view(uint32_t image);
+    NODISCARD VkDescriptorImageInfo get_descriptor_info(uint32_t image, VkSampler sampler);
+
+    // texels of the atlas pages that no texture covers, padding included
+    NODISCARD inline VkDeviceSize get_atlas_waste() const noexcept { return m_atlas_waste; }
+
+private:
+    struct entry {
+        std::string name {};
+        VkFormat format {};
+        uint32_t width {};
+        uint32_t height {};
+        std::vector<uint8_t> pixels {};
+        // top left texel of the padded entry in its atlas page
+        uint32_t x {};
+        uint32_t y {};
+        bool atlas = false;
+    };
+
+    // one image to create, the entries are in layer order for arrays
+    struct pending_image {
+        VkFormat format {};
+        VkExtent2D extent {};
+        uint32_t layers {};
+        bool atlas = false;
+        std::vector<uint32_t> entries {};
+    };
+
+    void pack_arrays(std::vector<pending_image>& images);
+    void pack_atlases(std::vector<pending_image>& images);
+    void upload(const pending_image& pending, image_handle& image, instance* inst);
+
+    weakref<device> m_device;
+    texture_packer_settings m_settings;
+
+    std::vector<entry> m_entries {};
+    std::vector<packed_texture> m_textures {};
+    std::vector<image_handle> m_images {};
+    bool m_built = false;
+
+    VkDeviceSize m_atlas_waste {};
+};
+
+} // namespace quix
+
+#endif // _QUIX_TEXTURE_PACKER_HPP
@@ -0,0 +1,172 @@
+#ifndef _QUIX_TRANSIENT_CPP
+#define _QUIX_TRANSIENT_CPP
+
+#include "quix_transient.hpp"
+
+#include "quix_device.hpp"
+#include <numeric>
+
+namespace quix {
+
+transient_attachment_pool::transient_attachment_pool(weakref<device> p_device)
+    : m_device(std::move(p_device))
+{
+}
+
+transient_attachment_pool::~transient_attachment_pool()
+{
+    reset();
+}
+
+NODISCARD uint32_t transient_attachment_pool::add(const transient_attachment_info& info)
+{
+    quix_assert(!m_built, "transient attachment pool is already built, reset it before adding attachments");
+    quix_assert(info.first_pass <= info.last_pass, "transient attachment ends before it starts");
+
+    m_attachments.push_back({ .info = info });
+    return static_cast<uint32_t>(m_attachments.size() - 1);
+}
+
+void transient_attachment_pool::build()
+{
+    quix_assert(!m_built, "transient attachment pool is already built, reset it first");
+
+    // anything else, like sampling the attachment in a later pass, rules out VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT
+    constexpr VkImageUsageFlags attachment_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+
+    for (auto& attachment : m_attachments) {
+        attachment.transient = (attachment.info.usage & ~attachment_usage) == 0;
+
+        VkImageCreateInfo image_info {};
+        image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        image_info.imageType = VK_IMAGE_TYPE_2D;
+        image_info.extent = { attachment.info.extent.width, attachment.info.extent.height, 1 };
+        image_info.mipLevels = 1;
+        image_info.arrayLayers = 1;
+        image_info.format = attachment.info.format;
+        image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        image_info.usage = attachment.info.usage | (attachment.transient ? VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT : 0);
+        image_info.samples = attachment.info.samples;
+        image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        VK_CHECK(vkCreateImage(m_device->get_logical_device(), &image_info, nullptr, &attachment.image), "failed to create transient attachment");
+        vkGetImageMemoryRequirements(m_device->get_logical_device(), attachment.image, &attachment.requirements);
+        m_unaliased_size += attachment.requirements.size;
+    }
+
+    // largest first, so the smaller attachments end up inside the memory of a larger one
+    std::vector<uint32_t> order(m_attachments.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::ranges::stable_sort(order, std::greater {}, [this](uint32_t index) { return m_attachments[index].requirements.size; });
+
+    for (uint32_t index : order) {
+        auto& attachment = m_attachments[index];
+
+        auto block = std::ranges::find_if(m_blocks, [&](const memory_block& candidate) { return get_fits(candidate, attachment); });
+        if (block == m_blocks.end()) {
+            m_blocks.push_back({ .requirements = attachment.requirements, .transient = attachment.transient });
+            block = std::prev(m_blocks.end());
+        }
+
+        block->requirements.size = std::max(block->requirements.size, attachment.requirements.size);
+        block->requirements.alignment = std::max(block->requirements.alignment, attachment.requirements.alignment);
+        block->requirements.memoryTypeBits &= attachment.requirements.memoryTypeBits;
+        block->attachments.push_back(index);
+        attachment.block = static_cast<uint32_t>(std::distance(m_blocks.begin(), block));
+    }
+
+    for (auto& block : m_blocks) {
+        allocate_block(block);
+    }
+
+    for (auto& attachment : m_attachments) {
+        VK_CHECK(vmaBindImageMemory(m_device->get_allocator(), m_blocks[attachment.block].alloc, attachment.image), "failed to bind transient attachment memory");
+
+        VkImageViewCreateInfo view_info {};
+        view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        view_info.image = attachment.image;
+        view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        view_info.format = attachment.info.format;
+        view_info.subresourceRange = { attachment.info.aspect, 0, 1, 0, 1 };
+
+        VK_CHECK(vkCreateImageView(m_device->get_logical_device(), &view_info, nullptr, &attachment.view), "failed to create transient attachment view");
+    }
+
+    m_built = true;
+
+    spdlog::info("transient attachments: {} attachments in {} blocks, {} bytes instead of {}",
+        m_attachments.size(), m_blocks.size(), m_memory_size, m_unaliased_size);
+}
+
+void transient_attachment_pool::reset()
+{
+    if (!m_attachments.empty() || !m_blocks.empty()) {
+        // the frames in flight may still render into them
+        m_device->defer_destroy([logical_device = m_device->get_logical_device(), allocator = m_device->get_allocator(),
+                                    attachments = std::move(m_attachments), blocks = std::move(m_blocks)]() {
+            for (const auto& attachment : attachments) {
+                vkDestroyImageView(logical_device, attachment.view, nullptr);
+                vkDestroyImage(logical_device, attachment.image, nullptr);
+            }
+            for (const auto& block : blocks) {
+                if (block.alloc != VK_NULL_HANDLE) {
+                    vmaFreeMemory(allocator, block.alloc);
+                }
+            }
+        });
+    }
+
+    m_attachments.clear();
+    m_blocks.clear();
+    m_built = false;
+    m_memory_size = 0;
+    m_unaliased_size = 0;
+}
+
+NODISCARD VkImage transient_attachment_pool::get_image(uint32_t attachment) const
+{
+    quix_assert(m_built && attachment < m_attachments.size(), "transient attachment does not exist or the pool is not built");
+    return m_attachments[attachment].image;
+}
+
+NODISCARD VkImageView transient_attachment_pool::get_view(uint32_t attachment) const
+{
+    quix_assert(m_built && attachment < m_attachments.size(), "transient attachment does not exist or the pool is not built");
+    return m_attachments[attachment].view;
+}
+
+NODISCARD bool transient_attachment_pool::get_fits(const memory_block& block, const attachment& candidate) const
+{
+    // lazily allocated memory only works for transient images, keep the two kinds apart
+    if (block.transient != candidate.transient || (block.requirements.memoryTypeBits & candidate.requirements.memoryTypeBits) == 0) {
+        return false;
+    }
+
+    return std::ranges::none_of(block.attachments, [&](uint32_t index) {
+        const auto& other = m_attachments[index].info;
+        return other.first_pass <= candidate.info.last_pass && candidate.info.first_pass <= other.last_pass;
+    });
+}
+
+void transient_attachment_pool::allocate_block(memory_block& block)
+{
+    VmaAllocationCreateInfo alloc_info {};
+    alloc_info.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+    if (block.transient && m_device->get_lazily_allocated_supported()) {
+        alloc_info.usage = VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED;
+        if (vmaAllocateMemory(m_device->get_allocator(), &block.requirements, &alloc_info, &block.alloc, nullptr) == VK_SUCCESS) {
+            // only committed on demand, which on tilers is never
+            return;
+        }
+    }
+
+    alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    VK_CHECK(vmaAllocateMemory(m_device->get_allocator(), &block.requirements, &alloc_info, &block.alloc, nullptr), "failed to allocate transient attachment memory");
+    m_memory_size += block.requirements.size;
+}
+
+} // namespace quix
+
+#endif // _QUIX_TRANSIENT_CPP
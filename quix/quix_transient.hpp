@@ -0,0 +1,86 @@
+#ifndef _QUIX_TRANSIENT_HPP
+#define _QUIX_TRANSIENT_HPP
+
+namespace quix {
+
+class device;
+
+// an attachment that only lives for part of a frame. first_pass and last_pass are the indices of the first
+// and last pass of the frame that touch it, inclusive, and decide which attachments can share memory
+struct transient_attachment_info {
+    VkFormat format {};
+    VkExtent2D extent {};
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+    VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+    uint32_t first_pass {};
+    uint32_t last_pass {};
+};
+
+// backs the intermediate attachments of a multi pass frame. attachments whose pass ranges do not overlap are
+// bound to the same memory, and attachments that are only ever used as attachments get
+// VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT and lazily allocated memory where the device has it, which tile
+// based gpus never back with real memory at all.
+// aliased attachments do not keep their contents between passes, every pass has to start them with
+// VK_IMAGE_LAYOUT_UNDEFINED and a clear or don't care load op, and the render passes have to order the
+// passes sharing memory with their external subpass dependencies
+class transient_attachment_pool {
+public:
+    explicit transient_attachment_pool(weakref<device> p_device);
+    ~transient_attachment_pool();
+
+    transient_attachment_pool(const transient_attachment_pool&) = delete;
+    transient_attachment_pool& operator=(const transient_attachment_pool&) = delete;
+    transient_attachment_pool(transient_attachment_pool&&) = delete;
+    transient_attachment_pool& operator=(transient_attachment_pool&&) = delete;
+
+    // returns the attachment's index, its image only exists after build
+    NODISCARD uint32_t add(const transient_attachment_info& info);
+    // creates the images and the shared memory for everything added, call again after reset on a resize
+    void build();
+    // drops every attachment, the images and memory are retired through device::defer_destroy
+    void reset();
+
+    NODISCARD VkImage get_image(uint32_t attachment) const;
+    NODISCARD VkImageView get_view(uint32_t attachment) const;
+    NODISCARD inline uint32_t get_attachment_count() const noexcept { return static_cast<uint32_t>(m_attachments.size()); }
+
+    // memory committed after aliasing, lazily allocated blocks do not count, and what one allocation
+    // per attachment would have taken
+    NODISCARD inline VkDeviceSize get_memory_size() const noexcept { return m_memory_size; }
+    NODISCARD inline VkDeviceSize get_unaliased_size() const noexcept { return m_unaliased_size; }
+    NODISCARD inline uint32_t get_memory_block_count() const noexcept { return static_cast<uint32_t>(m_blocks.size()); }
+
+private:
+    struct attachment {
+        transient_attachment_info info {};
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        VkMemoryRequirements requirements {};
+        bool transient = false;
+        uint32_t block {};
+    };
+
+    struct memory_block {
+        VmaAllocation alloc {};
+        VkMemoryRequirements requirements {};
+        bool transient = false;
+        std::vector<uint32_t> attachments {};
+    };
+
+    NODISCARD bool get_fits(const memory_block& block, const attachment& candidate) const;
+    void allocate_block(memory_block& block);
+
+    weakref<device> m_device;
+
+    std::vector<attachment> m_attachments {};
+    std::vector<memory_block> m_blocks {};
+    bool m_built = false;
+
+    VkDeviceSize m_memory_size {};
+    VkDeviceSize m_unaliased_size {};
+};
+
+} // namespace quix
+
+#endif // _QUIX_TRANSIENT_HPP
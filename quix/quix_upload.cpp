@@ -0,0 +1,348 @@
+#ifndef _QUIX_UPLOAD_CPP
+#define _QUIX_UPLOAD_CPP
+
+#include "quix_upload.hpp"
+
+#include "quix_capture.hpp"
+#include "quix_device.hpp"
+#include "quix_texture_container.hpp"
+
+namespace quix {
+
+// covers texel block sizes up to 16 bytes for image copies
+static constexpr VkDeviceSize staging_alignment = 16;
+
+upload_manager::upload_manager(weakref<device> p_device, VkDeviceSize ring_size)
+    : m_device(std::move(p_device))
+    , m_command_pool(m_device, m_device->get_command_pool())
+    , m_ring(m_device)
+    , m_ring_size(ring_size)
+{
+    m_ring.create_staging_buffer(ring_size);
+}
+
+upload_manager::~upload_manager()
+{
+    wait_all();
+
+    for (auto* fence : m_free_fences) {
+        vkDestroyFence(m_device->get_logical_device(), fence, nullptr);
+    }
+}
+
+upload_ticket upload_manager::upload_buffer(VkBuffer dst, VkDeviceSize dst_offset, const void* data, VkDeviceSize size)
+{
+    return upload_buffer(dst, dst_offset, size, [&](void* staging) { std::memcpy(staging, data, size); });
+}
+
+upload_ticket upload_manager::upload_buffer(VkBuffer dst, VkDeviceSize dst_offset, VkDeviceSize size, const staging_writer& write)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto staging = allocate(size, 4);
+    write(staging.data);
+
+    if (auto* recorder = m_device->get_recorder()) {
+        recorder->record_write_buffer(staging.buffer, staging.offset, staging.data, size);
+    }
+
+    get_recording()->copy_buffer_to_buffer(staging.buffer, staging.offset, dst, dst_offset, size);
+
+    return m_recording->ticket;
+}
+
+upload_ticket upload_manager::upload_image(image_handle* dst, const void* data, VkDeviceSize size, std::span<const VkBufferImageCopy> regions, VkImageLayout final_layout)
+{
+    return upload_image(dst, size, regions, [&](void* staging) { std::memcpy(staging, data, size); }, final_layout);
+}
+
+upload_ticket upload_manager::upload_image(image_handle* dst, VkDeviceSize size, std::span<const VkBufferImageCopy> regions, const staging_writer& write, VkImageLayout final_layout)
+{
+    quix_assert(!regions.empty(), "upload_image needs at least one region");
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto staging = allocate(size, staging_alignment);
+    write(staging.data);
+
+    if (auto* recorder = m_device->get_recorder()) {
+        recorder->record_write_buffer(staging.buffer, staging.offset, staging.data, size);
+    }
+
+    record_image_copy(dst, staging.buffer, staging.offset, regions, final_layout);
+
+    return m_recording->ticket;
+}
+
+upload_ticket upload_manager::upload_image(image_handle* dst, const void* data, VkDeviceSize size, VkImageLayout final_layout)
+{
+    VkBufferImageCopy region {};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = dst->get_array_layers();
+    region.imageExtent = dst->get_extent();
+
+    return upload_image(dst, data, size, std::span<const VkBufferImageCopy>(&region, 1), final_layout);
+}
+
+upload_ticket upload_manager::upload_staged(std::unique_ptr<buffer_handle> staging, std::span<const staged_image_copy> copies)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto* commands = get_recording();
+    auto* recorder = m_device->get_recorder();
+
+    for (const auto& copy : copies) {
+        quix_assert(!copy.regions.empty(), "upload_staged needs at least one region per image");
+
+        if (recorder != nullptr) {
+            recorder->record_write_buffer(staging->get_buffer(), copy.offset,
+                static_cast<char*>(staging->get_mapped_data()) + copy.offset, copy.size);
+        }
+
+        record_image_copy(copy.dst, staging->get_buffer(), copy.offset, copy.regions,
+            copy.generate_mips ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        if (copy.generate_mips) {
+            commands->generate_mips(copy.dst, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        }
+    }
+
+    m_recording->overflow.push_back(std::move(staging));
+
+    return m_recording->ticket;
+}
+
+void upload_manager::record_image_copy(image_handle* dst, VkBuffer staging, VkDeviceSize staging_offset, std::span<const VkBufferImageCopy> regions, VkImageLayout final_layout)
+{
+    auto* commands = get_recording();
+
+    // only the mips being written are transitioned, so the rest of the image stays valid
+    VkImageSubresourceRange range {};
+    range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    range.baseMipLevel = regions.front().imageSubresource.mipLevel;
+    uint32_t last_mip = range.baseMipLevel;
+    for (const auto& region : regions) {
+        range.baseMipLevel = std::min(range.baseMipLevel, region.imageSubresource.mipLevel);
+        last_mip = std::max(last_mip, region.imageSubresource.mipLevel);
+    }
+    range.levelCount = last_mip - range.baseMipLevel + 1;
+    range.baseArrayLayer = 0;
+    range.layerCount = dst->get_array_layers();
+
+    image_barrier_info barrier_info {};
+    barrier_info.src_access_mask = 0;
+    barrier_info.dst_access_mask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier_info.src_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    barrier_info.dst_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    barrier_info.old_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier_info.new_layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    commands->image_barrier(dst, &barrier_info, range);
+
+    // vkCmdCopyBufferToImage needs every offset on a texel block, staging_alignment covers the start of the data
+    const auto block = get_format_block(dst->get_format());
+    std::vector<VkBufferImageCopy> copies(regions.begin(), regions.end());
+    for (auto& copy : copies) {
+        copy.bufferOffset += staging_offset;
+        quix_assert(!block.has_value() || copy.bufferOffset % block->bytes == 0, "image copy offset is not aligned to the format's texel block");
+    }
+    commands->copy_buffer_to_image(staging, dst, copies);
+
+    barrier_info.src_access_mask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier_info.dst_access_mask = final_layout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL ? VK_ACCESS_TRANSFER_READ_BIT : VK_ACCESS_SHADER_READ_BIT;
+    barrier_info.src_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    barrier_info.dst_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    barrier_info.old_layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier_info.new_layout = final_layout;
+    commands->image_barrier(dst, &barrier_info, range);
+}
+
+upload_ticket upload_manager::generate_mips(image_handle* dst, VkImageLayout final_layout)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    get_recording()->generate_mips(dst, final_layout);
+
+    return m_recording->ticket;
+}
+
+upload_ticket upload_manager::flush()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return flush_locked();
+}
+
+void upload_manager::begin_batch() noexcept
+{
+    m_batch_depth.fetch_add(1, std::memory_order_acq_rel);
+}
+
+upload_ticket upload_manager::end_batch()
+{
+    const uint32_t depth = m_batch_depth.fetch_sub(1, std::memory_order_acq_rel);
+    quix_assert(depth != 0, "end_batch called without begin_batch");
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (depth == 1) {
+        return flush_locked();
+    }
+    // an outer batch is still open, its end flushes this ticket
+    return m_recording.has_value() ? m_recording->ticket : m_next_ticket - 1;
+}
+
+NODISCARD bool upload_manager::is_complete(upload_ticket ticket)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    retire_completed();
+    return ticket <= m_completed_ticket;
+}
+
+void upload_manager::wait(upload_ticket ticket)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_recording.has_value() && ticket >= m_recording->ticket) {
+        flush_locked();
+    }
+
+    while (ticket > m_completed_ticket && !m_in_flight.empty()) {
+        retire_oldest();
+    }
+}
+
+void upload_manager::wait_all()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    flush_locked();
+    while (!m_in_flight.empty()) {
+        retire_oldest();
+    }
+}
+
+NODISCARD upload_manager::staging_allocation upload_manager::allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+    if (size > m_ring_size) {
+        auto overflow = std::make_unique<buffer_handle>(m_device);
+        overflow->create_staging_buffer(size);
+
+        get_recording();
+        staging_allocation allocation { overflow->get_buffer(), 0, overflow->get_mapped_data() };
+        m_recording->overflow.push_back(std::move(overflow));
+        return allocation;
+    }
+
+    retire_completed();
+
+    while (true) {
+        uint64_t offset = (m_head + alignment - 1) & ~(alignment - 1);
+        const uint64_t position = offset % m_ring_size;
+        if (position + size > m_ring_size) {
+            // does not fit before the end of the ring, skip to the start
+            offset += m_ring_size - position;
+        }
+
+        if (offset + size - m_tail <= m_ring_size) {
+            m_head = offset + size;
+            const VkDeviceSize ring_offset = offset % m_ring_size;
+            return staging_allocation {
+                m_ring.get_buffer(),
+                ring_offset,
+                static_cast<char*>(m_ring.get_mapped_data()) + ring_offset
+            };
+        }
+
+        // out of ring space, get what is recorded moving and wait for the oldest batch
+        if (m_recording.has_value()) {
+            flush_locked();
+        }
+        quix_assert(!m_in_flight.empty(), "upload ring is full with nothing in flight");
+        retire_oldest();
+    }
+}
+
+NODISCARD command_list* upload_manager::get_recording()
+{
+    if (!m_recording.has_value()) {
+        batch next {};
+        next.ticket = m_next_ticket++;
+
+        if (m_free_lists.empty()) {
+            next.commands = m_command_pool.create_command_list();
+        } else {
+            next.commands = std::move(m_free_lists.back());
+            m_free_lists.pop_back();
+        }
+
+        next.commands->begin_record(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+        m_recording = std::move(next);
+    }
+
+    return m_recording->commands.get();
+}
+
+upload_ticket upload_manager::flush_locked()
+{
+    if (!m_recording.has_value()) {
+        return m_next_ticket - 1;
+    }
+
+    batch current = std::move(*m_recording);
+    m_recording.reset();
+
+    // makes buffer writes visible to anything submitted after this batch
+    VkMemoryBarrier barrier {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    vkCmdPipelineBarrier(current.commands->get_cmd_buffer(),
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+        0,
+        1, &barrier,
+        0, nullptr,
+        0, nullptr);
+
+    current.commands->end_record();
+
+    if (m_free_fences.empty()) {
+        VkFenceCreateInfo fence_info {};
+        fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        VK_CHECK(vkCreateFence(m_device->get_logical_device(), &fence_info, nullptr, &current.fence), "failed to create fence");
+    } else {
+        current.fence = m_free_fences.back();
+        m_free_fences.pop_back();
+    }
+
+    current.ring_end = m_head;
+    current.commands->submit(current.fence);
+
+    const upload_ticket ticket = current.ticket;
+    m_in_flight.push_back(std::move(current));
+    return ticket;
+}
+
+void upload_manager::retire_completed()
+{
+    while (!m_in_flight.empty() && vkGetFenceStatus(m_device->get_logical_device(), m_in_flight.front().fence) == VK_SUCCESS) {
+        retire_oldest();
+    }
+}
+
+void upload_manager::retire_oldest()
+{
+    auto& oldest = m_in_flight.front();
+
+    vkWaitForFences(m_device->get_logical_device(), 1, &oldest.fence, VK_TRUE, UINT64_MAX);
+    vkResetFences(m_device->get_logical_device(), 1, &oldest.fence);
+
+    m_free_fences.push_back(oldest.fence);
+    m_free_lists.push_back(std::move(oldest.commands));
+    m_tail = oldest.ring_end;
+    m_completed_ticket = oldest.ticket;
+
+    m_in_flight.pop_front();
+}
+
+} // namespace quix
+
+#endif // _QUIX_UPLOAD_CPP
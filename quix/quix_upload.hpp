@@ -0,0 +1,131 @@
+#ifndef _QUIX_UPLOAD_HPP
+#define _QUIX_UPLOAD_HPP
+
+#include "quix_commands.hpp"
+#include "quix_resource.hpp"
+
+namespace quix {
+
+class device;
+
+// increases with every flush, an upload is done once its ticket is complete
+using upload_ticket = uint64_t;
+
+// an image filled from staging memory the caller wrote itself, see upload_manager::upload_staged
+struct staged_image_copy {
+    image_handle* dst = nullptr;
+    // where the image's data starts in the staging buffer and how many bytes of it the regions read
+    VkDeviceSize offset {};
+    VkDeviceSize size {};
+    // bufferOffsets are relative to offset
+    std::vector<VkBufferImageCopy> regions {};
+    // the regions may only cover mip 0, which is blitted down to the rest of the chain
+    bool generate_mips = false;
+};
+
+// batches buffer and image uploads through one persistently mapped staging ring.
+// uploads are copied into the ring right away and recorded into a single command buffer,
+// flush submits that batch without waiting and hands back a ticket for it.
+// every batch ends in a transfer to all commands barrier, so later submissions on the graphics
+// queue can use the data without waiting on the ticket.
+// the buffer_handle and image_handle loaders flush after every upload unless they run between begin_batch
+// and end_batch, so wrap a level load in those to send it out as one submission
+class upload_manager {
+public:
+    static constexpr VkDeviceSize default_ring_size = 64 * 1024 * 1024;
+
+    explicit upload_manager(weakref<device> p_device, VkDeviceSize ring_size = default_ring_size);
+    ~upload_manager();
+
+    upload_manager(const upload_manager&) = delete;
+    upload_manager& operator=(const upload_manager&) = delete;
+    upload_manager(upload_manager&&) = delete;
+    upload_manager& operator=(upload_manager&&) = delete;
+
+    // writes size bytes of staging memory, called once with the upload lock held
+    using staging_writer = std::function<void(void* staging)>;
+
+    // data is copied before returning, the returned ticket is the batch the upload landed in
+    upload_ticket upload_buffer(VkBuffer dst, VkDeviceSize dst_offset, const void* data, VkDeviceSize size);
+    // lets the caller produce the data in place, e.g. decompress straight into the ring
+    upload_ticket upload_buffer(VkBuffer dst, VkDeviceSize dst_offset, VkDeviceSize size, const staging_writer& write);
+    // transitions the mips touched by regions to transfer dst, copies every region and leaves them in final_layout.
+    // region bufferOffsets are relative to data
+    upload_ticket upload_image(image_handle* dst, const void* data, VkDeviceSize size, std::span<const VkBufferImageCopy> regions,
+        VkImageLayout final_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    upload_ticket upload_image(image_handle* dst, VkDeviceSize size, std::span<const VkBufferImageCopy> regions, const staging_writer& write,
+        VkImageLayout final_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    // mip 0 of every layer, tightly packed
+    upload_ticket upload_image(image_handle* dst, const void* data, VkDeviceSize size,
+        VkImageLayout final_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    // for staging memory filled outside the upload lock, e.g. decoded into by several threads at once. records every
+    // copy into the current batch and keeps the buffer alive until that batch is retired, the images end up
+    // in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+    upload_ticket upload_staged(std::unique_ptr<buffer_handle> staging, std::span<const staged_image_copy> copies);
+
+    // records command_list::generate_mips into the current batch, mip 0 has to be uploaded
+    // with VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL as its final layout first
+    upload_ticket generate_mips(image_handle* dst, VkImageLayout final_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    // submits everything recorded since the last flush, never blocks unless the ring is full
+    upload_ticket flush();
+
+    // the loaders only record between these. batches nest, the outermost end_batch flushes and returns
+    // the ticket of everything recorded. instance::end_frame and frame_pipeline::submit still flush an open batch
+    void begin_batch() noexcept;
+    upload_ticket end_batch();
+    NODISCARD inline bool is_batching() const noexcept { return m_batch_depth.load(std::memory_order_acquire) != 0; }
+
+    NODISCARD bool is_complete(upload_ticket ticket);
+    // flushes first if the ticket is still being recorded
+    void wait(upload_ticket ticket);
+    void wait_all();
+
+private:
+    struct batch {
+        upload_ticket ticket {};
+        VkFence fence = VK_NULL_HANDLE;
+        allocated_unique_ptr<command_list> commands;
+        uint64_t ring_end {};
+        // uploads larger than the ring get a dedicated staging buffer that lives as long as the batch
+        std::vector<std::unique_ptr<buffer_handle>> overflow {};
+    };
+
+    struct staging_allocation {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceSize offset {};
+        void* data = nullptr;
+    };
+
+    NODISCARD staging_allocation allocate(VkDeviceSize size, VkDeviceSize alignment);
+    NODISCARD command_list* get_recording();
+    void record_image_copy(image_handle* dst, VkBuffer staging, VkDeviceSize staging_offset, std::span<const VkBufferImageCopy> regions, VkImageLayout final_layout);
+    upload_ticket flush_locked();
+    void retire_completed();
+    void retire_oldest();
+
+    weakref<device> m_device;
+    command_pool m_command_pool;
+
+    buffer_handle m_ring;
+    VkDeviceSize m_ring_size;
+    // monotonic byte counters, the ring position is head % ring_size
+    uint64_t m_head = 0;
+    uint64_t m_tail = 0;
+
+    std::optional<batch> m_recording {};
+    std::deque<batch> m_in_flight {};
+    std::vector<allocated_unique_ptr<command_list>> m_free_lists {};
+    std::vector<VkFence> m_free_fences {};
+
+    upload_ticket m_next_ticket = 1;
+    upload_ticket m_completed_ticket = 0;
+
+    std::atomic<uint32_t> m_batch_depth = 0;
+    std::mutex m_mutex;
+};
+
+} // namespace quix
+
+#endif // _QUIX_UPLOAD_HPP
@@ -22,6 +22,7 @@ public:
     NODISCARD inline bool should_close() const { return glfwWindowShouldClose(m_window) != 0; }
     static inline void poll_events()  { glfwPollEvents(); }
     static inline void wait_events()  { glfwWaitEvents(); }
+    static inline void wait_events_timeout(double seconds)  { glfwWaitEventsTimeout(seconds); }
 
     NODISCARD inline GLFWwindow* get_window() const noexcept { return m_window; }
 
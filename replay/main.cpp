@@ -0,0 +1,69 @@
+#include "quix_capture.hpp"
+#include "quix_common.hpp"
+#include "quix_instance.hpp"
+
+static constexpr int DEFAULT_ITERATIONS = 100;
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        fmt::print("usage: {} <capture file> [iterations]\n", argv[0]);
+        fmt::print("times the uploads, copies, barriers and mip generation of a capture, draws are not captured\n");
+        return EXIT_FAILURE;
+    }
+
+    const int iterations = argc > 2 ? std::max(1, atoi(argv[2])) : DEFAULT_ITERATIONS;
+
+    // the device needs a surface, so create the window hidden instead of going fully headless
+    glfwInit();
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+    quix::instance instance("quix_replay",
+        VK_MAKE_VERSION(0, 0, 1),
+        1, 1);
+
+    instance.create_device({ VK_KHR_SWAPCHAIN_EXTENSION_NAME },
+        {});
+
+    quix::capture::player player(&instance);
+    player.load(argv[1]);
+
+    // first iteration creates every resource, keep it out of the results
+    auto warmup = player.replay();
+    spdlog::info("capture: {} frames, {} submits", warmup.frames, warmup.submits);
+    spdlog::info("only transfer work is replayed, this is not the cost of the captured frames");
+    if (warmup.skipped_render_passes != 0 || warmup.skipped_pipelines != 0) {
+        // draws are not captured, the timings below only cover uploads, copies and barriers
+        spdlog::warn("skipped {} render passes and {} pipelines, gpu time is transfer work only",
+            warmup.skipped_render_passes, warmup.skipped_pipelines);
+    }
+
+    std::vector<quix::capture::replay_stats> results;
+    results.reserve(iterations);
+    for (int i = 0; i < iterations; i++) {
+        results.push_back(player.replay());
+    }
+
+    auto report = [&](const char* name, auto member) {
+        std::vector<double> values;
+        values.reserve(results.size());
+        for (const auto& result : results) {
+            values.push_back(result.*member);
+        }
+        std::sort(values.begin(), values.end());
+
+        double total = 0.0;
+        for (double value : values) {
+            total += value;
+        }
+
+        fmt::print("{:>12}: min {:.3f} ms  median {:.3f} ms  avg {:.3f} ms  max {:.3f} ms\n",
+            name, values.front(), values[values.size() / 2], total / static_cast<double>(values.size()), values.back());
+    };
+
+    fmt::print("replayed {} iterations\n", iterations);
+    report("cpu submit", &quix::capture::replay_stats::cpu_submit_ms);
+    report("gpu transfer", &quix::capture::replay_stats::transfer_gpu_ms);
+
+    return 0;
+}